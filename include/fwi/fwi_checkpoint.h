@@ -0,0 +1,102 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_CHECKPOINT_H_
+#define _FWI_CHECKPOINT_H_
+
+#include "fwi_propagator.h"
+#include "fwi_domain.h"
+
+/* full states kept in memory instead of the RTM snapshots (FWI_CHECKPOINTS, 0 = disabled) */
+extern int checkpoint_budget;
+
+void select_checkpointing (void);
+
+/* a full state: the 12 velocity components (snapshot order) and the 24 stresses */
+#define STATE_FIELDS 36
+
+void state_fields ( v_t *v, s_t *s, real* fields[STATE_FIELDS] );
+
+/*
+ * Binomial (Revolve) checkpointing: cost[L*(nfree+1)+s] is the minimum number
+ * of snapshot intervals advanced to deliver L consecutive states in reverse
+ * order from a checkpoint on the first one with s free checkpoint slots, and
+ * split[] is how many intervals to advance before taking the next checkpoint.
+ */
+void plan_revolve ( const int  nstates,
+                    const int  nfree,
+                    long      *cost,
+                    int       *split );
+
+/*
+ * Replaces the snapshots of the RTM forward pass by 'nslots' full states
+ * (velocity and stress) and recomputes the snapshots the backward pass asks
+ * for from the closest of them.
+ */
+typedef struct checkpointer_s checkpointer_t;
+
+/* snapshot k of the forward pass has suffix first_suffix + k * step and is
+ * taken every 'stacki' time steps; 'domain' (or NULL for a single rank) sets
+ * up the boundary exchanges of the recomputations */
+checkpointer_t* open_checkpointer ( const int      nslots,
+                                    const int      nsnapshots,
+                                    const int      first_suffix,
+                                    const int      step,
+                                    const integer  stacki,
+                                    coeff_t        coeffs,
+                                    real          *rho,
+                                    const real     dt,
+                                    const real     dzi,
+                                    const real     dxi,
+                                    const real     dyi,
+                                    const integer  nz0,
+                                    const integer  nzf,
+                                    const integer  nx0,
+                                    const integer  nxf,
+                                    const integer  ny0,
+                                    const integer  nyf,
+                                    const integer  dimmz,
+                                    const integer  dimmx,
+                                    const integer  dimmy,
+                                    const domain_t *domain );
+
+/* called with every forward snapshot, keeps the full state when it is a checkpoint */
+void checkpoint_state ( checkpointer_t *ckp,
+                        const int       suffix,
+                        v_t            *v,
+                        s_t            *s );
+
+/* velocity of a forward snapshot, restored or recomputed from a checkpoint */
+void recompute_snapshot ( checkpointer_t *ckp,
+                          const int       suffix,
+                          v_t            *v );
+
+void close_checkpointer ( checkpointer_t *ckp );
+
+#endif /* end of _FWI_CHECKPOINT_H_ definition */
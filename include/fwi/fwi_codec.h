@@ -0,0 +1,79 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_CODEC_H_
+#define _FWI_CODEC_H_
+
+#include "fwi_common.h"
+
+#include <stdint.h>
+
+/* encoding of the snapshots that go to disk (FWI_SNAPSHOT_CODEC) */
+typedef enum {RAW_CODEC, LOSSY_CODEC, FP16_CODEC, BF16_CODEC} snapshot_codec_t;
+
+extern snapshot_codec_t snapshot_codec;
+/* error bound of the lossy codec (FWI_SNAPSHOT_TOLERANCE), absolute or
+ * relative to the largest magnitude of each field */
+extern double           snapshot_tolerance;
+extern int              snapshot_tolerance_relative;
+
+void select_snapshot_codec (void);
+
+/* largest encoding of 'nfields' arrays of 'cellsInVolume' cells */
+size_t encoded_snapshot_bound ( const int     nfields,
+                                const integer cellsInVolume );
+
+/*
+ * Encodes 'nfields' arrays into 'out' with the selected codec and returns
+ * the encoded bytes. The raw codec lays the arrays one after the other, as
+ * the snapshot files always did. The lossy codec quantises every value to
+ * twice the error bound, predicts it from the previous cell in z and stores
+ * the zig-zag varint of the residual (zero runs as a count), in independent
+ * blocks that are encoded and decoded in parallel. The fp16 and bf16 codecs
+ * store every value as an IEEE half or a bfloat16 (rounded to nearest even),
+ * with the raw layout.
+ */
+size_t encode_snapshot ( unsigned char  *out,
+                         real          **fields,
+                         const int       nfields,
+                         const integer   cellsInVolume );
+
+void decode_snapshot ( const unsigned char  *in,
+                       const size_t          bytes,
+                       real                **fields,
+                       const int             nfields,
+                       const integer         cellsInVolume );
+
+/* conversions used by the fp16 and bf16 codecs */
+uint16_t float_to_half ( const float    value );
+float    half_to_float ( const uint16_t value );
+uint16_t float_to_bf16 ( const float    value );
+float    bf16_to_float ( const uint16_t value );
+
+#endif /* end of _FWI_CODEC_H_ definition */
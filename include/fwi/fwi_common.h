@@ -32,7 +32,11 @@
 
 // When included before <stdlib.h>, solves implicit declaration of posix_memalign()
 // http://stackoverflow.com/questions/32438554/warning-implicit-declaration-of-posix-memalign
-#define _POSIX_C_SOURCE 200809L
+// and exposes the Linux extensions of the I/O and memory code (O_DIRECT, MAP_ANONYMOUS,
+// madvise(), syscall()) that strict POSIX mode hides
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -99,6 +103,7 @@ static inline void checkErrors(const integer error, const char *filename, int li
 };
 
 char* read_env_variable(const char* varname);
+const char* read_env_variable_or_default(const char* varname, const char* defvalue);
 FILE* safe_fopen  ( const char *filename, const char *mode, const char* srcfilename, const int linenumber);
 void  safe_fclose ( const char *filename, FILE* stream, const char* srcfilename, const int linenumber);
 void  safe_fwrite ( const void *ptr, size_t size, size_t nmemb, FILE *stream, const char* srcfilename, const int linenumber );
@@ -106,6 +111,7 @@ void  safe_fread  (       void *ptr, size_t size, size_t nmemb, FILE *stream, co
 integer roundup(integer number, integer multiple);
 
 int max_int( int a, int b);
+int min_int( int a, int b);
 
 double dtime(void);
 
@@ -135,6 +141,7 @@ void store_shot_parameters(int     shotid,
                            integer *dimmx,
                            integer *dimmy,
                            integer *LocalYPlanes,
+                           integer *ProcessGrid,
                            char    *outputfolder,
                            real    waveletFreq);
 
@@ -150,6 +157,7 @@ void load_shot_parameters(int     shotid,
                           integer *dimmx,
                           integer *dimmy,
                           integer *LocalYPlanes,
+                          integer *ProcessGrid,
                           char    *outputfolder,
                           real    waveletFreq);
 
@@ -159,6 +167,10 @@ void load_freqlist (  const char*  filename,
 
 void* __malloc ( const size_t alignment, const integer size);
 void  __free   ( void *ptr );
+void* __malloc_pages ( const size_t size );
+void  __free_pages   ( void *ptr, const size_t size );
+int   bind_to_local_node ( void *ptr, const size_t bytes );
+size_t available_memory  ( void );
 
 void create_output_volumes(char* outputfolder, integer VolumeMemory);
 
@@ -39,9 +39,10 @@ extern const integer WRITTEN_FIELDS;
 extern const integer HALO;
 extern const integer SIMD_LENGTH;
 extern const real    IT_FACTOR;
-extern const real    IO_CHUNK_SIZE;
 
 extern const size_t ALIGN_INT;
 extern const size_t ALIGN_INTEGER;
 extern const size_t ALIGN_REAL;
+extern const size_t PAGE_BYTES;
+extern const size_t HUGE_PAGE_BYTES;
 
@@ -0,0 +1,110 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_DOMAIN_H_
+#define _FWI_DOMAIN_H_
+
+#include "fwi_common.h"
+
+/* axes of the volume, in the order of the arrays (z is contiguous) */
+enum {AXIS_Z, AXIS_X, AXIS_Y};
+
+/* ranks along z, x and y */
+typedef struct {
+    int z, x, y;
+} process_grid_t;
+
+/* FWI_PROCESS_GRID, all zero for 'auto' */
+extern process_grid_t requested_process_grid;
+
+void select_process_grid (void);
+
+/*
+ * Bytes of one velocity and one stress exchange of the rank with most
+ * neighbours, when a dimmz x dimmx x dimmy volume (HALO planes included)
+ * is split among 'grid' ranks.
+ */
+size_t halo_bytes_per_rank ( const process_grid_t grid,
+                             const integer dimmz,
+                             const integer dimmx,
+                             const integer dimmy );
+
+/*
+ * Grid of 'nranks' ranks with the fewest halo bytes per rank. z is only
+ * split when 'split_z' is set, because its halos are HALO cells long runs.
+ * Every rank keeps at least 2*HALO computed planes along the split axes.
+ */
+process_grid_t best_process_grid ( const int nranks,
+                                   const integer dimmz,
+                                   const integer dimmx,
+                                   const integer dimmy,
+                                   const int split_z );
+
+/*
+ * Part of the global volume computed by a rank of the Cartesian process
+ * grid. The computed cells of the volume, all but the HALO planes next to
+ * its faces, are split as evenly as possible along every axis; the local
+ * arrays add HALO planes on both sides, which hold the cells of the
+ * neighbours (or of the volume boundary).
+ */
+typedef struct
+{
+    int      ranks[3];          /* along z, x and y */
+    int      coords[3];
+    int      neighbour[3][2];   /* lower and upper rank, -1 at the volume boundary */
+    integer  global[3];         /* global volume, HALO planes included */
+    integer  offset[3];         /* global position of the first local cell */
+    integer  size[3];           /* local cells, HALO planes included */
+#if defined(USE_MPI)
+    MPI_Comm comm;
+#endif
+} domain_t;
+
+#if defined(USE_MPI)
+/* ranks that compute the current shot together, see the shot farm of execute_simulation */
+extern MPI_Comm shot_comm;
+#endif
+
+/*
+ * Splits the volume among the ranks of shot_comm. The grid is
+ * FWI_PROCESS_GRID, else the 'scheduled' one, else the best one, taking the
+ * first that has as many ranks as there are.
+ */
+void decompose_domain ( domain_t *d,
+                        const integer dimmz,
+                        const integer dimmx,
+                        const integer dimmy,
+                        const process_grid_t scheduled );
+
+void release_domain ( domain_t *d );
+
+/* number of cells of the local volume */
+integer domain_cells ( const domain_t *d );
+
+#endif /* end of _FWI_DOMAIN_H_ definition */
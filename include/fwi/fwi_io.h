@@ -0,0 +1,88 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_IO_H_
+#define _FWI_IO_H_
+
+#include "fwi_common.h"
+
+/* how snapshot, model and gradient files are transferred (FWI_IO_BACKEND) */
+typedef enum {STDIO_BACKEND, DIRECT_BACKEND, URING_BACKEND} io_backend_t;
+
+extern io_backend_t io_backend;
+/* bytes moved per read or write call (FWI_IO_CHUNK), a multiple of PAGE_BYTES */
+extern size_t       io_chunk_bytes;
+/* transfers kept in flight by the io_uring backend (FWI_IO_DEPTH) */
+extern int          io_depth;
+
+void select_io_backend  (void);
+int  io_uring_supported (void);
+
+/*
+ * Sequential file handle. The stdio backend wraps a FILE and splits every
+ * transfer in chunks. The direct backend opens the file with O_DIRECT and
+ * writes whole pages (and reads whole chunks) straight between the disk and
+ * the caller's buffer when both are page aligned and nothing is staged, and
+ * goes through a page aligned staging chunk otherwise. The tail
+ * of a file written in direct mode is padded to a page and truncated back.
+ * Files that cannot be opened (or written) with O_DIRECT fall back to
+ * buffered transfers of the same chunks. The io_uring backend queues the
+ * chunks of the direct backend instead of waiting for each one: reads
+ * return once all their chunks arrived, and writes once the chunks taken
+ * straight from the caller's buffer are written, so the buffer may change
+ * afterwards; only the staged chunks may still be in flight.
+ * The bytes and the seconds spent inside the calls of every handle add up,
+ * per backend, to the summary io_report prints.
+ */
+typedef struct io_file_s io_file_t;
+
+/* 'mode' is "rb" or "wb" */
+io_file_t* io_open  ( const char *fname, const char *mode, const char* srcfilename, const int linenumber );
+void       io_close ( io_file_t  *file );
+
+void   io_write ( io_file_t *file, const void *buffer, const size_t bytes );
+void   io_read  ( io_file_t *file,       void *buffer, const size_t bytes );
+
+/* waits for the staged chunks still in flight */
+void   io_drain ( io_file_t *file );
+
+/* zeroes up to the next page boundary of a file opened with "wb" and sends the staged pages */
+void   io_pad   ( io_file_t *file );
+
+/* asks the file system for 'bytes' of blocks without changing the file size */
+void   io_reserve ( io_file_t *file, const size_t bytes );
+
+/* prints (STATS) and resets what each backend read and wrote since the last report */
+void   io_report ( const char *pass );
+
+/* moves the read position of a file opened with "rb" */
+void   io_seek  ( io_file_t *file, const size_t offset );
+size_t io_size  ( io_file_t *file );
+
+#endif /* end of _FWI_IO_H_ definition */
@@ -31,6 +31,8 @@
 #define _FWI_KERNEL_H_
 
 #include "fwi_propagator.h"
+#include "fwi_snapshot.h"
+#include "fwi_domain.h"
 
 /*
  * Ensures that the domain contains a minimum number of planes.
@@ -40,6 +42,20 @@ void check_domain_dimensions ( const integer dimmz,
                                const integer dimmx,
                                const integer dimmy);
 
+/* how the pages of the shot arena are placed on NUMA nodes (FWI_NUMA) */
+typedef enum {SERIAL_TOUCH, FIRST_TOUCH, BIND_PAGES} numa_placement_t;
+
+extern numa_placement_t numa_placement;
+
+void select_numa_placement (void);
+
+/* how the initial velocity model is read (FWI_MODEL_LOADER) */
+typedef enum {READ_LOADER, MMAP_LOADER} model_loader_t;
+
+extern model_loader_t model_loader;
+
+void select_model_loader (void);
+
 void set_array_to_random_real(real* restrict array,
                               const integer length);
 
@@ -60,6 +76,18 @@ void free_memory_shot( coeff_t *c,
                        v_t     *v,
                        real    **rho);
 
+/* unmaps the arena kept by free_memory_shot for reuse */
+void release_shot_arena (void);
+
+void build_coeff_cache( const integer      dimmz,
+                        const integer      dimmx,
+                        const integer      dimmy,
+                        coeff_t            *c,
+                        const real         *rho,
+                        const cache_mode_t mode);
+
+void free_coeff_cache( coeff_t *c );
+
 void check_memory_shot( const integer dimmz,
                         const integer dimmx,
                         const integer dimmy,
@@ -70,15 +98,12 @@ void check_memory_shot( const integer dimmz,
 
 /* --------------- I/O RELATED FUNCTIONS -------------------------------------- */
 
-void load_local_velocity_model ( const real    waveletFreq,
-                                 const integer dimmz,
-                                 const integer dimmx,
-                                 const integer FirstYPlane,
-                                 const integer LastYPlane,
-                                 coeff_t *c,
-                                 s_t     *s,
-                                 v_t     *v,
-                                 real    *rho);
+void load_local_velocity_model ( const real      waveletFreq,
+                                 const domain_t *d,
+                                 coeff_t        *c,
+                                 s_t            *s,
+                                 v_t            *v,
+                                 real           *rho);
 
 void write_snapshot ( char         *folder,
                       const int     suffix,
@@ -95,8 +120,67 @@ void read_snapshot ( char         *folder,
                      const integer dimmy);
 
 
+/* --------------- BOUNDARY EXCHANGES ---------------------------------------- */
+
+/*
+ * Persistent exchanges of the HALO boundary planes of a shot with the
+ * neighbouring ranks of the process grid, through every face of the local
+ * volume along a split axis. The requests are set up once for the velocity and
+ * stress arrays they are opened with and started every time step: after
+ * the Phase-1 planes are computed, and waited for after the Phase-2 planes,
+ * which neither read nor write the exchanged ones. They are the only
+ * synchronisation between the ranks during the time loop.
+ *
+ * open_boundary_exchange returns NULL when there is nothing to exchange
+ * (one rank or no MPI); the other functions do nothing with NULL.
+ */
+typedef struct halo_exchange_s halo_exchange_t;
+
+/* whether the exchange waits are timed per neighbour (FWI_HALO_DIAGNOSTICS) */
+typedef enum {NO_HALO_DIAGNOSTICS, HALO_WAIT_TIMES} halo_diagnostics_t;
+
+extern halo_diagnostics_t halo_diagnostics;
+
+void select_halo_diagnostics (void);
+
+halo_exchange_t* open_boundary_exchange ( const domain_t *d,
+                                          v_t             v,
+                                          s_t             s );
+
+/* whether the planes at both ends of 'axis' (AXIS_Z, AXIS_X or AXIS_Y) are exchanged */
+int exchanges_axis ( const halo_exchange_t *halo, const int axis );
+
+void start_velocity_exchange ( halo_exchange_t *halo );
+
+void start_stress_exchange ( halo_exchange_t *halo );
+
+void wait_boundary_exchange ( halo_exchange_t *halo );
+
+void close_boundary_exchange ( halo_exchange_t *halo );
+
+
 /* --------------- WAVE PROPAGATOR FUNCTIONS --------------------------------- */
 
+/* advances (v,s) without snapshots, e.g. to recompute a forward state */
+void advance_shot ( v_t           v,
+                    s_t           s,
+                    coeff_t       coeffs,
+                    real          *rho,
+                    int           timesteps,
+                    real          dt,
+                    real          dzi,
+                    real          dxi,
+                    real          dyi,
+                    integer       nz0,
+                    integer       nzf,
+                    integer       nx0,
+                    integer       nxf,
+                    integer       ny0,
+                    integer       nyf,
+                    integer       dimmz,
+                    integer       dimmx,
+                    halo_exchange_t *halo);
+
 void propagate_shot ( time_d        direction,
                      v_t           v,
                      s_t           s,
@@ -115,77 +199,12 @@ void propagate_shot ( time_d        direction,
                      integer       ny0,
                      integer       nyf,
                      integer       stacki,
-                     char          *folder,
+                     snapshot_store_t *store,
+                     halo_exchange_t *halo,
                      real          *UNUSED(dataflush),
                      integer       dimmz,
                      integer       dimmx,
                      integer       dimmy);
 
 
-/* --------------- BOUNDARY EXCHANGES ---------------------------------------- */
-
-/*
-NAME:exchange_boundaries
-PURPOSE: data exchanges between the boundary layers of the analyzed volume
-
-v                   (in) struct containing velocity arrays (4 points / cell x 3 components / point = 12 arrays)
-numElement          (in) Number of elements to exchange
-rank                (in) MPI process identifier
-numTasks            (in) MPI number of tasks
-idxt                (in) identifier related to the folder
-nyf                 (in) final plane to be exchanged
-ny0                 (in) intial plane to be exchanged
-
-RETURN none
-*/
-
-#if defined(USE_MPI)
-#define EXCHANGE(sendbuf, recvbuf, dst, src, count) {                             \
-    exchange_buffer((sendbuf),(recvbuf),(dst),(src),(count), __FILE__, __LINE__); \
-}                                                                                 
-static inline integer exchange_buffer (const real*   sendbuf, 
-                                             real*   recvbuf, 
-                                       const integer dst, 
-                                       const integer src, 
-                                       const integer message_size,
-                                       const char*   file,
-                                       const integer line)
-{
-    int err;
-    int tag = 100;
-    
-    print_debug( "         [BEFORE]MPI sendrecv [count:%d][dst:%d][src:%d] %s : %d", message_size,  dst, src, file, line);
-
-    MPI_Status  statuses[2];
-    MPI_Request requests[2];
-
-#if defined(_OPENACC)
-    #pragma acc host_data use_device(recvbuf, sendbuf)
-#endif
-    {
-        MPI_Irecv( recvbuf, message_size, MPI_FLOAT, dst, tag, MPI_COMM_WORLD, &requests[0] );
-        MPI_Isend( sendbuf, message_size, MPI_FLOAT, dst, tag, MPI_COMM_WORLD, &requests[1] );
-    }
-
-    err = MPI_Waitall(2, requests, statuses);
-
-    print_debug( "         [AFTER ]MPI sendrecv                          %s : %d", file, line);
-    
-    return err;
-};
-
-void exchange_velocity_boundaries ( v_t v, 
-                                    const integer plane_size, 
-                                    const integer nyf, 
-                                    const integer ny0 );
-
-void exchange_stress_boundaries ( s_t s, 
-                                  const integer plane_size, 
-                                  const integer nyf, 
-                                  const integer ny0 );
-#else
-#define EXCHANGE(sendbuf, recvbuf, dst, src, count)
-#endif
-
-
 #endif /* end of _FWI_KERNEL_H_ definition */
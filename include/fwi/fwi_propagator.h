@@ -57,6 +57,9 @@ typedef struct {
     point_s_t tl, tr, bl, br;
 } s_t;
 
+typedef struct coeff_cache_s coeff_cache_t;
+typedef struct shot_arena_s  shot_arena_t;
+
 /* coefficients for materials */
 typedef struct {
     real *c11, *c12, *c13, *c14, *c15, *c16;
@@ -65,8 +68,16 @@ typedef struct {
     real *c44, *c45, *c46;
     real *c55, *c56;
     real *c66;
+    coeff_cache_t *cache; /* precomputed cell averages, NULL if disabled */
+    shot_arena_t  *arena; /* allocation backing every shot array, see alloc_memory_shot */
 } coeff_t;
 
+/* cell-averaged coefficients and inverse densities, constant during a shot */
+struct coeff_cache_s {
+    real   *rho_tl, *rho_tr, *rho_bl, *rho_br;
+    coeff_t tl, tr, bl, br; /* arrays are NULL when only rho is cached */
+};
+
 #define C0 1.2f
 #define C1 1.4f
 #define C2 1.6f
@@ -77,6 +88,49 @@ typedef struct {
 typedef enum {back_offset, forw_offset} offset_t;
 typedef enum {ONE_R, ONE_L, TWO, H2D, D2H} phase_t;
 
+/* propagator engines: one sweep per component (SPLIT) or one sweep per phase (FUSED) */
+typedef enum {SPLIT_ENGINE, FUSED_ENGINE} engine_t;
+
+/* which cell averages are precomputed for the fused engines */
+typedef enum {NO_CACHE, RHO_CACHE, FULL_CACHE} cache_mode_t;
+
+/* instruction set used by the fused engines */
+typedef enum {SIMD_NONE, SIMD_AVX2, SIMD_AVX512} simd_isa_t;
+
+/* traversal of the fused engines: y-planes (NO), cache-sized (AUTO) or user given (FIXED) tiles */
+typedef enum {NO_TILING, AUTO_TILING, FIXED_TILING} tiling_t;
+
+/* cells per tile along each axis, 0 stands for the whole range */
+typedef struct {
+    integer z, x, y;
+} tile_t;
+
+extern engine_t     velocity_engine;
+extern engine_t     stress_engine;
+extern cache_mode_t coeff_cache_mode;
+extern simd_isa_t   simd_isa;
+extern tiling_t     tiling_mode;
+extern tile_t       propagator_tile;
+extern integer      time_block_steps;
+
+simd_isa_t detect_simd_isa (void);
+
+size_t cache_size_per_core (void);
+
+tile_t auto_tile_size (const integer nz,
+                       const integer nx,
+                       const size_t  cache_bytes);
+
+size_t cache_size_per_thread (void);
+
+tile_t auto_time_tile_size (const integer nz,
+                            const integer nx,
+                            const integer ny,
+                            const integer steps,
+                            const size_t  cache_bytes);
+
+void select_propagator_engines (void);
+
 #if defined(_OPENACC) 
 #pragma acc routine seq
 #endif
@@ -356,6 +410,37 @@ void compute_component_vcell_BL_cuda ( float* vptr,
                                  void*        stream);
 
 
+/*
+ * Host kernels specialised for the offsets velocity_propagator uses with
+ * each cell type: TL (back,back,forw), TR (back,forw,back), BL (forw,back,
+ * back) and BR (forw,forw,forw). Offsets are compile-time constants; the
+ * generic compute_component_vcell_* remain as the reference and the
+ * accelerator kernels.
+ */
+#define DECLARE_VCELL_SPEC(CELL)                                                      \
+void compute_component_vcell_##CELL##_spec (      real* restrict vptr,               \
+                                            const real* restrict szptr,              \
+                                            const real* restrict sxptr,              \
+                                            const real* restrict syptr,              \
+                                            const real* restrict rho,                \
+                                            const real           dt,                 \
+                                            const real           dzi,                \
+                                            const real           dxi,                \
+                                            const real           dyi,                \
+                                            const integer        nz0,                \
+                                            const integer        nzf,                \
+                                            const integer        nx0,                \
+                                            const integer        nxf,                \
+                                            const integer        ny0,                \
+                                            const integer        nyf,                \
+                                            const integer        dimmz,              \
+                                            const integer        dimmx);
+
+DECLARE_VCELL_SPEC(TL)
+DECLARE_VCELL_SPEC(TR)
+DECLARE_VCELL_SPEC(BL)
+DECLARE_VCELL_SPEC(BR)
+
 void velocity_propagator(v_t           v,
                          s_t           s,
                          coeff_t       coeffs,
@@ -374,6 +459,56 @@ void velocity_propagator(v_t           v,
                          const integer dimmx,
                          const phase_t phase);
 
+void velocity_fused_column(v_t           v,
+                           s_t           s,
+                           coeff_t       coeffs,
+                           const real*   rho,
+                           const real    dt,
+                           const real    dzi,
+                           const real    dxi,
+                           const real    dyi,
+                           const integer nz0,
+                           const integer nzf,
+                           const integer x,
+                           const integer y,
+                           const integer dimmz,
+                           const integer dimmx);
+
+void velocity_fused_block(v_t           v,
+                          s_t           s,
+                          coeff_t       coeffs,
+                          const real*   rho,
+                          const real    dt,
+                          const real    dzi,
+                          const real    dxi,
+                          const real    dyi,
+                          const integer nz0,
+                          const integer nzf,
+                          const integer nx0,
+                          const integer nxf,
+                          const integer ny0,
+                          const integer nyf,
+                          const integer dimmz,
+                          const integer dimmx);
+
+void velocity_propagator_fused(v_t           v,
+                               s_t           s,
+                               coeff_t       coeffs,
+                               real*         rho,
+                               const real    dt,
+                               const real    dzi,
+                               const real    dxi,
+                               const real    dyi,
+                               const integer nz0,
+                               const integer nzf,
+                               const integer nx0,
+                               const integer nxf,
+                               const integer ny0,
+                               const integer nyf,
+                               const integer dimmz,
+                               const integer dimmx,
+                               const phase_t phase);
+
 
 
 
@@ -428,6 +563,54 @@ void stress_propagator(s_t           s,
                        const integer dimmx,
                        const phase_t phase );
 
+void stress_fused_column(s_t           s,
+                         v_t           v,
+                         coeff_t       coeffs,
+                         const real    dt,
+                         const real    dzi,
+                         const real    dxi,
+                         const real    dyi,
+                         const integer nz0,
+                         const integer nzf,
+                         const integer x,
+                         const integer y,
+                         const integer dimmz,
+                         const integer dimmx);
+
+void stress_fused_block(s_t           s,
+                        v_t           v,
+                        coeff_t       coeffs,
+                        const real    dt,
+                        const real    dzi,
+                        const real    dxi,
+                        const real    dyi,
+                        const integer nz0,
+                        const integer nzf,
+                        const integer nx0,
+                        const integer nxf,
+                        const integer ny0,
+                        const integer nyf,
+                        const integer dimmz,
+                        const integer dimmx);
+
+void stress_propagator_fused(s_t           s,
+                             v_t           v,
+                             coeff_t       coeffs,
+                             real*         rho,
+                             const real    dt,
+                             const real    dzi,
+                             const real    dxi,
+                             const real    dyi,
+                             const integer nz0,
+                             const integer nzf,
+                             const integer nx0,
+                             const integer nxf,
+                             const integer ny0,
+                             const integer nyf,
+                             const integer dimmz,
+                             const integer dimmx,
+                             const phase_t phase);
+
 #if defined(_OPENACC)
 #pragma acc routine seq
 #endif
@@ -502,6 +685,16 @@ real cell_coeff_ARTM_TR ( const real* restrict ptr,
                           const integer dimmz, 
                           const integer dimmx);
 
+typedef real (*cell_coeff_t) ( const real* restrict ptr,
+                               const integer z,
+                               const integer x,
+                               const integer y,
+                               const integer dimmz,
+                               const integer dimmx);
+
+/* how the host column kernels obtain the 21 coefficients of a cell */
+typedef enum {COEFF_CACHED, COEFF_AVERAGE, COEFF_ARTM} coeff_kind_t;
+
 void compute_component_scell_TR (s_t             s,
                                  point_v_t       vnode_z,
                                  point_v_t       vnode_x,
@@ -811,6 +1004,76 @@ void compute_component_scell_BL_cuda ( float* sxxptr,
                                  void*        stream);
 
 
+/*
+ * Host kernels specialised for the offsets stress_propagator uses with
+ * each cell type: BR (forw,back,back), BL (forw,back,forw), TR (back,forw,
+ * forw) and TL (back,back,back). As compute_component_scell_BL, the BL
+ * kernel accumulates into s.br.
+ */
+#define DECLARE_SCELL_SPEC(CELL)                                                      \
+void compute_component_scell_##CELL##_spec (s_t           s,                         \
+                                            point_v_t     vnode_z,                   \
+                                            point_v_t     vnode_x,                   \
+                                            point_v_t     vnode_y,                   \
+                                            coeff_t       coeffs,                    \
+                                            const real    dt,                        \
+                                            const real    dzi,                       \
+                                            const real    dxi,                       \
+                                            const real    dyi,                       \
+                                            const integer nz0,                       \
+                                            const integer nzf,                       \
+                                            const integer nx0,                       \
+                                            const integer nxf,                       \
+                                            const integer ny0,                       \
+                                            const integer nyf,                       \
+                                            const integer dimmz,                     \
+                                            const integer dimmx);
+
+DECLARE_SCELL_SPEC(BR)
+DECLARE_SCELL_SPEC(BL)
+DECLARE_SCELL_SPEC(TR)
+DECLARE_SCELL_SPEC(TL)
+
+/* ------------------------------------------------------------------------------ */
+/*                                                                                */
+/*                         VECTORIZED FUSED ENGINES                               */
+/*                                                                                */
+/* ------------------------------------------------------------------------------ */
+
+#if defined(USE_SIMD_KERNELS)
+#define DECLARE_SIMD_COLUMNS(ISA)                                                 \
+void velocity_fused_column_##ISA (v_t           v,                               \
+                                  s_t           s,                               \
+                                  coeff_t       coeffs,                          \
+                                  const real*   rho,                             \
+                                  const real    dt,                              \
+                                  const real    dzi,                             \
+                                  const real    dxi,                             \
+                                  const real    dyi,                             \
+                                  const integer nz0,                             \
+                                  const integer nzf,                             \
+                                  const integer x,                               \
+                                  const integer y,                               \
+                                  const integer dimmz,                           \
+                                  const integer dimmx);                          \
+void stress_fused_column_##ISA   (s_t           s,                               \
+                                  v_t           v,                               \
+                                  coeff_t       coeffs,                          \
+                                  const real    dt,                              \
+                                  const real    dzi,                             \
+                                  const real    dxi,                             \
+                                  const real    dyi,                             \
+                                  const integer nz0,                             \
+                                  const integer nzf,                             \
+                                  const integer x,                               \
+                                  const integer y,                               \
+                                  const integer dimmz,                           \
+                                  const integer dimmx);
+
+DECLARE_SIMD_COLUMNS(avx2)
+DECLARE_SIMD_COLUMNS(avx512)
+#endif /* end USE_SIMD_KERNELS */
+
 #ifdef __cplusplus
 }
 #endif /* extern "C" */
@@ -56,6 +56,9 @@ typedef struct{
     integer    *dimmy;
     integer    *ppd;
     integer    *nworkers;
+    integer    *gridz;      /* ranks of the process grid along z, x and y */
+    integer    *gridx;
+    integer    *gridy;
 } schedule_t;
 
 void schedule_free( schedule_t S );
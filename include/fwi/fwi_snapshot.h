@@ -0,0 +1,196 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_SNAPSHOT_H_
+#define _FWI_SNAPSHOT_H_
+
+#include "fwi_propagator.h"
+#include "fwi_checkpoint.h"
+#include "fwi_codec.h"
+#include "fwi_io.h"
+
+/* staging buffers of the asynchronous snapshot writer (FWI_SNAPSHOT_BUFFERS, 0 = synchronous) */
+extern int snapshot_buffers;
+/* snapshots read ahead during the backward pass (FWI_SNAPSHOT_PREFETCH, 0 = synchronous) */
+extern int snapshot_prefetch;
+
+/* where the snapshots of a shot are kept (FWI_SNAPSHOT_STORE) */
+typedef enum {AUTO_STORE, MEMORY_STORE, DISK_STORE, HYBRID_STORE} store_backend_t;
+
+extern store_backend_t snapshot_store_mode;
+/* bytes of snapshots kept in memory per process (FWI_SNAPSHOT_MEMORY in MiB, 0 = auto) */
+extern size_t          snapshot_memory_budget;
+
+/* how the disk snapshots of a shot are laid out (FWI_SNAPSHOT_LAYOUT) */
+typedef enum {CONTAINER_LAYOUT, FILE_LAYOUT} snapshot_layout_t;
+
+extern snapshot_layout_t snapshot_layout;
+
+void select_snapshot_pipeline (void);
+
+/* velocity components in the order they are laid out in a snapshot */
+void snapshot_fields ( v_t *v, real* fields[12] );
+
+/* parallel copy of 'nfields' arrays to consecutive ranges of 'buffer' (to_buffer) or back */
+void stage_fields ( real          *buffer,
+                    real         **fields,
+                    const int      nfields,
+                    const integer  cellsInVolume,
+                    const int      to_buffer );
+
+/* reads a whole snapshot file into a buffer of 'capacity' bytes */
+size_t read_snapshot_bytes ( io_file_t    *snapshot,
+                             const char   *fname,
+                             void         *buffer,
+                             const size_t  capacity );
+
+/*
+ * Disk snapshots of one shot and rank in a single file, 'snapshots.<rank>':
+ * a header page with the index of every snapshot (suffix, offset, encoded
+ * bytes) followed by the snapshots, each starting at a page boundary. The
+ * file is preallocated for 'nsnapshots' snapshots, written sequentially and
+ * read with positioned reads. The index is written once the last snapshot
+ * is in, by seal_snapshot_container or the first read.
+ */
+typedef struct
+{
+    char     magic[4];
+    uint32_t capacity;    /* entries of the index */
+    uint32_t count;       /* snapshots stored */
+    uint32_t reserved;
+    uint64_t data;        /* offset of the first snapshot */
+} container_header_t;
+
+typedef struct
+{
+    int32_t  suffix;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+} container_entry_t;
+
+typedef struct snapshot_container_s snapshot_container_t;
+
+snapshot_container_t* open_snapshot_container ( char          *folder,
+                                                const integer  cellsInVolume,
+                                                const int      nsnapshots );
+
+void   append_snapshot ( snapshot_container_t *container,
+                         const int             suffix,
+                         const void           *buffer,
+                         const size_t          bytes );
+
+/* returns the encoded bytes of 'suffix', at most 'capacity' */
+size_t read_container_snapshot ( snapshot_container_t *container,
+                                 const int             suffix,
+                                 void                 *buffer,
+                                 const size_t          capacity );
+
+void   seal_snapshot_container  ( snapshot_container_t *container );
+void   close_snapshot_container ( snapshot_container_t *container );
+
+/*
+ * Background writer that drains the forward snapshots to disk while the
+ * propagator keeps computing. Velocity fields are encoded into a ring of
+ * staging buffers and only a full ring makes the time loop wait.
+ */
+typedef struct snapshot_writer_s snapshot_writer_t;
+
+/* 'container' may be NULL, then every snapshot goes to its own file */
+snapshot_writer_t* open_snapshot_writer ( char                 *folder,
+                                          const integer         cellsInVolume,
+                                          const int             nbuffers,
+                                          snapshot_container_t *container );
+
+void post_snapshot ( snapshot_writer_t *writer,
+                     const int          suffix,
+                     v_t               *v );
+
+/* waits until every posted snapshot is on disk */
+void close_snapshot_writer ( snapshot_writer_t *writer );
+
+/*
+ * Read-ahead engine of the backward pass. The snapshots it consumes (suffixes
+ * ntbwd, ntbwd - stacki, ...) are known before it starts, so a helper thread
+ * keeps the next ones of that schedule staged in memory.
+ */
+typedef struct snapshot_reader_s snapshot_reader_t;
+
+snapshot_reader_t* open_snapshot_reader ( char                 *folder,
+                                          const integer         cellsInVolume,
+                                          const int             nbuffers,
+                                          const int             first_suffix,
+                                          const int             step,
+                                          const int             nsnapshots,
+                                          snapshot_container_t *container );
+
+/* 'suffix' must be the next one of the schedule */
+void fetch_snapshot ( snapshot_reader_t *reader,
+                      const int          suffix,
+                      v_t               *v );
+
+void close_snapshot_reader ( snapshot_reader_t *reader );
+
+/*
+ * Snapshots of one shot, written by the forward pass and read back by the
+ * backward pass in the same suffix order. The store keeps the most recent
+ * ones in memory and sends the rest through the writer and reader above.
+ */
+typedef struct snapshot_store_s snapshot_store_t;
+
+/* snapshot k of the forward pass has suffix first_suffix + k * step */
+snapshot_store_t* open_snapshot_store ( char          *folder,
+                                        const integer  dimmz,
+                                        const integer  dimmx,
+                                        const integer  dimmy,
+                                        const int      first_suffix,
+                                        const int      step,
+                                        const int      nsnapshots );
+
+/* the snapshots are recomputed from the checkpoints of 'ckp' instead of being
+ * stored, the store takes ownership of it */
+void use_checkpoints ( snapshot_store_t *store,
+                       checkpointer_t   *ckp );
+
+/* 's' is only read when checkpointing */
+void store_snapshot ( snapshot_store_t *store,
+                      const int         suffix,
+                      v_t              *v,
+                      s_t              *s );
+
+void load_snapshot ( snapshot_store_t *store,
+                     const int         suffix,
+                     v_t              *v );
+
+/* called at the end of each pass */
+void flush_snapshot_store ( snapshot_store_t *store );
+
+void close_snapshot_store ( snapshot_store_t *store );
+
+#endif /* end of _FWI_SNAPSHOT_H_ definition */
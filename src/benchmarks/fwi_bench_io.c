@@ -0,0 +1,175 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_kernel.h"
+
+#include <fcntl.h>
+
+/*
+ * Write and read throughput of the stdio, direct and io_uring backends
+ * (FWI_IO_DEPTH transfers in flight) for a range of FWI_IO_CHUNK sizes. Every write is made durable (fsync) and evicted
+ * from the page cache before it is read back, so both backends hit the
+ * disk. The buffer starts at a page boundary, like the snapshot staging
+ * buffers, or 64 bytes past it, like the fields of the shot arena.
+ *
+ * Usage: fwi-bench-io [folder [MiB [repetitions]]]
+ */
+
+static void flush_file (const char *fname)
+{
+    const int fd = open( fname, O_RDONLY );
+
+    if ( fd == -1 || fsync( fd ) != 0 )
+    {
+        printf("Unable to flush %s: %s\n", fname, strerror(errno));
+        abort();
+    }
+
+    posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    close( fd );
+};
+
+/* MB/s of writing and reading back 'bytes' bytes, best of 'repetitions' */
+static void run_transfers (const char   *fname,
+                           real         *data,
+                           real         *copy,
+                           const size_t  bytes,
+                           const int     repetitions,
+                           double       *write_rate,
+                           double       *read_rate)
+{
+    *write_rate = 0.0;
+    *read_rate  = 0.0;
+
+    for (int r = 0; r < repetitions; r++)
+    {
+        double start = dtime();
+
+        io_file_t *file = io_open( fname, "wb", __FILE__, __LINE__ );
+        io_write( file, data, bytes );
+        io_close( file );
+        flush_file( fname );
+
+        const double write_time = dtime() - start;
+
+        start = dtime();
+
+        file = io_open( fname, "rb", __FILE__, __LINE__ );
+        io_read( file, copy, bytes );
+        io_close( file );
+
+        const double read_time = dtime() - start;
+
+        if ( memcmp( data, copy, bytes ) != 0 )
+        {
+            printf("Data read back from %s differs from the data written\n", fname);
+            abort();
+        }
+
+        *write_rate = fmax( *write_rate, bytes / (1.0e6 * write_time) );
+        *read_rate  = fmax( *read_rate , bytes / (1.0e6 * read_time ) );
+    }
+};
+
+int main(int argc, const char *argv[])
+{
+    if (argc > 4) {
+        printf("Invalid arguments!\n \
+                Usage: %s [folder [MiB [repetitions]]]\n", argv[0]);
+        abort();
+    }
+
+    const char *folder      = (argc > 1) ? argv[1] : ".";
+    const int   mib         = (argc > 2) ? atoi(argv[2]) : 256;
+    const int   repetitions = (argc > 3) ? atoi(argv[3]) : 3;
+
+    if ( mib < 1 || repetitions < 1 ) {
+        printf("The size and the repetitions must be positive\n");
+        abort();
+    }
+
+    /* set seed for random number generator */
+    srand(314);
+
+    const size_t bytes = (size_t) mib * 1024 * 1024;
+
+    /* one extra page to offset the unaligned transfers */
+    real *data = (real*) __malloc( PAGE_BYTES, bytes + PAGE_BYTES );
+    real *copy = (real*) __malloc( PAGE_BYTES, bytes + PAGE_BYTES );
+
+    set_array_to_random_real( data, (bytes + PAGE_BYTES) / sizeof(real) );
+
+    char fname[300];
+    sprintf( fname, "%s/fwi-bench-io.%d.bin", folder, (int) getpid() );
+
+    const size_t chunks[]  = { 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+    const int    nchunks   = sizeof(chunks) / sizeof(chunks[0]);
+    const size_t shifts[]  = { 0, ALIGN_REAL };
+
+    const io_backend_t backends[] = { STDIO_BACKEND, DIRECT_BACKEND, URING_BACKEND };
+    const char*        names[]    = { "stdio", "direct", "uring" };
+    const int          nbackends  = io_uring_supported() ? 3 : 2;
+
+    io_depth = atoi( read_env_variable_or_default( "FWI_IO_DEPTH", "4" ) );
+    if ( io_depth < 1 ) io_depth = 1;
+
+    printf("%d MiB file in %s, best of %d, %d io_uring transfers in flight%s\n", mib, folder, repetitions,
+            io_depth, (nbackends == 3) ? "" : " (io_uring not available)");
+    printf("%-8s %-10s %10s %12s %12s\n", "backend", "buffer", "chunk KiB", "write MB/s", "read MB/s");
+
+    for (int b = 0; b < nbackends; b++)
+    {
+        io_backend = backends[b];
+
+        for (int a = 0; a < 2; a++)
+        {
+            for (int k = 0; k < nchunks; k++)
+            {
+                io_chunk_bytes = chunks[k];
+
+                double write_rate, read_rate;
+                run_transfers( fname,
+                               (real*) ((char*) data + shifts[a]),
+                               (real*) ((char*) copy + shifts[a]),
+                               bytes, repetitions, &write_rate, &read_rate );
+
+                printf("%-8s %-10s %10zu %12.1f %12.1f\n",
+                        names[b], (a == 0) ? "page" : "page+64",
+                        chunks[k] / 1024, write_rate, read_rate);
+            }
+        }
+    }
+
+    remove( fname );
+
+    __free( data );
+    __free( copy );
+
+    return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_kernel.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+ * Cost per cell of the split kernels addressed through IDX() on every
+ * access (compute_component_*) versus the specialised kernels that hoist
+ * the index arithmetic to one base index per column and walk the stencils
+ * with plane/row strides (compute_component_*_spec). Reports ns/cell and,
+ * where the kernel lets us open a hardware counter, retired user-space
+ * instructions per cell. Runs on a single thread so the counter sees all
+ * the work.
+ *
+ * Usage: fwi-bench-strides [dimmz dimmx dimmy [repetitions]]
+ */
+
+static int open_instruction_counter (void)
+{
+#if defined(__linux__)
+    struct perf_event_attr attr;
+
+    memset( &attr, 0, sizeof(attr) );
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    return (int) syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+#else
+    return -1;
+#endif
+};
+
+static void start_counter (const int fd)
+{
+#if defined(__linux__)
+    if ( fd >= 0 ) {
+        ioctl( fd, PERF_EVENT_IOC_RESET , 0 );
+        ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+    }
+#endif
+};
+
+/* returns the instructions retired since start_counter, or -1 */
+static double stop_counter (const int fd)
+{
+#if defined(__linux__)
+    long long count;
+
+    if ( fd >= 0 ) {
+        ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+        if ( read( fd, &count, sizeof(count) ) == sizeof(count) ) return (double) count;
+    }
+#endif
+    return -1.0;
+};
+
+static void init_point_v (point_v_t p, const integer n)
+{
+    set_array_to_random_real( p.u, n );
+    set_array_to_random_real( p.v, n );
+    set_array_to_random_real( p.w, n );
+};
+
+static void init_point_s (point_s_t p, const integer n)
+{
+    set_array_to_random_real( p.zz, n );
+    set_array_to_random_real( p.xz, n );
+    set_array_to_random_real( p.yz, n );
+    set_array_to_random_real( p.xx, n );
+    set_array_to_random_real( p.xy, n );
+    set_array_to_random_real( p.yy, n );
+};
+
+static void init_coeffs (coeff_t c, const integer n)
+{
+    set_array_to_random_real( c.c11, n );
+    set_array_to_random_real( c.c12, n );
+    set_array_to_random_real( c.c13, n );
+    set_array_to_random_real( c.c14, n );
+    set_array_to_random_real( c.c15, n );
+    set_array_to_random_real( c.c16, n );
+    set_array_to_random_real( c.c22, n );
+    set_array_to_random_real( c.c23, n );
+    set_array_to_random_real( c.c24, n );
+    set_array_to_random_real( c.c25, n );
+    set_array_to_random_real( c.c26, n );
+    set_array_to_random_real( c.c33, n );
+    set_array_to_random_real( c.c34, n );
+    set_array_to_random_real( c.c35, n );
+    set_array_to_random_real( c.c36, n );
+    set_array_to_random_real( c.c44, n );
+    set_array_to_random_real( c.c45, n );
+    set_array_to_random_real( c.c46, n );
+    set_array_to_random_real( c.c55, n );
+    set_array_to_random_real( c.c56, n );
+    set_array_to_random_real( c.c66, n );
+};
+
+typedef enum {VELOCITY, STRESS} bench_phase_t;
+
+/*
+ * One pass of the generic or specialised kernels over the whole domain:
+ * the w component of the four velocity cell types, or the four stress
+ * cell types with all their six components.
+ */
+static void run_kernels (v_t           v,
+                         s_t           s,
+                         coeff_t       c,
+                         real*         rho,
+                         bench_phase_t which,
+                         const int     specialised,
+                         const integer dimmz,
+                         const integer dimmx,
+                         const integer dimmy)
+{
+    const real dt  = 1.0e-3f;
+    const real dzi = 1.0f;
+    const real dxi = 1.0f;
+    const real dyi = 1.0f;
+
+    const integer nz0 = HALO, nzf = dimmz - HALO;
+    const integer nx0 = HALO, nxf = dimmx - HALO;
+    const integer ny0 = HALO, nyf = dimmy - HALO;
+
+    if ( which == VELOCITY && !specialised )
+    {
+        compute_component_vcell_TL (v.tl.w, s.bl.zz, s.tr.xz, s.tl.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, back_offset, back_offset, forw_offset, dimmz, dimmx, TWO);
+        compute_component_vcell_TR (v.tr.w, s.br.zz, s.tl.xz, s.tr.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, back_offset, forw_offset, back_offset, dimmz, dimmx, TWO);
+        compute_component_vcell_BL (v.bl.w, s.tl.zz, s.br.xz, s.bl.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, forw_offset, back_offset, back_offset, dimmz, dimmx, TWO);
+        compute_component_vcell_BR (v.br.w, s.tr.zz, s.bl.xz, s.br.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, forw_offset, forw_offset, forw_offset, dimmz, dimmx, TWO);
+    }
+    else if ( which == VELOCITY )
+    {
+        compute_component_vcell_TL_spec (v.tl.w, s.bl.zz, s.tr.xz, s.tl.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_TR_spec (v.tr.w, s.br.zz, s.tl.xz, s.tr.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BL_spec (v.bl.w, s.tl.zz, s.br.xz, s.bl.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BR_spec (v.br.w, s.tr.zz, s.bl.xz, s.br.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+    }
+    else if ( !specialised )
+    {
+        compute_component_scell_BR ( s, v.tr, v.bl, v.br, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, forw_offset, back_offset, back_offset, dimmz, dimmx, TWO);
+        compute_component_scell_BL ( s, v.tl, v.br, v.bl, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, forw_offset, back_offset, forw_offset, dimmz, dimmx, TWO);
+        compute_component_scell_TR ( s, v.br, v.tl, v.tr, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, back_offset, forw_offset, forw_offset, dimmz, dimmx, TWO);
+        compute_component_scell_TL ( s, v.bl, v.tr, v.tl, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, back_offset, back_offset, back_offset, dimmz, dimmx, TWO);
+    }
+    else
+    {
+        compute_component_scell_BR_spec ( s, v.tr, v.bl, v.br, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_scell_BL_spec ( s, v.tl, v.br, v.bl, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_scell_TR_spec ( s, v.br, v.tl, v.tr, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_scell_TL_spec ( s, v.bl, v.tr, v.tl, c, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+    }
+};
+
+int main(int argc, const char *argv[])
+{
+    if (argc != 1 && argc != 4 && argc != 5) {
+        printf("Invalid arguments!\n \
+                Usage: %s [dimmz dimmx dimmy [repetitions]]\n", argv[0]);
+        abort();
+    }
+
+    const integer dimmz       = (argc > 1) ? atoi(argv[1]) : 128;
+    const integer dimmx       = (argc > 2) ? atoi(argv[2]) : 128;
+    const integer dimmy       = (argc > 3) ? atoi(argv[3]) : 32;
+    const int     repetitions = (argc > 4) ? atoi(argv[4]) : 3;
+
+    if ( dimmz <= 2*HALO || dimmx <= 2*HALO || dimmy <= 2*HALO || repetitions < 1 ) {
+        printf("Every dimension must be larger than "I" cells and repetitions positive\n", 2*HALO);
+        abort();
+    }
+
+#if defined(_OPENMP)
+    omp_set_num_threads(1);
+#endif
+
+    /* set seed for random number generator */
+    srand(314);
+
+    v_t     v;
+    s_t     s;
+    coeff_t c;
+    real    *rho;
+
+    const integer nelems = dimmz * dimmx * dimmy;
+
+    alloc_memory_shot( dimmz, dimmx, dimmy, &c, &s, &v, &rho );
+
+    init_point_v( v.tl, nelems ); init_point_v( v.tr, nelems );
+    init_point_v( v.bl, nelems ); init_point_v( v.br, nelems );
+    init_point_s( s.tl, nelems ); init_point_s( s.tr, nelems );
+    init_point_s( s.bl, nelems ); init_point_s( s.br, nelems );
+    init_coeffs ( c, nelems );
+    set_array_to_random_real( rho, nelems );
+
+    const int    fd    = open_instruction_counter();
+    const double cells = (double) (dimmz - 2*HALO) * (dimmx - 2*HALO) * (dimmy - 2*HALO) * repetitions;
+
+    printf("Domain "I"x"I"x"I" cells, %d repetitions, single thread\n", dimmz, dimmx, dimmy, repetitions);
+    if ( fd < 0 ) printf("Hardware instruction counter not available, reporting time only\n");
+    printf("%-9s %-12s %10s %12s %9s\n", "phase", "addressing", "ns/cell", "instr/cell", "speedup");
+
+    for (int which = VELOCITY; which <= STRESS; which++)
+    {
+        double elapsed[2];
+
+        for (int specialised = 0; specialised < 2; specialised++)
+        {
+            /* warm-up pass, faults in the pages and the caches */
+            run_kernels( v, s, c, rho, which, specialised, dimmz, dimmx, dimmy );
+
+            start_counter( fd );
+            const double start = dtime();
+
+            for (int r = 0; r < repetitions; r++)
+                run_kernels( v, s, c, rho, which, specialised, dimmz, dimmx, dimmy );
+
+            elapsed[specialised]     = dtime() - start;
+            const double instructions = stop_counter( fd );
+
+            printf("%-9s %-12s %10.2f ", (which == VELOCITY) ? "velocity" : "stress",
+                    (specialised) ? "strided" : "IDX()", elapsed[specialised] * 1.0e9 / cells);
+
+            if ( instructions >= 0.0 ) printf("%12.1f ", instructions / cells);
+            else                       printf("%12s ", "n/a");
+
+            printf("%9.2f\n", elapsed[0] / elapsed[specialised]);
+        }
+    }
+
+    if ( fd >= 0 ) close( fd );
+
+    free_memory_shot( &c, &s, &v, &rho );
+
+    return 0;
+}
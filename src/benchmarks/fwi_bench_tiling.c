@@ -0,0 +1,196 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_kernel.h"
+
+/*
+ * Throughput of the fused propagators (one velocity plus one stress update
+ * per time step) with the classic plane-by-plane traversal and with cache
+ * blocked tiles. Instruction set and coefficient cache follow the usual
+ * FWI_SIMD_ISA and FWI_COEFF_CACHE variables; a FWI_TILE=ZxX[xY] setting
+ * is measured as an additional configuration.
+ *
+ * Usage: fwi-bench-tiling [dimmz dimmx dimmy [timesteps]]
+ */
+
+static void init_point_v (point_v_t p, const integer n)
+{
+    set_array_to_random_real( p.u, n );
+    set_array_to_random_real( p.v, n );
+    set_array_to_random_real( p.w, n );
+};
+
+static void init_point_s (point_s_t p, const integer n)
+{
+    set_array_to_random_real( p.zz, n );
+    set_array_to_random_real( p.xz, n );
+    set_array_to_random_real( p.yz, n );
+    set_array_to_random_real( p.xx, n );
+    set_array_to_random_real( p.xy, n );
+    set_array_to_random_real( p.yy, n );
+};
+
+static void init_coeffs (coeff_t c, const integer n)
+{
+    set_array_to_random_real( c.c11, n );
+    set_array_to_random_real( c.c12, n );
+    set_array_to_random_real( c.c13, n );
+    set_array_to_random_real( c.c14, n );
+    set_array_to_random_real( c.c15, n );
+    set_array_to_random_real( c.c16, n );
+    set_array_to_random_real( c.c22, n );
+    set_array_to_random_real( c.c23, n );
+    set_array_to_random_real( c.c24, n );
+    set_array_to_random_real( c.c25, n );
+    set_array_to_random_real( c.c26, n );
+    set_array_to_random_real( c.c33, n );
+    set_array_to_random_real( c.c34, n );
+    set_array_to_random_real( c.c35, n );
+    set_array_to_random_real( c.c36, n );
+    set_array_to_random_real( c.c44, n );
+    set_array_to_random_real( c.c45, n );
+    set_array_to_random_real( c.c46, n );
+    set_array_to_random_real( c.c55, n );
+    set_array_to_random_real( c.c56, n );
+    set_array_to_random_real( c.c66, n );
+};
+
+/* returns the Mcells/s achieved by 'timesteps' full time steps */
+static double run_timesteps (v_t           v,
+                             s_t           s,
+                             coeff_t       c,
+                             real*         rho,
+                             const int     timesteps,
+                             const integer dimmz,
+                             const integer dimmx,
+                             const integer dimmy)
+{
+    const real dt  = 1.0e-3f;
+    const real dzi = 1.0f;
+    const real dxi = 1.0f;
+    const real dyi = 1.0f;
+
+    const integer nz0 = HALO, nzf = dimmz - HALO;
+    const integer nx0 = HALO, nxf = dimmx - HALO;
+    const integer ny0 = HALO, nyf = dimmy - HALO;
+
+    const double start = dtime();
+
+    for (int t = 0; t < timesteps; t++)
+    {
+        velocity_propagator(v, s, c, rho, dt, dzi, dxi, dyi,
+                            nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, TWO);
+
+        stress_propagator(s, v, c, rho, dt, dzi, dxi, dyi,
+                          nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, TWO);
+    }
+
+    const double elapsed = dtime() - start;
+    const double cells   = (double) (nzf - nz0) * (nxf - nx0) * (nyf - ny0);
+
+    return (cells * timesteps) / (elapsed * 1.0e6);
+};
+
+int main(int argc, const char *argv[])
+{
+    if (argc != 1 && argc != 4 && argc != 5) {
+        printf("Invalid arguments!\n \
+                Usage: %s [dimmz dimmx dimmy [timesteps]]\n", argv[0]);
+        abort();
+    }
+
+    const integer dimmz     = (argc > 1) ? atoi(argv[1]) : 256;
+    const integer dimmx     = (argc > 2) ? atoi(argv[2]) : 256;
+    const integer dimmy     = (argc > 3) ? atoi(argv[3]) : 32;
+    const int     timesteps = (argc > 4) ? atoi(argv[4]) : 5;
+
+    if ( dimmz <= 2*HALO || dimmx <= 2*HALO || dimmy <= 2*HALO || timesteps < 1 ) {
+        printf("Every dimension must be larger than "I" cells and timesteps positive\n", 2*HALO);
+        abort();
+    }
+
+    /* set seed for random number generator */
+    srand(314);
+
+    select_propagator_engines();
+    velocity_engine = FUSED_ENGINE;
+    stress_engine   = FUSED_ENGINE;
+
+    const tiling_t user_tiling = tiling_mode;
+
+    v_t     v;
+    s_t     s;
+    coeff_t c;
+    real    *rho;
+
+    const integer nelems = dimmz * dimmx * dimmy;
+
+    alloc_memory_shot( dimmz, dimmx, dimmy, &c, &s, &v, &rho );
+
+    init_point_v( v.tl, nelems ); init_point_v( v.tr, nelems );
+    init_point_v( v.bl, nelems ); init_point_v( v.br, nelems );
+    init_point_s( s.tl, nelems ); init_point_s( s.tr, nelems );
+    init_point_s( s.bl, nelems ); init_point_s( s.br, nelems );
+    init_coeffs ( c, nelems );
+    set_array_to_random_real( rho, nelems );
+
+    build_coeff_cache( dimmz, dimmx, dimmy, &c, rho, coeff_cache_mode );
+
+    const tile_t tile = auto_tile_size( dimmz - 2*HALO, dimmx - 2*HALO, cache_size_per_core() );
+
+    printf("Domain "I"x"I"x"I" cells, %d time steps, %zu KiB cache per core\n",
+            dimmz, dimmx, dimmy, timesteps, cache_size_per_core() / 1024);
+    printf("%-10s %-16s %12s %9s\n", "traversal", "tile (z,x,y)", "Mcells/s", "speedup");
+
+    /* one warm-up step faults in all the pages */
+    tiling_mode = NO_TILING;
+    run_timesteps( v, s, c, rho, 1, dimmz, dimmx, dimmy );
+
+    const double untiled = run_timesteps( v, s, c, rho, timesteps, dimmz, dimmx, dimmy );
+    printf("%-10s %-16s %12.1f %9.2f\n", "untiled", "-", untiled, 1.0);
+
+    char tilename[64];
+
+    tiling_mode = AUTO_TILING;
+    const double autotiled = run_timesteps( v, s, c, rho, timesteps, dimmz, dimmx, dimmy );
+    sprintf( tilename, I"x"I"x%s", tile.z, tile.x, "all" );
+    printf("%-10s %-16s %12.1f %9.2f\n", "auto", tilename, autotiled, autotiled / untiled);
+
+    if ( user_tiling == FIXED_TILING )
+    {
+        tiling_mode = FIXED_TILING;
+        const double fixed = run_timesteps( v, s, c, rho, timesteps, dimmz, dimmx, dimmy );
+        sprintf( tilename, I"x"I"x"I, propagator_tile.z, propagator_tile.x, propagator_tile.y );
+        printf("%-10s %-16s %12.1f %9.2f\n", "FWI_TILE", tilename, fixed, fixed / untiled);
+    }
+
+    free_memory_shot( &c, &s, &v, &rho );
+
+    return 0;
+}
@@ -0,0 +1,432 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_checkpoint.h"
+#include "fwi/fwi_kernel.h"
+
+int checkpoint_budget = 0;
+
+/*
+ * FWI_CHECKPOINTS sets how many full states per shot the RTM forward pass
+ * keeps in memory instead of writing its snapshots. The backward pass then
+ * recomputes every snapshot from the closest checkpoint.
+ */
+void select_checkpointing (void)
+{
+    const char* name = read_env_variable_or_default( "FWI_CHECKPOINTS", "0" );
+
+    if ( strlen( name ) > 0 && strspn( name, "0123456789" ) == strlen( name ) )
+        checkpoint_budget = atoi( name );
+    else
+    {
+        print_error("Invalid number of checkpoints '%s' in FWI_CHECKPOINTS, disabling checkpointing", name);
+        checkpoint_budget = 0;
+    }
+
+#if defined(_OPENACC)
+    if ( checkpoint_budget > 0 )
+    {
+        print_info("Checkpointing recomputes the states on the host, not available with OpenACC");
+        checkpoint_budget = 0;
+    }
+#endif
+
+    if ( checkpoint_budget > 0 )
+        print_info("Checkpointing: %d full states per shot", checkpoint_budget);
+    else
+        print_info("Checkpointing: disabled");
+};
+
+void state_fields ( v_t *v, s_t *s, real* fields[STATE_FIELDS] )
+{
+    snapshot_fields( v, fields );
+
+    real** f = fields + 12;
+
+    f[ 0] = s->tr.zz; f[ 1] = s->tr.xz; f[ 2] = s->tr.yz; f[ 3] = s->tr.xx; f[ 4] = s->tr.xy; f[ 5] = s->tr.yy;
+    f[ 6] = s->tl.zz; f[ 7] = s->tl.xz; f[ 8] = s->tl.yz; f[ 9] = s->tl.xx; f[10] = s->tl.xy; f[11] = s->tl.yy;
+    f[12] = s->br.zz; f[13] = s->br.xz; f[14] = s->br.yz; f[15] = s->br.xx; f[16] = s->br.xy; f[17] = s->br.yy;
+    f[18] = s->bl.zz; f[19] = s->bl.xz; f[20] = s->bl.yz; f[21] = s->bl.xx; f[22] = s->bl.xy; f[23] = s->bl.yy;
+};
+
+/*
+ * Delivering L states in reverse order from a checkpoint on the first one
+ * either advances from it for every state (L(L-1)/2 intervals) or advances m
+ * intervals, takes a checkpoint there, delivers the last L-m states with one
+ * slot less and then the first m states with the slot freed again.
+ */
+void plan_revolve ( const int  nstates,
+                    const int  nfree,
+                    long      *cost,
+                    int       *split )
+{
+    const int S = nfree + 1;
+
+    for (int L = 1; L <= nstates; L++)
+        for (int s = 0; s <= nfree; s++)
+        {
+            long best  = ((long) L * (L - 1)) / 2;
+            int  bestm = 0;
+
+            if ( s > 0 )
+                for (int m = 1; m < L; m++)
+                {
+                    const long c = m + cost[(L - m) * S + s - 1] + cost[m * S + s];
+
+                    if ( c < best ) { best = c; bestm = m; }
+                }
+
+            cost [L * S + s] = best;
+            split[L * S + s] = bestm;
+        }
+};
+
+struct checkpointer_s
+{
+    int      nslots;
+    int      nsnapshots;
+    int      first_suffix;
+    int      step;
+    integer  stacki;
+
+    /* propagation parameters to recompute the forward pass */
+    coeff_t  coeffs;
+    real    *rho;
+    real     dt, dzi, dxi, dyi;
+    integer  nz0, nzf, nx0, nxf, ny0, nyf;
+    integer  dimmz, dimmx;
+    integer  cellsInVolume;
+    size_t   state_bytes;
+
+    long    *cost;
+    int     *split;
+
+    real   **slots;        /* full states, allocated on first use */
+    int     *position;     /* snapshot held by each slot, -1 if free */
+
+    real    *workspace;    /* state being recomputed */
+    v_t      wv;
+    s_t      ws;
+    int      wpos;         /* snapshot held by the workspace, -1 if none */
+    halo_exchange_t *halo; /* boundary exchanges of the workspace */
+
+    char    *delivered;
+    int      pending;      /* last snapshot the backward pass has not asked for yet */
+    int      next_forward; /* next forward snapshot to keep, -1 if none */
+
+    /* statistics */
+    long     advanced;     /* snapshot intervals recomputed */
+    int      restores;
+};
+
+static int free_slots ( checkpointer_t *c )
+{
+    int nfree = 0;
+
+    for (int i = 0; i < c->nslots; i++)
+        if ( c->position[i] < 0 ) nfree++;
+
+    return nfree;
+};
+
+static int take_slot ( checkpointer_t *c, const int k, const int dry )
+{
+    for (int i = 0; i < c->nslots; i++)
+        if ( c->position[i] < 0 )
+        {
+            c->position[i] = k;
+
+            if ( !dry && c->slots[i] == NULL )
+                c->slots[i] = (real*) __malloc_pages( c->state_bytes );
+
+            return i;
+        }
+
+    print_error("No free checkpoint slot for snapshot %d", k);
+    abort();
+};
+
+/*
+ * Advance of the next checkpoint when L states remain from the current one.
+ */
+static int next_split ( checkpointer_t *c, const int L )
+{
+    const int nfree = min_int( free_slots( c ), c->nslots - 1 );
+
+    return ( nfree > 0 && L > 1 ) ? c->split[ L * c->nslots + nfree ] : 0;
+};
+
+/*
+ * Forward pass: keeps state k when the plan puts a checkpoint on it.
+ */
+static void keep_forward ( checkpointer_t *c, const int k, v_t *v, s_t *s, const int dry )
+{
+    if ( k != c->next_forward ) return;
+
+    const int slot = take_slot( c, k, dry );
+
+    if ( !dry )
+    {
+        real* fields[STATE_FIELDS];
+        state_fields( v, s, fields );
+        stage_fields( c->slots[slot], fields, STATE_FIELDS, c->cellsInVolume, 1 );
+    }
+
+    const int m = next_split( c, c->nsnapshots - k );
+    c->next_forward = ( m > 0 ) ? k + m : -1;
+};
+
+/*
+ * Backward pass: puts the velocity of state k into v, from its checkpoint or
+ * by advancing the workspace from the closest earlier state. Checkpoints are
+ * taken on the way following the plan, and released once no later state is
+ * pending.
+ */
+static void deliver ( checkpointer_t *c, const int k, v_t *v, const int dry )
+{
+    real* vfields[12];
+    real* wfields[STATE_FIELDS];
+
+    if ( !dry )
+    {
+        snapshot_fields( v, vfields );
+        state_fields( &c->wv, &c->ws, wfields );
+    }
+
+    c->delivered[k] = 1;
+
+    int held = -1;
+    for (int i = 0; i < c->nslots; i++)
+        if ( c->position[i] == k ) held = i;
+
+    if ( held >= 0 )
+    {
+        if ( !dry ) stage_fields( c->slots[held], vfields, 12, c->cellsInVolume, 0 );
+    }
+    else
+    {
+        int base = ( c->wpos >= 0 && c->wpos <= k ) ? c->wpos : -1;
+        int from = -1;
+
+        for (int i = 0; i < c->nslots; i++)
+            if ( c->position[i] >= 0 && c->position[i] <= k && c->position[i] > base )
+            {
+                base = c->position[i];
+                from = i;
+            }
+
+        if ( base < 0 )
+        {
+            print_error("No checkpoint before snapshot %d", k);
+            abort();
+        }
+
+        if ( from >= 0 )
+        {
+            if ( !dry ) stage_fields( c->slots[from], wfields, STATE_FIELDS, c->cellsInVolume, 0 );
+            c->wpos = base;
+            c->restores++;
+        }
+
+        while ( c->wpos < k )
+        {
+            const int m      = next_split( c, k - c->wpos + 1 );
+            const int target = ( m > 0 ) ? c->wpos + m : k;
+
+            if ( !dry )
+                advance_shot( c->wv, c->ws, c->coeffs, c->rho, (target - c->wpos) * c->stacki,
+                              c->dt, c->dzi, c->dxi, c->dyi,
+                              c->nz0, c->nzf, c->nx0, c->nxf, c->ny0, c->nyf,
+                              c->dimmz, c->dimmx, c->halo );
+
+            c->advanced += target - c->wpos;
+            c->wpos      = target;
+
+            if ( target < k )
+            {
+                const int slot = take_slot( c, target, dry );
+                if ( !dry ) stage_fields( c->slots[slot], wfields, STATE_FIELDS, c->cellsInVolume, 1 );
+            }
+        }
+
+        if ( !dry ) stage_fields( c->workspace, vfields, 12, c->cellsInVolume, 0 );
+    }
+
+    /* checkpoints past the last pending state will not be used again */
+    while ( c->pending >= 0 && c->delivered[ c->pending ] ) c->pending--;
+
+    for (int i = 0; i < c->nslots; i++)
+        if ( c->position[i] > c->pending ) c->position[i] = -1;
+};
+
+static void reset_checkpointer ( checkpointer_t *c )
+{
+    for (int i = 0; i < c->nslots; i++) c->position[i] = -1;
+    memset( c->delivered, 0, c->nsnapshots );
+
+    c->wpos         = -1;
+    c->pending      = c->nsnapshots - 1;
+    c->next_forward = 0;
+    c->advanced     = 0;
+    c->restores     = 0;
+};
+
+checkpointer_t* open_checkpointer ( const int      nslots,
+                                    const int      nsnapshots,
+                                    const int      first_suffix,
+                                    const int      step,
+                                    const integer  stacki,
+                                    coeff_t        coeffs,
+                                    real          *rho,
+                                    const real     dt,
+                                    const real     dzi,
+                                    const real     dxi,
+                                    const real     dyi,
+                                    const integer  nz0,
+                                    const integer  nzf,
+                                    const integer  nx0,
+                                    const integer  nxf,
+                                    const integer  ny0,
+                                    const integer  nyf,
+                                    const integer  dimmz,
+                                    const integer  dimmx,
+                                    const integer  dimmy,
+                                    const domain_t *domain )
+{
+    checkpointer_t *c = (checkpointer_t*) calloc( 1, sizeof(checkpointer_t) );
+
+    c->nslots        = max_int( 1, min_int( nslots, nsnapshots ) );
+    c->nsnapshots    = nsnapshots;
+    c->first_suffix  = first_suffix;
+    c->step          = step;
+    c->stacki        = stacki;
+    c->coeffs        = coeffs;
+    c->rho           = rho;
+    c->dt            = dt;
+    c->dzi           = dzi;
+    c->dxi           = dxi;
+    c->dyi           = dyi;
+    c->nz0 = nz0; c->nzf = nzf;
+    c->nx0 = nx0; c->nxf = nxf;
+    c->ny0 = ny0; c->nyf = nyf;
+    c->dimmz         = dimmz;
+    c->dimmx         = dimmx;
+    c->cellsInVolume = dimmz * dimmx * dimmy;
+    c->state_bytes   = (size_t) c->cellsInVolume * sizeof(real) * STATE_FIELDS;
+
+    c->cost      = (long*) calloc( (size_t) (nsnapshots + 1) * c->nslots, sizeof(long) );
+    c->split     = (int* ) calloc( (size_t) (nsnapshots + 1) * c->nslots, sizeof(int ) );
+    c->slots     = (real**) calloc( c->nslots, sizeof(real*) );
+    c->position  = (int* ) calloc( c->nslots, sizeof(int) );
+    c->delivered = (char*) calloc( nsnapshots, sizeof(char) );
+
+    plan_revolve( nsnapshots, c->nslots - 1, c->cost, c->split );
+
+    /* dry run of the shot: the backward pass asks for the snapshots in the order they were taken */
+    reset_checkpointer( c );
+    for (int k = 0; k < nsnapshots; k++) keep_forward( c, k, NULL, NULL, 1 );
+    for (int k = 0; k < nsnapshots; k++) deliver( c, k, NULL, 1 );
+
+    const long   recomputed = c->advanced * stacki;
+    const double snapshots  = (double) nsnapshots * c->cellsInVolume * sizeof(real) * 12;
+
+    print_info("Checkpointing: %d full states (%lf GB) instead of %d snapshots (%lf GB)",
+            c->nslots, TOGB( c->state_bytes * c->nslots ), nsnapshots, TOGB( (size_t) snapshots ));
+    print_info("Checkpointing: %ld time steps recomputed, %lf per forward step (%ld in reverse order)",
+            recomputed, (double) recomputed / (nsnapshots * stacki),
+            (c->cost[ nsnapshots * c->nslots + c->nslots - 1 ]) * stacki);
+
+    reset_checkpointer( c );
+
+    c->workspace = (real*) __malloc_pages( c->state_bytes );
+
+    real* wfields[STATE_FIELDS];
+    for (int f = 0; f < STATE_FIELDS; f++)
+        wfields[f] = c->workspace + (size_t) f * c->cellsInVolume;
+
+    c->wv.tr.u  = wfields[ 0]; c->wv.tr.v  = wfields[ 1]; c->wv.tr.w  = wfields[ 2];
+    c->wv.tl.u  = wfields[ 3]; c->wv.tl.v  = wfields[ 4]; c->wv.tl.w  = wfields[ 5];
+    c->wv.br.u  = wfields[ 6]; c->wv.br.v  = wfields[ 7]; c->wv.br.w  = wfields[ 8];
+    c->wv.bl.u  = wfields[ 9]; c->wv.bl.v  = wfields[10]; c->wv.bl.w  = wfields[11];
+
+    c->ws.tr.zz = wfields[12]; c->ws.tr.xz = wfields[13]; c->ws.tr.yz = wfields[14];
+    c->ws.tr.xx = wfields[15]; c->ws.tr.xy = wfields[16]; c->ws.tr.yy = wfields[17];
+    c->ws.tl.zz = wfields[18]; c->ws.tl.xz = wfields[19]; c->ws.tl.yz = wfields[20];
+    c->ws.tl.xx = wfields[21]; c->ws.tl.xy = wfields[22]; c->ws.tl.yy = wfields[23];
+    c->ws.br.zz = wfields[24]; c->ws.br.xz = wfields[25]; c->ws.br.yz = wfields[26];
+    c->ws.br.xx = wfields[27]; c->ws.br.xy = wfields[28]; c->ws.br.yy = wfields[29];
+    c->ws.bl.zz = wfields[30]; c->ws.bl.xz = wfields[31]; c->ws.bl.yz = wfields[32];
+    c->ws.bl.xx = wfields[33]; c->ws.bl.xy = wfields[34]; c->ws.bl.yy = wfields[35];
+
+    c->halo = open_boundary_exchange( domain, c->wv, c->ws );
+
+    return c;
+};
+
+void checkpoint_state ( checkpointer_t *c,
+                        const int       suffix,
+                        v_t            *v,
+                        s_t            *s )
+{
+    PUSH_RANGE
+
+    keep_forward( c, (suffix - c->first_suffix) / c->step, v, s, 0 );
+
+    POP_RANGE
+};
+
+void recompute_snapshot ( checkpointer_t *c,
+                          const int       suffix,
+                          v_t            *v )
+{
+    PUSH_RANGE
+
+    deliver( c, (suffix - c->first_suffix) / c->step, v, 0 );
+
+    POP_RANGE
+};
+
+void close_checkpointer ( checkpointer_t *c )
+{
+    print_stats("Checkpointing: %ld time steps recomputed, %d restores from %d checkpoints",
+            c->advanced * c->stacki, c->restores, c->nslots);
+
+    for (int i = 0; i < c->nslots; i++)
+        if ( c->slots[i] ) __free_pages( c->slots[i], c->state_bytes );
+
+    close_boundary_exchange( c->halo );
+    __free_pages( c->workspace, c->state_bytes );
+
+    free( c->cost );
+    free( c->split );
+    free( c->slots );
+    free( c->position );
+    free( c->delivered );
+    free( c );
+};
@@ -0,0 +1,533 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_codec.h"
+#include "fwi/fwi_snapshot.h"
+
+snapshot_codec_t snapshot_codec              = RAW_CODEC;
+double           snapshot_tolerance          = 1e-4;
+int              snapshot_tolerance_relative = 1;
+
+/* cells per independently coded block */
+#define CODEC_BLOCK 16384
+
+/* block modes */
+#define CODED_BLOCK 0
+#define RAW_BLOCK   1
+
+static const char codec_magic[4] = { 'F', 'W', 'I', 'Z' };
+
+/*
+ * Lossy snapshot layout: header, the error bound of every field, the size
+ * of every block (field major) and the blocks.
+ */
+typedef struct
+{
+    char     magic[4];
+    uint32_t nfields;
+    uint32_t block;
+    uint32_t reserved;
+    uint64_t cells;
+} codec_header_t;
+
+static const char* codec_name (const snapshot_codec_t codec)
+{
+    switch ( codec )
+    {
+        case LOSSY_CODEC: return "lossy";
+        case FP16_CODEC : return "fp16";
+        case BF16_CODEC : return "bf16";
+        default         : return "raw";
+    }
+};
+
+/*
+ * FWI_SNAPSHOT_CODEC picks how snapshots are encoded: 'raw', 'lossy',
+ * 'fp16' or 'bf16'. FWI_SNAPSHOT_TOLERANCE is the error bound of the lossy codec,
+ * 'abs:<value>' or 'rel:<value>' (relative to the largest magnitude of each
+ * field).
+ */
+void select_snapshot_codec (void)
+{
+    const char* name = read_env_variable_or_default( "FWI_SNAPSHOT_CODEC", "raw" );
+
+    if      ( strcmp( name, "raw"   ) == 0 ) snapshot_codec = RAW_CODEC;
+    else if ( strcmp( name, "lossy" ) == 0 ) snapshot_codec = LOSSY_CODEC;
+    else if ( strcmp( name, "fp16"  ) == 0 ) snapshot_codec = FP16_CODEC;
+    else if ( strcmp( name, "bf16"  ) == 0 ) snapshot_codec = BF16_CODEC;
+    else
+    {
+        print_error("Unknown snapshot codec '%s' in FWI_SNAPSHOT_CODEC, using 'raw'", name);
+        snapshot_codec = RAW_CODEC;
+    }
+
+    const char* tolerance = read_env_variable_or_default( "FWI_SNAPSHOT_TOLERANCE", "rel:1e-4" );
+
+    char   kind[4];
+    double value;
+    char   extra;
+
+    if ( sscanf( tolerance, "%3[a-z]:%lf%c", kind, &value, &extra ) == 2 && value >= 0.0 &&
+         ( strcmp( kind, "abs" ) == 0 || strcmp( kind, "rel" ) == 0 ) )
+    {
+        snapshot_tolerance          = value;
+        snapshot_tolerance_relative = ( strcmp( kind, "rel" ) == 0 );
+    }
+    else
+    {
+        print_error("Invalid snapshot tolerance '%s' in FWI_SNAPSHOT_TOLERANCE, using 'rel:1e-4'", tolerance);
+        snapshot_tolerance          = 1e-4;
+        snapshot_tolerance_relative = 1;
+    }
+
+    if ( snapshot_codec == LOSSY_CODEC )
+        print_info("Snapshot codec: %s, %s error bound %g", codec_name( snapshot_codec ),
+                snapshot_tolerance_relative ? "relative" : "absolute", snapshot_tolerance);
+    else
+        print_info("Snapshot codec: %s", codec_name( snapshot_codec ));
+};
+
+static integer codec_blocks ( const integer cellsInVolume )
+{
+    return (cellsInVolume + CODEC_BLOCK - 1) / CODEC_BLOCK;
+};
+
+static size_t codec_preamble ( const int nfields, const integer cellsInVolume )
+{
+    return sizeof(codec_header_t) + nfields * sizeof(double)
+                                  + nfields * codec_blocks( cellsInVolume ) * sizeof(uint32_t);
+};
+
+size_t encoded_snapshot_bound ( const int     nfields,
+                                const integer cellsInVolume )
+{
+    const size_t raw = (size_t) nfields * cellsInVolume * sizeof(real);
+
+    if ( snapshot_codec == RAW_CODEC ) return raw;
+
+    if ( snapshot_codec == FP16_CODEC || snapshot_codec == BF16_CODEC )
+        return (size_t) nfields * cellsInVolume * sizeof(uint16_t);
+
+    /* every block may fall back to raw values after its mode byte */
+    return codec_preamble( nfields, cellsInVolume ) + raw + nfields * codec_blocks( cellsInVolume );
+};
+
+static inline size_t put_varint ( unsigned char *out, uint64_t value )
+{
+    size_t n = 0;
+
+    while ( value >= 0x80 )
+    {
+        out[n++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char) value;
+
+    return n;
+};
+
+static inline size_t get_varint ( const unsigned char *in, uint64_t *value )
+{
+    size_t   n     = 0;
+    int      shift = 0;
+    uint64_t v     = 0;
+
+    do
+    {
+        v     |= (uint64_t) (in[n] & 0x7F) << shift;
+        shift += 7;
+    }
+    while ( in[n++] & 0x80 );
+
+    *value = v;
+    return n;
+};
+
+/*
+ * Codes 'cells' values with quantisation step 2*bound. Falls back to the raw
+ * values when one of them would not be within the bound (non finite values,
+ * zero bound) or when the coded block would not be smaller.
+ */
+static size_t encode_block ( unsigned char *out, const real *x, const integer cells, const double bound )
+{
+    const size_t  limit = cells * sizeof(real);
+    const double  step  = 2.0 * bound;
+    const double  inv   = (step > 0.0) ? 1.0 / step : 0.0;
+
+    size_t  n     = 1;
+    int64_t prev  = 0;
+    integer run   = 0;
+
+    out[0] = CODED_BLOCK;
+
+    for (integer i = 0; i < cells; i++)
+    {
+        const double scaled = x[i] * inv;
+
+        if ( !(fabs( scaled ) < 1e15) ) goto raw;
+
+        const int64_t q     = llrint( scaled );
+        const real    value = (real) (q * step);
+
+        if ( !(fabs( (double) value - x[i] ) <= bound) ) goto raw;
+
+        const int64_t delta = q - prev;
+        prev = q;
+
+        if ( delta == 0 ) { run++; continue; }
+
+        /* room for a pending run and this residual */
+        if ( n + 30 > limit ) goto raw;
+
+        if ( run > 0 )
+        {
+            n += put_varint( out + n, 0 );
+            n += put_varint( out + n, run - 1 );
+            run = 0;
+        }
+
+        n += put_varint( out + n, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63) );
+    }
+
+    if ( run > 0 )
+    {
+        if ( n + 20 > limit ) goto raw;
+
+        n += put_varint( out + n, 0 );
+        n += put_varint( out + n, run - 1 );
+    }
+
+    return n;
+
+raw:
+    out[0] = RAW_BLOCK;
+    memcpy( out + 1, x, limit );
+    return 1 + limit;
+};
+
+static void decode_block ( const unsigned char *in, real *x, const integer cells, const double bound )
+{
+    if ( in[0] == RAW_BLOCK )
+    {
+        memcpy( x, in + 1, cells * sizeof(real) );
+        return;
+    }
+
+    const double step = 2.0 * bound;
+
+    size_t  n = 1;
+    int64_t q = 0;
+
+    for (integer i = 0; i < cells; )
+    {
+        uint64_t token;
+        n += get_varint( in + n, &token );
+
+        if ( token == 0 )
+        {
+            uint64_t run;
+            n += get_varint( in + n, &run );
+
+            const real value = (real) (q * step);
+            for (uint64_t r = 0; r <= run; r++) x[i++] = value;
+        }
+        else
+        {
+            q += (int64_t) (token >> 1) ^ -(int64_t) (token & 1);
+            x[i++] = (real) (q * step);
+        }
+    }
+};
+
+static inline uint32_t float_bits ( const float value )
+{
+    uint32_t bits;
+    memcpy( &bits, &value, sizeof(bits) );
+    return bits;
+};
+
+static inline float bits_float ( const uint32_t bits )
+{
+    float value;
+    memcpy( &value, &bits, sizeof(value) );
+    return value;
+};
+
+/*
+ * Branch-free conversions (every case is computed and selected with masks),
+ * so that the loops below vectorise. Halves round to nearest even, overflow
+ * to infinity and keep subnormals and NaNs.
+ */
+uint16_t float_to_half ( const float value )
+{
+    const uint32_t bits      = float_bits( value );
+    const uint32_t sign      = (bits >> 16) & 0x8000u;
+    const uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+    /* subnormal halves: the float adder aligns and rounds the mantissa */
+    const uint32_t subnormal = float_bits( bits_float( magnitude ) + 0.5f ) - 0x3F000000u;
+
+    /* normal halves: rebias the exponent and round the 13 dropped bits */
+    const uint32_t normal    = (magnitude + ((uint32_t) (15 - 127) << 23) + 0xFFFu + ((magnitude >> 13) & 1u)) >> 13;
+
+    const uint32_t special   = (magnitude > 0x7F800000u) ? 0x7E00u : 0x7C00u;
+
+    const uint32_t large     = -(uint32_t) (magnitude >= 0x47800000u);
+    const uint32_t small     = -(uint32_t) (magnitude <  0x38800000u);
+
+    const uint32_t half      = (special & large) | (~large & ((subnormal & small) | (normal & ~small)));
+
+    return (uint16_t) (sign | half);
+};
+
+float half_to_float ( const uint16_t value )
+{
+    const uint32_t sign      = (uint32_t) (value & 0x8000u) << 16;
+    const uint32_t shifted   = (uint32_t) (value & 0x7FFFu) << 13;
+    const uint32_t exponent  = shifted & 0x0F800000u;
+
+    const uint32_t normal    = shifted + ((uint32_t) (127 - 15) << 23);
+    const uint32_t special   = normal  + ((uint32_t) (128 - 16) << 23);
+    const uint32_t subnormal = float_bits( bits_float( normal + (1u << 23) ) - bits_float( 113u << 23 ) );
+
+    const uint32_t large     = -(uint32_t) (exponent == 0x0F800000u);
+    const uint32_t small     = -(uint32_t) (exponent == 0          );
+
+    const uint32_t bits      = (special & large) | (~large & ((subnormal & small) | (normal & ~small)));
+
+    return bits_float( sign | bits );
+};
+
+uint16_t float_to_bf16 ( const float value )
+{
+    const uint32_t bits    = float_bits( value );
+    const uint32_t rounded = (bits + 0x7FFFu + ((bits >> 16) & 1u)) >> 16;
+    const uint32_t quiet   = (bits >> 16) | 0x40u;
+
+    return (uint16_t) (((bits & 0x7FFFFFFFu) > 0x7F800000u) ? quiet : rounded);
+};
+
+float bf16_to_float ( const uint16_t value )
+{
+    return bits_float( (uint32_t) value << 16 );
+};
+
+/*
+ * Converts every field to or from 16 bit values, block by block in parallel.
+ */
+static void convert_fields ( uint16_t *packed, real **fields, const int nfields,
+                             const integer cellsInVolume, const int to_packed )
+{
+    const integer nblocks = codec_blocks( cellsInVolume );
+    const int     half    = ( snapshot_codec == FP16_CODEC );
+
+#if defined(_OPENMP)
+    #pragma omp parallel for collapse(2) schedule(static)
+#endif
+    for (int f = 0; f < nfields; f++)
+        for (integer b = 0; b < nblocks; b++)
+        {
+            const integer first = b * CODEC_BLOCK;
+            const integer cells = min_int( CODEC_BLOCK, cellsInVolume - first );
+
+            uint16_t* restrict p = packed + (size_t) f * cellsInVolume + first;
+            real*     restrict x = fields[f] + first;
+
+            if ( to_packed && half )
+            {
+                for (integer i = 0; i < cells; i++) p[i] = float_to_half( x[i] );
+            }
+            else if ( to_packed )
+            {
+                for (integer i = 0; i < cells; i++) p[i] = float_to_bf16( x[i] );
+            }
+            else if ( half )
+            {
+                for (integer i = 0; i < cells; i++) x[i] = half_to_float( p[i] );
+            }
+            else
+            {
+                for (integer i = 0; i < cells; i++) x[i] = bf16_to_float( p[i] );
+            }
+        }
+};
+
+static double field_bound ( const real *field, const integer cellsInVolume )
+{
+    if ( !snapshot_tolerance_relative ) return snapshot_tolerance;
+
+    real largest = 0.f;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for reduction(max:largest) schedule(static)
+#endif
+    for (integer i = 0; i < cellsInVolume; i++)
+        if ( fabsf( field[i] ) > largest ) largest = fabsf( field[i] );
+
+    return snapshot_tolerance * largest;
+};
+
+size_t encode_snapshot ( unsigned char  *out,
+                         real          **fields,
+                         const int       nfields,
+                         const integer   cellsInVolume )
+{
+    if ( snapshot_codec == RAW_CODEC )
+    {
+        stage_fields( (real*) out, fields, nfields, cellsInVolume, 1 );
+        return (size_t) nfields * cellsInVolume * sizeof(real);
+    }
+
+    if ( snapshot_codec == FP16_CODEC || snapshot_codec == BF16_CODEC )
+    {
+        convert_fields( (uint16_t*) out, fields, nfields, cellsInVolume, 1 );
+        return (size_t) nfields * cellsInVolume * sizeof(uint16_t);
+    }
+
+    const integer nblocks = codec_blocks( cellsInVolume );
+
+    codec_header_t *header = (codec_header_t*) out;
+    double         *bounds = (double*  ) (out + sizeof(codec_header_t));
+    uint32_t       *sizes  = (uint32_t*) (bounds + nfields);
+    unsigned char  *data   = out + codec_preamble( nfields, cellsInVolume );
+
+    memcpy( header->magic, codec_magic, sizeof(codec_magic) );
+    header->nfields  = nfields;
+    header->block    = CODEC_BLOCK;
+    header->reserved = 0;
+    header->cells    = cellsInVolume;
+
+    for (int f = 0; f < nfields; f++)
+        bounds[f] = field_bound( fields[f], cellsInVolume );
+
+    /* every block is coded at its raw offset (plus the mode bytes before it),
+     * then they are packed in order */
+#if defined(_OPENMP)
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+#endif
+    for (int f = 0; f < nfields; f++)
+        for (integer b = 0; b < nblocks; b++)
+        {
+            const integer first = b * CODEC_BLOCK;
+            const integer cells = min_int( CODEC_BLOCK, cellsInVolume - first );
+            const size_t  raw   = ((size_t) f * cellsInVolume + first) * sizeof(real) + f * nblocks + b;
+
+            sizes[f * nblocks + b] = encode_block( data + raw, fields[f] + first, cells, bounds[f] );
+        }
+
+    size_t offset = 0;
+
+    for (int f = 0; f < nfields; f++)
+        for (integer b = 0; b < nblocks; b++)
+        {
+            const size_t raw = ((size_t) f * cellsInVolume + b * CODEC_BLOCK) * sizeof(real) + f * nblocks + b;
+
+            memmove( data + offset, data + raw, sizes[f * nblocks + b] );
+            offset += sizes[f * nblocks + b];
+        }
+
+    return (data - out) + offset;
+};
+
+void decode_snapshot ( const unsigned char  *in,
+                       const size_t          bytes,
+                       real                **fields,
+                       const int             nfields,
+                       const integer         cellsInVolume )
+{
+    if ( snapshot_codec == RAW_CODEC )
+    {
+        if ( bytes != (size_t) nfields * cellsInVolume * sizeof(real) )
+        {
+            print_error("Raw snapshot of %zu bytes, expected %zu", bytes, (size_t) nfields * cellsInVolume * sizeof(real));
+            abort();
+        }
+
+        stage_fields( (real*) in, fields, nfields, cellsInVolume, 0 );
+        return;
+    }
+
+    if ( snapshot_codec == FP16_CODEC || snapshot_codec == BF16_CODEC )
+    {
+        if ( bytes != (size_t) nfields * cellsInVolume * sizeof(uint16_t) )
+        {
+            print_error("%s snapshot of %zu bytes, expected %zu", codec_name( snapshot_codec ),
+                    bytes, (size_t) nfields * cellsInVolume * sizeof(uint16_t));
+            abort();
+        }
+
+        convert_fields( (uint16_t*) in, fields, nfields, cellsInVolume, 0 );
+        return;
+    }
+
+    const codec_header_t *header = (const codec_header_t*) in;
+
+    if ( bytes < codec_preamble( nfields, cellsInVolume ) ||
+         memcmp( header->magic, codec_magic, sizeof(codec_magic) ) != 0 ||
+         header->nfields != (uint32_t) nfields || header->block != CODEC_BLOCK ||
+         header->cells   != (uint64_t) cellsInVolume )
+    {
+        print_error("Snapshot is not a lossy encoding of %d fields of " I " cells", nfields, cellsInVolume);
+        abort();
+    }
+
+    const integer        nblocks = codec_blocks( cellsInVolume );
+    const double        *bounds  = (const double*  ) (in + sizeof(codec_header_t));
+    const uint32_t      *sizes   = (const uint32_t*) (bounds + nfields);
+    const unsigned char *data    = in + codec_preamble( nfields, cellsInVolume );
+
+    size_t *offsets = (size_t*) malloc( nfields * nblocks * sizeof(size_t) );
+    size_t  offset  = 0;
+
+    for (integer i = 0; i < nfields * nblocks; i++)
+    {
+        offsets[i] = offset;
+        offset    += sizes[i];
+    }
+
+    if ( (data - in) + offset != bytes )
+    {
+        print_error("Lossy snapshot of %zu bytes, its block index accounts for %zu", bytes, (data - in) + offset);
+        abort();
+    }
+
+#if defined(_OPENMP)
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+#endif
+    for (int f = 0; f < nfields; f++)
+        for (integer b = 0; b < nblocks; b++)
+        {
+            const integer first = b * CODEC_BLOCK;
+            const integer cells = min_int( CODEC_BLOCK, cellsInVolume - first );
+
+            decode_block( data + offsets[f * nblocks + b], fields[f] + first, cells, bounds[f] );
+        }
+
+    free( offsets );
+};
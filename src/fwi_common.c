@@ -28,12 +28,24 @@
  */
 
 #include "fwi/fwi_common.h"
+#include "fwi/fwi_io.h"
+#include <sys/mman.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
 
 int max_int( int a, int b)
 {
     return ((a >= b) ? a : b);
 };
 
+int min_int( int a, int b)
+{
+    return ((a <= b) ? a : b);
+};
+
 inline double dtime(void)
 {
     double tseconds = 0.0;
@@ -123,25 +135,26 @@ void create_output_volumes(char *outputfolder, integer VolumeMemory)
     sprintf( fnameGradient, "%s/resultGradient.res", outputfolder);
     sprintf( fnamePrecond , "%s/resultPrecond.res", outputfolder);
 
-    FILE *fGradient = safe_fopen( fnameGradient, "wb", __FILE__, __LINE__ );
-    FILE *fPrecond  = safe_fopen( fnamePrecond , "wb", __FILE__, __LINE__ );
+    io_file_t *fGradient = io_open( fnameGradient, "wb", __FILE__, __LINE__ );
+    io_file_t *fPrecond  = io_open( fnamePrecond , "wb", __FILE__, __LINE__ );
 
-    int numIts = ceil( VolumeMemory / IO_CHUNK_SIZE );
+    int numIts = ceil( (double) VolumeMemory / io_chunk_bytes );
 
-    /* create buffer array */
-    real *tmparray = (real*) __malloc( ALIGN_REAL, IO_CHUNK_SIZE );
+    /* create buffer array, page aligned for the direct backend */
+    real *tmparray = (real*) __malloc( PAGE_BYTES, io_chunk_bytes );
+    memset( tmparray, 0, io_chunk_bytes );
 
     /* perform the accumulation of the chunks */
     for (int i=0; i<numIts; i++) {
-        safe_fwrite(tmparray, 1, IO_CHUNK_SIZE, fGradient, __FILE__, __LINE__ );
-        safe_fwrite(tmparray, 1, IO_CHUNK_SIZE, fPrecond , __FILE__, __LINE__ );
+        io_write( fGradient, tmparray, io_chunk_bytes );
+        io_write( fPrecond , tmparray, io_chunk_bytes );
     }
 
     __free(tmparray);
 
     // close files
-    safe_fclose( fnameGradient, fGradient, __FILE__, __LINE__ );
-    safe_fclose( fnamePrecond , fPrecond , __FILE__, __LINE__ );
+    io_close( fGradient );
+    io_close( fPrecond  );
 #endif
 }
 
@@ -216,6 +229,7 @@ void store_shot_parameters(int     shotid,
                            integer *dimmx,
                            integer *dimmy,
                            integer *LocalYPlanes,
+                           integer *ProcessGrid,
                            char    *outputfolder,
                            real    waveletFreq)
 {
@@ -239,6 +253,7 @@ void store_shot_parameters(int     shotid,
     fprintf(fp, "%d\n",  (int    ) *nt_bwd );
     fprintf(fp, "%f\n",  (real   ) *dt     );
     fprintf(fp, "%d\n",  (int    ) *stacki );
+    fprintf(fp,  I" "I" "I"\n", ProcessGrid[0], ProcessGrid[1], ProcessGrid[2]);
 
     fclose(fp);
 };
@@ -255,6 +270,7 @@ void load_shot_parameters(int     shotid,
                           integer *dimmx,
                           integer *dimmy,
                           integer *LocalYPlanes,
+                          integer *ProcessGrid,
                           char    *outputfolder,
                           real    waveletFreq)
 {
@@ -276,6 +292,7 @@ void load_shot_parameters(int     shotid,
     IO_CHECK( fscanf(fp, "%d\n",  (int*    ) nt_bwd ) );
     IO_CHECK( fscanf(fp, "%f\n",  (real*   ) dt     ) );
     IO_CHECK( fscanf(fp, "%d\n",  (int*    ) stacki ) );
+    IO_CHECK( fscanf(fp,  I" "I" "I"\n", &ProcessGrid[0], &ProcessGrid[1], &ProcessGrid[2]) );
 
     safe_fclose( name, fp, __FILE__, __LINE__);
 };
@@ -375,6 +392,119 @@ void __free ( void* ptr)
 #endif
 };
 
+static size_t page_roundup ( const size_t bytes )
+{
+    return ((bytes + PAGE_BYTES - 1) / PAGE_BYTES) * PAGE_BYTES;
+};
+
+/*
+ * Page-granular allocation for large, long-lived buffers. The memory comes
+ * from an anonymous mapping aligned to HUGE_PAGE_BYTES and advised for
+ * transparent huge pages. No page is touched here, so each one is placed on
+ * the NUMA node of the thread that first writes it. Release it with
+ * __free_pages using the same size.
+ */
+void* __malloc_pages ( const size_t size )
+{
+#if defined(MAP_ANONYMOUS)
+    const size_t mapped = size + HUGE_PAGE_BYTES;
+
+    char* map = (char*) mmap( NULL, mapped, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( map == MAP_FAILED )
+    {
+        print_error("Cant map %zu bytes: %s", size, strerror(errno));
+        abort();
+    }
+
+    /* trim the mapping to a huge page boundary */
+    const size_t head   = (HUGE_PAGE_BYTES - ((size_t) map % HUGE_PAGE_BYTES)) % HUGE_PAGE_BYTES;
+    const size_t length = page_roundup( size );
+    char* buffer        = map + head;
+
+    if ( head > 0 ) munmap( map, head );
+    if ( mapped - head > length ) munmap( buffer + length, mapped - head - length );
+
+#if defined(MADV_HUGEPAGE)
+    madvise( buffer, length, MADV_HUGEPAGE );
+#endif
+
+    return (buffer);
+#else
+    return __malloc( HUGE_PAGE_BYTES, size );
+#endif
+};
+
+void __free_pages ( void* ptr, const size_t size )
+{
+#if defined(MAP_ANONYMOUS)
+    munmap( ptr, page_roundup( size ) );
+#else
+    __free( ptr );
+#endif
+};
+
+/*
+ * Moves the whole pages inside [ptr, ptr+bytes) to the NUMA node the calling
+ * thread runs on, which also becomes the preferred node of the pages faulted
+ * in later. Returns 0 on success and -1 when the system does not support it.
+ */
+int bind_to_local_node ( void* ptr, const size_t bytes )
+{
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+    const size_t  bits = 8 * sizeof(unsigned long);
+    unsigned long mask[16] = {0};
+    unsigned int  cpu, node;
+
+    if ( syscall( SYS_getcpu, &cpu, &node, NULL ) != 0 ) return -1;
+    if ( node + 1 >= 16 * bits ) return -1;
+
+    const size_t first = page_roundup( (size_t) ptr );
+    const size_t last  = (((size_t) ptr + bytes) / PAGE_BYTES) * PAGE_BYTES;
+
+    if ( last <= first ) return 0;
+
+    mask[node / bits] = 1UL << (node % bits);
+
+    return (int) syscall( SYS_mbind, (void*) first, last - first,
+                          MPOL_PREFERRED, mask, 16 * bits, MPOL_MF_MOVE );
+#else
+    return -1;
+#endif
+};
+
+/*
+ * Memory (in bytes) that can still be allocated without swapping: MemAvailable
+ * from /proc/meminfo, which also counts reclaimable page cache, or the free
+ * physical pages when that is not available.
+ */
+size_t available_memory (void)
+{
+    FILE* meminfo = fopen( "/proc/meminfo", "r" );
+
+    if ( meminfo != NULL )
+    {
+        char line[256];
+        unsigned long long kbytes;
+
+        while ( fgets( line, sizeof(line), meminfo ) != NULL )
+            if ( sscanf( line, "MemAvailable: %llu kB", &kbytes ) == 1 )
+            {
+                fclose( meminfo );
+                return (size_t) kbytes * 1024;
+            }
+
+        fclose( meminfo );
+    }
+
+#if defined(_SC_AVPHYS_PAGES)
+    const long pages = sysconf( _SC_AVPHYS_PAGES );
+    if ( pages > 0 ) return (size_t) pages * PAGE_BYTES;
+#endif
+
+    return 0;
+};
+
 /*
  * Reads an environmental variable.
  */
@@ -393,6 +523,21 @@ char* read_env_variable (const char* varname)
     return (s);
 };
 
+/*
+ * Reads an optional environmental variable, returning defvalue when unset.
+ */
+const char* read_env_variable_or_default (const char* varname, const char* defvalue)
+{
+    char* s = getenv(varname);
+
+    if ( s == NULL )
+        return (defvalue);
+
+    print_debug("ENV variable %s value is :%s\n", varname, s);
+
+    return (s);
+};
+
 
 FILE* safe_fopen(const char *filename, const char *mode, const char* srcfilename, const int linenumber)
 {
@@ -34,8 +34,9 @@ const integer  WRITTEN_FIELDS =   12; /* >= 12.  */
 const integer  HALO           =    4; /* >= 4    */ 
 const integer  SIMD_LENGTH    =    8; /* # of real elements fitting into regs */
 const real     IT_FACTOR      = 0.02;
-const real     IO_CHUNK_SIZE  = 1024.f * 1024.f;
 
 const size_t ALIGN_INT     = 16;
 const size_t ALIGN_INTEGER = 16;
 const size_t ALIGN_REAL    = 64;
+const size_t PAGE_BYTES      = 4096;
+const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
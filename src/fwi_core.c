@@ -38,10 +38,9 @@
 void kernel( propagator_t propagator, real waveletFreq, int shotid, char* outputfolder, char* shotfolder)
 {
 #if defined(USE_MPI)
-    /* find ourselves into the MPI space */
-    int mpi_rank, mpi_size;
-    MPI_Comm_rank( MPI_COMM_WORLD, &mpi_rank);
-    MPI_Comm_size( MPI_COMM_WORLD, &mpi_size);
+    /* find ourselves into the ranks computing this shot */
+    int mpi_rank;
+    MPI_Comm_rank( shot_comm, &mpi_rank);
 #endif /* USE_MPI */
 
     /* local variables */
@@ -49,39 +48,35 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
     double start_t, end_t;
     real dt,dz,dx,dy;
     integer dimmz, dimmx, dimmy, MaxYPlanesPerWorker, forw_steps, back_steps;
+    integer ProcessGrid[3];
 
     load_shot_parameters( shotid, &stacki, &dt, &forw_steps, &back_steps,
             &dz, &dx, &dy,
             &dimmz, &dimmx, &dimmy,
             &MaxYPlanesPerWorker,
+            ProcessGrid,
             outputfolder, waveletFreq );
 
-#if defined(USE_MPI)
-    /* aux variables, just to make it more readable */
-    const int FIRSTRANK = 0;
-    const int LASTRANK  = mpi_size - 1;
-
-    /* Compute the integration limits in order to load the correct slice from the input
-     * velocity model. These are not the limits for the wave propagator! (they are local,
-     * i.e. starts at zero!) */
-    const integer y0 = (mpi_rank == FIRSTRANK) ? 0     : (MaxYPlanesPerWorker * mpi_rank) - HALO;
-    const integer yf = (mpi_rank == LASTRANK ) ? dimmy : y0 + MaxYPlanesPerWorker;
-    const integer edimmy = (yf - y0);
-#else
-    const integer y0 = 0;
-    const integer yf = dimmy;
-    const integer edimmy = dimmy;
-#endif /* USE_MPI */
+    /* Find the part of the global volume computed by this rank, used to load
+     * the correct sub-volume from the input velocity model. */
+    const process_grid_t scheduled = { ProcessGrid[0], ProcessGrid[1], ProcessGrid[2] };
+
+    domain_t domain;
+    decompose_domain( &domain, dimmz, dimmx, dimmy, scheduled );
 
     /* Compute integration limits for the wave propagator. 
      * It assumes that the volume is local, so the indices start at zero */
     const integer nz0 = 0;
     const integer ny0 = 0;
     const integer nx0 = 0;
-    const integer nzf = dimmz;
-    const integer nxf = dimmx;
-    const integer nyf = edimmy;
-    const integer numberOfCells = dimmz * dimmx * edimmy;
+    const integer nzf = domain.size[AXIS_Z];
+    const integer nxf = domain.size[AXIS_X];
+    const integer nyf = domain.size[AXIS_Y];
+    const integer numberOfCells = domain_cells( &domain );
+
+    /* from here on, the dimensions of the local arrays */
+    dimmz = nzf;
+    dimmx = nxf;
 
     real    *rho;
     v_t     v;
@@ -94,19 +89,38 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
     alloc_memory_shot  ( dimmz, dimmx, (nyf - ny0), &coeffs, &s, &v, &rho);
 
     /* load initial model from a binary file */
-    load_local_velocity_model ( waveletFreq, dimmz, dimmx, y0, yf, &coeffs, &s, &v, rho);
+    load_local_velocity_model ( waveletFreq, &domain, &coeffs, &s, &v, rho);
+
+    /* precompute the cell averages used by the fused propagators */
+    build_coeff_cache ( dimmz, dimmx, (nyf - ny0), &coeffs, rho, coeff_cache_mode );
 
     /* Allocate memory for IO buffer */
-    real* io_buffer = (real*) __malloc( ALIGN_REAL, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
+    real* io_buffer = (real*) __malloc( PAGE_BYTES, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
 
     /* inspects every array positions for leaks. Enabled when DEBUG flag is defined */
     check_memory_shot  ( dimmz, dimmx, (nyf - ny0), &coeffs, &s, &v, rho);
 
+    /* the boundary planes exchanged with the neighbour ranks every time step */
+    halo_exchange_t *halo = open_boundary_exchange( &domain, v, s );
+
     /* Perform forward, backward or test propagations */
     switch( propagator )
     {
     case( RTM_KERNEL ):
     {
+        /* one snapshot every stacki forward steps, suffixes ntbwd, ntbwd - stacki, ... */
+        snapshot_store_t *store = open_snapshot_store( shotfolder, dimmz, dimmx, (nyf - ny0),
+                                                       back_steps - 1, -stacki,
+                                                       (forw_steps + stacki - 1) / stacki );
+
+        /* keep full states instead and recompute the snapshots from them */
+        if ( checkpoint_budget > 0 )
+            use_checkpoints( store, open_checkpointer( checkpoint_budget, (forw_steps + stacki - 1) / stacki,
+                                                       back_steps - 1, -stacki, stacki,
+                                                       coeffs, rho, dt, dz, dx, dy,
+                                                       nz0, nzf, nx0, nxf, ny0, nyf,
+                                                       dimmz, dimmx, (nyf - ny0), &domain ) );
+
         start_t = dtime();
 
         propagate_shot ( FORWARD,
@@ -115,13 +129,15 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
                          dt,dz,dx,dy,
                          nz0, nzf, nx0, nxf, ny0, nyf,
                          stacki,
-                         shotfolder,
+                         store,
+                         halo,
                          io_buffer,
                          dimmz, dimmx, (nyf - ny0));
 
         end_t = dtime();
 
         print_stats("Forward propagation finished in %lf seconds", end_t - start_t );
+        io_report("Forward propagation");
 
         start_t = dtime();
 
@@ -131,7 +147,8 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
                          dt,dz,dx,dy,
                          nz0, nzf, nx0, nxf, ny0, nyf,
                          stacki,
-                         shotfolder,
+                         store,
+                         halo,
                          io_buffer,
                          dimmz, dimmx, (nyf - ny0));
 
@@ -139,6 +156,8 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
 
         print_stats("Backward propagation finished in %lf seconds", end_t - start_t );
 
+        close_snapshot_store( store );
+
 #if defined(DO_NOT_PERFORM_IO)
         print_info("Warning: we are not creating gradient nor preconditioner "
                    "fields, because IO is not enabled for this execution" );
@@ -153,20 +172,22 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
             sprintf( fnameGradient, "%s/gradient_%05d.dat", shotfolder, shotid );
             sprintf( fnamePrecond , "%s/precond_%05d.dat" , shotfolder, shotid );
 
-            FILE* fgradient = safe_fopen( fnameGradient, "wb", __FILE__, __LINE__ );
-            FILE* fprecond  = safe_fopen( fnamePrecond , "wb", __FILE__, __LINE__ );
+            io_file_t* fgradient = io_open( fnameGradient, "wb", __FILE__, __LINE__ );
+            io_file_t* fprecond  = io_open( fnamePrecond , "wb", __FILE__, __LINE__ );
 
             print_info("Storing local preconditioner field in %s", fnameGradient );
-            safe_fwrite( io_buffer, sizeof(real), numberOfCells * 12, fgradient, __FILE__, __LINE__ );
+            io_write( fgradient, io_buffer, numberOfCells * 12 * sizeof(real) );
 
             print_info("Storing local gradient field in %s", fnamePrecond);
-            safe_fwrite( io_buffer, sizeof(real), numberOfCells * 12, fprecond , __FILE__, __LINE__ );
+            io_write( fprecond , io_buffer, numberOfCells * 12 * sizeof(real) );
 
-            safe_fclose( fnameGradient, fgradient, __FILE__, __LINE__ );
-            safe_fclose( fnamePrecond , fprecond , __FILE__, __LINE__ );
+            io_close( fgradient );
+            io_close( fprecond  );
         }
 #endif /* end DO_NOT_PERFORM_IO */
 
+        io_report("Backward propagation");
+
         break;
     }
     case( FM_KERNEL  ):
@@ -179,13 +200,15 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
                          dt,dz,dx,dy,
                          nz0, nzf, nx0, nxf, ny0, nyf,
                          stacki,
-                         shotfolder,
+                         NULL,
+                         halo,
                          io_buffer,
-                         dimmz, dimmx, dimmy);
+                         dimmz, dimmx, (nyf - ny0));
 
         end_t = dtime();
 
         print_stats("Forward Modelling finished in %lf seconds", end_t - start_t );
+        io_report("Forward Modelling");
        
         break;
     }
@@ -196,6 +219,9 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
     }
     } /* end case */
 
+    close_boundary_exchange( halo );
+    release_domain( &domain );
+
     // liberamos la memoria alocatada en el shot
     free_memory_shot  ( &coeffs, &s, &v, &rho);
     __free( io_buffer );
@@ -214,8 +240,8 @@ void gather_shots( char* outputfolder, const real waveletFreq, const int nshots,
     double start_t, end_t;
 
     /* buffers to read and accumulate the fields */
-    real* sumbuffer  = (real*)  __malloc( ALIGN_REAL, numberOfCells * sizeof(real) * WRITTEN_FIELDS ); 
-    real* readbuffer = (real*)  __malloc( ALIGN_REAL, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
+    real* sumbuffer  = (real*)  __malloc( PAGE_BYTES, numberOfCells * sizeof(real) * WRITTEN_FIELDS ); 
+    real* readbuffer = (real*)  __malloc( PAGE_BYTES, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
     
     start_t = dtime();
 
@@ -230,8 +256,8 @@ void gather_shots( char* outputfolder, const real waveletFreq, const int nshots,
 
         print_info("Reading preconditioner file '%s'", readfilename );
 
-        FILE* freadfile = safe_fopen( readfilename, "rb", __FILE__, __LINE__ );
-        safe_fread ( readbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, freadfile, __FILE__, __LINE__ );
+        io_file_t* freadfile = io_open( readfilename, "rb", __FILE__, __LINE__ );
+        io_read ( freadfile, readbuffer, numberOfCells * WRITTEN_FIELDS * sizeof(real) );
 
 #if defined(_OPENMP)
         #pragma omp parallel for
@@ -242,14 +268,14 @@ void gather_shots( char* outputfolder, const real waveletFreq, const int nshots,
         for( int i = 0; i < numberOfCells * WRITTEN_FIELDS; i++)
             sumbuffer[i] += readbuffer[i];
 
-        fclose (freadfile);
+        io_close( freadfile );
     }
 
     char precondfilename[300];
     sprintf( precondfilename, "%s/Preconditioner.%2.1f", outputfolder, waveletFreq );
-    FILE* precondfile = safe_fopen( precondfilename, "wb", __FILE__, __LINE__ );
-    safe_fwrite ( sumbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, precondfile, __FILE__, __LINE__ );
-    safe_fclose( precondfilename, precondfile, __FILE__, __LINE__ );
+    io_file_t* precondfile = io_open( precondfilename, "wb", __FILE__, __LINE__ );
+    io_write ( precondfile, sumbuffer, numberOfCells * WRITTEN_FIELDS * sizeof(real) );
+    io_close( precondfile );
 
     end_t = dtime();
 
@@ -273,8 +299,8 @@ void gather_shots( char* outputfolder, const real waveletFreq, const int nshots,
 
         print_info("Reading gradient file %s", readfilename );
 
-        FILE* freadfile = safe_fopen( readfilename, "rb", __FILE__, __LINE__ );
-        safe_fread ( readbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, freadfile, __FILE__, __LINE__ );
+        io_file_t* freadfile = io_open( readfilename, "rb", __FILE__, __LINE__ );
+        io_read ( freadfile, readbuffer, numberOfCells * WRITTEN_FIELDS * sizeof(real) );
 
 #if defined(_OPENMP)
         #pragma omp parallel for
@@ -285,14 +311,14 @@ void gather_shots( char* outputfolder, const real waveletFreq, const int nshots,
         for( int i = 0; i < numberOfCells * WRITTEN_FIELDS; i++)
             sumbuffer[i] += readbuffer[i];
 
-        fclose (freadfile);
+        io_close( freadfile );
     }
 
     char gradientfilename[300];
     sprintf( gradientfilename, "%s/Gradient.%2.1f", outputfolder, waveletFreq );
-    FILE* gradientfile = safe_fopen( gradientfilename, "wb", __FILE__, __LINE__ );
-    safe_fwrite ( sumbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, gradientfile, __FILE__, __LINE__ );
-    safe_fclose( gradientfilename, gradientfile, __FILE__, __LINE__ );
+    io_file_t* gradientfile = io_open( gradientfilename, "wb", __FILE__, __LINE__ );
+    io_write ( gradientfile, sumbuffer, numberOfCells * WRITTEN_FIELDS * sizeof(real) );
+    io_close( gradientfile );
 
     end_t = dtime();
 
@@ -305,6 +331,130 @@ void gather_shots( char* outputfolder, const real waveletFreq, const int nshots,
 #endif /* end DO_NOT_PERFORM_IO */
 };
 
+/*
+ * Shot farm. The ranks are split into groups of the ranks a shot needs
+ * (shot_comm) and every group takes the next shot nobody took yet, until
+ * there are none left: groups that finish early are not held back by the
+ * others. The next shot is a counter on the first rank, which the group
+ * leaders increment with one-sided atomics, so no rank is set aside to
+ * hand the shots out. Ranks left over by the division form no group.
+ */
+#if defined(USE_MPI)
+static MPI_Win  shot_window;
+static int     *shots_taken;
+#else
+static int      shots_taken_serial;
+static int     *shots_taken = &shots_taken_serial;
+#endif
+
+static void open_shot_farm (void)
+{
+#if defined(USE_MPI)
+    int rank;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+    MPI_Win_allocate( (rank == 0) ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL,
+                      MPI_COMM_WORLD, &shots_taken, &shot_window );
+#endif
+};
+
+static void close_shot_farm (void)
+{
+#if defined(USE_MPI)
+    MPI_Win_free( &shot_window );
+
+    if ( shot_comm != MPI_COMM_WORLD && shot_comm != MPI_COMM_NULL )
+        MPI_Comm_free( &shot_comm );
+
+    shot_comm = MPI_COMM_WORLD;
+#endif
+};
+
+/* groups of 'nworkers' ranks, or a single one when there are not enough */
+static void form_shot_groups ( const int nworkers )
+{
+#if defined(USE_MPI)
+    int rank, nranks;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    MPI_Comm_size( MPI_COMM_WORLD, &nranks );
+
+    if ( shot_comm != MPI_COMM_WORLD && shot_comm != MPI_COMM_NULL )
+        MPI_Comm_free( &shot_comm );
+
+    const int size    = ( nworkers < 1 || nworkers > nranks ) ? nranks : nworkers;
+    const int ngroups = nranks / size;
+
+    /* FWI_PROCESS_GRID splits the volume among the ranks of a group, it does not size the groups */
+    const process_grid_t requested = requested_process_grid;
+
+    if ( requested.z > 0 && requested.z * requested.x * requested.y != size )
+    {
+        print_error("FWI_PROCESS_GRID %dx%dx%d does not have the %d ranks of a shot group",
+                requested.z, requested.x, requested.y, size);
+        abort();
+    }
+
+    const int color   = ( rank < ngroups * size ) ? rank / size : MPI_UNDEFINED;
+
+    MPI_Comm_split( MPI_COMM_WORLD, color, rank, &shot_comm );
+
+    print_info("Shot farm: %d groups of %d ranks, %d ranks idle", ngroups, size, nranks - ngroups * size);
+
+    if ( color == MPI_UNDEFINED )
+        print_info("Shot farm: rank %d takes no shots", rank);
+#else
+    (void) nworkers;
+#endif
+};
+
+/* called by every rank, once the folders and parameters of the shots exist */
+static void start_shots (void)
+{
+#if defined(USE_MPI)
+    int rank;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+    if ( rank == 0 )
+    {
+        MPI_Win_lock( MPI_LOCK_EXCLUSIVE, 0, 0, shot_window );
+        *shots_taken = 0;
+        MPI_Win_unlock( 0, shot_window );
+    }
+
+    MPI_Barrier( MPI_COMM_WORLD );
+#else
+    *shots_taken = 0;
+#endif
+};
+
+/* next shot of the group, 'nshots' when all are taken */
+static int next_shot ( const int nshots )
+{
+    int shot;
+
+#if defined(USE_MPI)
+    if ( shot_comm == MPI_COMM_NULL ) return nshots;
+
+    int rank;
+    MPI_Comm_rank( shot_comm, &rank );
+
+    if ( rank == 0 )
+    {
+        const int one = 1;
+
+        MPI_Win_lock( MPI_LOCK_SHARED, 0, 0, shot_window );
+        MPI_Fetch_and_op( &one, &shot, MPI_INT, 0, 0, MPI_SUM, shot_window );
+        MPI_Win_unlock( 0, shot_window );
+    }
+
+    MPI_Bcast( &shot, 1, MPI_INT, 0, shot_comm );
+#else
+    shot = (*shots_taken)++;
+#endif
+
+    return min_int( shot, nshots );
+};
+
 int execute_simulation( int argc, char* argv[] )
 {
 #if defined(USE_MPI)
@@ -328,6 +478,35 @@ int execute_simulation( int argc, char* argv[] )
     /* Load parameters from schedule file */
     schedule_t s = load_schedule(argv[1]);
 
+    /* Pick the propagator engines for this run */
+    select_propagator_engines();
+
+    /* and how the shot arrays are placed on NUMA nodes */
+    select_numa_placement();
+
+    /* and how the velocity model is loaded into them */
+    select_model_loader();
+
+    /* and how the forward snapshots reach the disk */
+    select_snapshot_pipeline();
+
+    /* and how they are encoded */
+    select_snapshot_codec();
+
+    /* and how files are transferred to and from the disk */
+    select_io_backend();
+
+    /* and whether they are recomputed from checkpoints */
+    select_checkpointing();
+
+    /* and whether the boundary exchange waits are timed */
+    select_halo_diagnostics();
+
+    /* and how the ranks split the volume */
+    select_process_grid();
+
+    open_shot_farm();
+
     for(int i=0; i<s.nfreqs; i++)
     {
         /* Process one frequency at a time */
@@ -342,8 +521,9 @@ int execute_simulation( int argc, char* argv[] )
         integer dimmz      = s.dimmz[i];
         integer dimmx      = s.dimmx[i];
         integer dimmy      = s.dimmy[i];
-        //integer nworkers = s.nworkers[i];
+        integer nworkers   = s.nworkers[i];
         integer MaxYPlanesPerWorker = s.ppd[i];
+        integer ProcessGrid[3]      = { s.gridz[i], s.gridx[i], s.gridy[i] };
 
         print_info("\n------ Computing %d-th frequency (%.2fHz). ------\n", i, waveletFreq);
 
@@ -353,30 +533,39 @@ int execute_simulation( int argc, char* argv[] )
         print_stats("Local domain size for freq %f [%d][%d][%d] is %lu bytes (%lf GB)", 
                     waveletFreq, dimmz, dimmx, dimmy, VolumeMemory, TOGB(VolumeMemory) );
 
+        /* the ranks compute the shots in groups of the scheduled number of workers */
+        form_shot_groups( nworkers );
+
         for(int grad=0; grad<s.ngrads; grad++) /* backward iteration */
         {
             print_info("Processing %d-gradient iteration", grad);
 
-            for(int shot=0; shot<s.nshots; shot++)
-            {
-                char shotfolder[512];
-                sprintf(shotfolder, "%s/shot.%2.2fHz.%03d", s.outputfolder, waveletFreq, shot);
+            char shotfolder[512];
 
 #if defined(USE_MPI)
-                if ( mpi_rank == 0 )
+            if ( mpi_rank == 0 )
 #endif
+            {
+                for(int shot=0; shot<s.nshots; shot++)
                 {
+                    sprintf(shotfolder, "%s/shot.%2.2fHz.%03d", s.outputfolder, waveletFreq, shot);
+
                     create_folder( shotfolder );
 
                     store_shot_parameters( shot, &stacki, &dt, &forw_steps, &back_steps,
                                            &dz, &dx, &dy,
                                            &dimmz, &dimmx, &dimmy,
                                            &MaxYPlanesPerWorker,
+                                           ProcessGrid,
                                            s.outputfolder, waveletFreq );
                 }
-#if defined(USE_MPI)
-                MPI_Barrier( MPI_COMM_WORLD );
-#endif
+            }
+
+            start_shots();
+
+            for(int shot=next_shot(s.nshots); shot<s.nshots; shot=next_shot(s.nshots))
+            {
+                sprintf(shotfolder, "%s/shot.%2.2fHz.%03d", s.outputfolder, waveletFreq, shot);
 
                 kernel( RTM_KERNEL, waveletFreq, shot, s.outputfolder, shotfolder);
 
@@ -391,35 +580,49 @@ int execute_simulation( int argc, char* argv[] )
             {
                 print_info("\tProcessing %d-th test iteration", test);
 
-                for(int shot=0; shot<s.nshots; shot++)
-                {
-                    char shotfolder[512];
-                    sprintf(shotfolder, "%s/test.%05d.shot.%2.2fHz.%03d", 
-                            s.outputfolder, test, waveletFreq, shot);
-
 #if defined(USE_MPI)
-                    if ( mpi_rank == 0)
+                if ( mpi_rank == 0)
 #endif
+                {
+                    for(int shot=0; shot<s.nshots; shot++)
                     {
+                        sprintf(shotfolder, "%s/test.%05d.shot.%2.2fHz.%03d", 
+                                s.outputfolder, test, waveletFreq, shot);
+
                         create_folder( shotfolder );
 
                         store_shot_parameters( shot, &stacki, &dt, &forw_steps, &back_steps,
                                                &dz, &dx, &dy,
                                                &dimmz, &dimmx, &dimmy,
                                                &MaxYPlanesPerWorker,
+                                               ProcessGrid,
                                                s.outputfolder, waveletFreq );
                     }
-#if defined(USE_MPI)
-                    MPI_Barrier( MPI_COMM_WORLD );
-#endif
+                }
+
+                start_shots();
+
+                for(int shot=next_shot(s.nshots); shot<s.nshots; shot=next_shot(s.nshots))
+                {
+                    sprintf(shotfolder, "%s/test.%05d.shot.%2.2fHz.%03d", 
+                            s.outputfolder, test, waveletFreq, shot);
+
                     kernel( FM_KERNEL , waveletFreq, shot, s.outputfolder, shotfolder);
 
                     print_info("\t\tTest loop processed for the %d-th shot", shot);
                 }
+
+#if defined(USE_MPI)
+                MPI_Barrier( MPI_COMM_WORLD );
+#endif
             } /* end of test loop */
         } /* end of gradient loop */
     } /* end of frequency loop */
 
+    release_shot_arena();
+
+    close_shot_farm();
+
 #if defined(USE_MPI)
     MPI_Barrier(MPI_COMM_WORLD);
     MPI_Finalize();
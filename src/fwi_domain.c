@@ -0,0 +1,235 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_domain.h"
+
+process_grid_t requested_process_grid = {0, 0, 0};
+
+#if defined(USE_MPI)
+MPI_Comm shot_comm = MPI_COMM_WORLD;
+#endif
+
+/*
+ * FWI_PROCESS_GRID sets the ranks along each axis as ZxXxY, e.g. 1x2x4.
+ * 'auto' (default) takes the grid of the schedule, or the one with the
+ * fewest halo bytes per rank when the schedule was made for another number
+ * of ranks.
+ */
+void select_process_grid (void)
+{
+    const char* name = read_env_variable_or_default( "FWI_PROCESS_GRID", "auto" );
+
+    process_grid_t grid = {0, 0, 0};
+
+    if ( strcmp( name, "auto" ) != 0 &&
+        (sscanf( name, "%dx%dx%d", &grid.z, &grid.x, &grid.y ) != 3 || grid.z < 1 || grid.x < 1 || grid.y < 1) )
+    {
+        print_error("Invalid process grid '%s' in FWI_PROCESS_GRID, using 'auto'", name);
+        grid.z = grid.x = grid.y = 0;
+    }
+
+    requested_process_grid = grid;
+
+    if ( grid.z > 0 )
+        print_info("Process grid: %dx%dx%d ranks along z, x and y", grid.z, grid.x, grid.y);
+    else
+        print_info("Process grid: auto");
+};
+
+static int grid_ranks ( const process_grid_t grid )
+{
+    return grid.z * grid.x * grid.y;
+};
+
+size_t halo_bytes_per_rank ( const process_grid_t grid,
+                             const integer dimmz,
+                             const integer dimmx,
+                             const integer dimmy )
+{
+    const int     ranks[3]  = { grid.z, grid.x, grid.y };
+    const integer global[3] = { dimmz, dimmx, dimmy };
+
+    /* cells of the largest local volume along each axis, the HALO planes of
+     * the axes that are not split are exchanged with the faces of the others */
+    integer extent[3];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const integer cells = global[axis] - 2*HALO;
+        extent[axis] = (ranks[axis] > 1) ? (cells + ranks[axis] - 1) / ranks[axis] : global[axis];
+    }
+
+    size_t cells = 0;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if ( ranks[axis] == 1 ) continue;
+
+        const int faces = min_int( 2, ranks[axis] - 1 );
+
+        cells += (size_t) faces * HALO * extent[(axis+1) % 3] * extent[(axis+2) % 3];
+    }
+
+    /* sent and received, 12 velocity and 24 stress fields */
+    return 2 * cells * (12 + 24) * sizeof(real);
+};
+
+process_grid_t best_process_grid ( const int nranks,
+                                   const integer dimmz,
+                                   const integer dimmx,
+                                   const integer dimmy,
+                                   const int split_z )
+{
+    process_grid_t best  = {1, 1, nranks};
+    size_t         bytes = 0;
+    int            found = 0;
+
+    for (int pz = 1; pz <= (split_z ? nranks : 1); pz++)
+    {
+        if ( nranks % pz != 0 ) continue;
+
+        for (int px = 1; px <= nranks / pz; px++)
+        {
+            if ( (nranks / pz) % px != 0 ) continue;
+
+            const process_grid_t grid = { pz, px, nranks / (pz * px) };
+
+            /* every rank computes at least 2*HALO planes along the split axes */
+            if ( (grid.z > 1 && (dimmz - 2*HALO) / grid.z < 2*HALO) ||
+                 (grid.x > 1 && (dimmx - 2*HALO) / grid.x < 2*HALO) ||
+                 (grid.y > 1 && (dimmy - 2*HALO) / grid.y < 2*HALO) ) continue;
+
+            const size_t candidate = halo_bytes_per_rank( grid, dimmz, dimmx, dimmy );
+
+            /* ties keep the grid that splits x and z least */
+            if ( !found || candidate < bytes )
+            {
+                best  = grid;
+                bytes = candidate;
+                found = 1;
+            }
+        }
+    }
+
+    return best;
+};
+
+void decompose_domain ( domain_t *d,
+                        const integer dimmz,
+                        const integer dimmx,
+                        const integer dimmy,
+                        const process_grid_t scheduled )
+{
+    int nranks = 1;
+#if defined(USE_MPI)
+    MPI_Comm_size( shot_comm, &nranks );
+#endif
+
+    process_grid_t grid;
+
+    if ( grid_ranks( requested_process_grid ) == nranks )
+        grid = requested_process_grid;
+    else
+    {
+        if ( requested_process_grid.z > 0 )
+            print_error("FWI_PROCESS_GRID %dx%dx%d does not have %d ranks, ignoring it",
+                    requested_process_grid.z, requested_process_grid.x, requested_process_grid.y, nranks);
+
+        grid = ( grid_ranks( scheduled ) == nranks ) ? scheduled :
+               best_process_grid( nranks, dimmz, dimmx, dimmy, 0 );
+    }
+
+    d->ranks[AXIS_Z]  = grid.z;
+    d->ranks[AXIS_X]  = grid.x;
+    d->ranks[AXIS_Y]  = grid.y;
+    d->global[AXIS_Z] = dimmz;
+    d->global[AXIS_X] = dimmx;
+    d->global[AXIS_Y] = dimmy;
+
+#if defined(USE_MPI)
+    int periods[3] = {0, 0, 0};
+    int rank;
+
+    /* no reordering: snapshot and output files are named after MPI_COMM_WORLD ranks */
+    MPI_Cart_create( shot_comm, 3, d->ranks, periods, 0, &d->comm );
+    MPI_Comm_rank( d->comm, &rank );
+    MPI_Cart_coords( d->comm, rank, 3, d->coords );
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        int lower, upper;
+        MPI_Cart_shift( d->comm, axis, 1, &lower, &upper );
+
+        d->neighbour[axis][0] = (lower == MPI_PROC_NULL) ? -1 : lower;
+        d->neighbour[axis][1] = (upper == MPI_PROC_NULL) ? -1 : upper;
+    }
+#else
+    for (int axis = 0; axis < 3; axis++)
+    {
+        d->coords[axis]       = 0;
+        d->neighbour[axis][0] = -1;
+        d->neighbour[axis][1] = -1;
+    }
+#endif
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const integer cells = d->global[axis] - 2*HALO;
+        const integer first = (cells *  d->coords[axis]     ) / d->ranks[axis];
+        const integer last  = (cells * (d->coords[axis] + 1)) / d->ranks[axis];
+
+        if ( d->ranks[axis] > 1 && last - first < 2*HALO )
+        {
+            print_error("A %dx%dx%d process grid leaves fewer than 2*HALO planes along axis %d of the "I"x"I"x"I" volume",
+                    grid.z, grid.x, grid.y, axis, dimmz, dimmx, dimmy);
+            abort();
+        }
+
+        d->offset[axis] = first;
+        d->size[axis]   = last - first + 2*HALO;
+    }
+
+    print_info("Process grid %dx%dx%d: local volume "I"x"I"x"I" at ("I","I","I"), %lu halo bytes per rank and time step",
+            grid.z, grid.x, grid.y,
+            d->size[AXIS_Z], d->size[AXIS_X], d->size[AXIS_Y],
+            d->offset[AXIS_Z], d->offset[AXIS_X], d->offset[AXIS_Y],
+            (unsigned long) halo_bytes_per_rank( grid, dimmz, dimmx, dimmy ));
+};
+
+void release_domain ( domain_t *UNUSED(d) )
+{
+#if defined(USE_MPI)
+    MPI_Comm_free( &d->comm );
+#endif
+};
+
+integer domain_cells ( const domain_t *d )
+{
+    return d->size[AXIS_Z] * d->size[AXIS_X] * d->size[AXIS_Y];
+};
@@ -0,0 +1,962 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_io.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_IO_URING
+#endif
+#endif
+#endif
+
+io_backend_t io_backend     = STDIO_BACKEND;
+size_t       io_chunk_bytes = 4 * 1024 * 1024;
+int          io_depth       = 4;
+
+#if defined(HAVE_IO_URING)
+/* submission and completion queues shared with the kernel */
+typedef struct
+{
+    int                  fd;
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void                *sq_ring;
+    void                *cq_ring;
+    size_t               sq_bytes;
+    size_t               cq_bytes;
+    size_t               sqe_bytes;
+} io_ring_t;
+
+/* one chunk being staged or in flight */
+typedef struct
+{
+    struct iovec   iov;
+    unsigned char *stage;    /* page aligned chunk */
+    size_t         offset;   /* file offset of the transfer */
+    int            reading;
+    int            busy;
+    int            borrowed; /* writes the caller's memory instead of stage */
+
+    /* part of a staged read that belongs to the caller */
+    unsigned char *target;
+    size_t         skip;
+    size_t         count;
+} io_slot_t;
+#endif
+
+struct io_file_s
+{
+    char           name[300];
+    int            writing;
+
+    FILE          *stream;    /* stdio backend  */
+
+    int            fd;        /* direct and io_uring backends */
+    int            direct;    /* O_DIRECT still set on fd */
+    unsigned char *stage;     /* page aligned chunk being filled */
+    size_t         offset;    /* file offset of stage[0] */
+    size_t         staged;    /* valid bytes in stage */
+    size_t         position;  /* read position */
+
+#if defined(HAVE_IO_URING)
+    int            uring;
+    io_ring_t      ring;
+    io_slot_t     *slots;     /* io_depth chunks */
+    int            current;   /* slot of stage when writing */
+    int            inflight;
+#endif
+
+    size_t         moved;     /* bytes read or written */
+};
+
+/* what the handles of each backend read (0) and wrote (1) since the last io_report */
+typedef struct
+{
+    int    files[2];
+    size_t bytes[2];
+    double seconds[2];   /* spent inside the io_* calls */
+} io_totals_t;
+
+static io_totals_t     io_totals[3];
+static pthread_mutex_t io_totals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void account ( const io_file_t *file, const size_t bytes, const int closed, const double tstart )
+{
+#if defined(HAVE_IO_URING)
+    const io_backend_t backend = file->uring ? URING_BACKEND : (file->stream != NULL) ? STDIO_BACKEND : DIRECT_BACKEND;
+#else
+    const io_backend_t backend = (file->stream != NULL) ? STDIO_BACKEND : DIRECT_BACKEND;
+#endif
+    const double elapsed = dtime() - tstart;
+
+    pthread_mutex_lock( &io_totals_lock );
+    io_totals[ backend ].files  [ file->writing ] += closed;
+    io_totals[ backend ].bytes  [ file->writing ] += bytes;
+    io_totals[ backend ].seconds[ file->writing ] += elapsed;
+    pthread_mutex_unlock( &io_totals_lock );
+};
+
+#if defined(HAVE_IO_URING)
+static int ring_setup ( io_ring_t *ring, const unsigned entries )
+{
+    struct io_uring_params params;
+    memset( &params, 0, sizeof(params) );
+
+    ring->fd = (int) syscall( __NR_io_uring_setup, entries, &params );
+
+    if ( ring->fd < 0 ) return -1;
+
+    ring->sq_bytes  = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_bytes  = params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqe_bytes = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_ring = mmap( NULL, ring->sq_bytes , PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQ_RING );
+    ring->cq_ring = mmap( NULL, ring->cq_bytes , PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_CQ_RING );
+    ring->sqes    = mmap( NULL, ring->sqe_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQES );
+
+    if ( ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED )
+    {
+        const int error = errno;
+
+        if ( ring->sq_ring != MAP_FAILED ) munmap( ring->sq_ring, ring->sq_bytes  );
+        if ( ring->cq_ring != MAP_FAILED ) munmap( ring->cq_ring, ring->cq_bytes  );
+        if ( ring->sqes    != MAP_FAILED ) munmap( ring->sqes   , ring->sqe_bytes );
+        close( ring->fd );
+
+        errno = error;
+        return -1;
+    }
+
+    unsigned char *sq = (unsigned char*) ring->sq_ring;
+    unsigned char *cq = (unsigned char*) ring->cq_ring;
+
+    ring->sq_tail  = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+    ring->cq_head  = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail  = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask  = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    return 0;
+};
+
+static void ring_teardown ( io_ring_t *ring )
+{
+    munmap( ring->sqes   , ring->sqe_bytes );
+    munmap( ring->cq_ring, ring->cq_bytes  );
+    munmap( ring->sq_ring, ring->sq_bytes  );
+    close( ring->fd );
+};
+
+static int ring_enter ( io_ring_t *ring, const unsigned submit, const unsigned wait )
+{
+    for (;;)
+    {
+        const long ret = syscall( __NR_io_uring_enter, ring->fd, submit, wait,
+                                  wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+
+        if ( ret >= 0 || errno != EINTR ) return (int) ret;
+    }
+};
+#endif
+
+/* the kernel may lack io_uring or a seccomp filter may forbid it */
+int io_uring_supported (void)
+{
+#if defined(HAVE_IO_URING)
+    io_ring_t probe;
+
+    if ( ring_setup( &probe, 1 ) != 0 ) return 0;
+
+    ring_teardown( &probe );
+    return 1;
+#else
+    errno = ENOSYS;
+    return 0;
+#endif
+};
+
+/*
+ * FWI_IO_BACKEND picks how snapshot, model and gradient files are
+ * transferred: 'stdio' (default), 'direct' (O_DIRECT, bypassing the page
+ * cache) or 'uring' (the direct transfers queued on an io_uring, with up to
+ * FWI_IO_DEPTH of them in flight). FWI_IO_CHUNK is the size of every
+ * transfer, in bytes or with a K, M or G suffix, rounded up to whole pages.
+ */
+void select_io_backend (void)
+{
+    const char* name = read_env_variable_or_default( "FWI_IO_BACKEND", "stdio" );
+
+    if      ( strcmp( name, "stdio"  ) == 0 ) io_backend = STDIO_BACKEND;
+    else if ( strcmp( name, "direct" ) == 0 ) io_backend = DIRECT_BACKEND;
+    else if ( strcmp( name, "uring"  ) == 0 ) io_backend = URING_BACKEND;
+    else
+    {
+        print_error("Unknown IO backend '%s' in FWI_IO_BACKEND, using 'stdio'", name);
+        io_backend = STDIO_BACKEND;
+    }
+
+#if !defined(O_DIRECT)
+    if ( io_backend == DIRECT_BACKEND )
+    {
+        print_error("O_DIRECT is not available on this system, using 'stdio'");
+        io_backend = STDIO_BACKEND;
+    }
+#endif
+
+    if ( io_backend == URING_BACKEND && !io_uring_supported() )
+    {
+        print_error("io_uring is not available (%s), using 'stdio'", strerror(errno));
+        io_backend = STDIO_BACKEND;
+    }
+
+    const char* chunk = read_env_variable_or_default( "FWI_IO_CHUNK", "4M" );
+
+    unsigned long value;
+    char          unit = 'B';
+    char          extra;
+    size_t        scale = 0;
+
+    const int matched = sscanf( chunk, "%lu%c%c", &value, &unit, &extra );
+
+    if ( matched == 1 || matched == 2 )
+    {
+        switch ( unit )
+        {
+            case 'B':             scale = 1;                  break;
+            case 'K': case 'k':   scale = 1024;               break;
+            case 'M': case 'm':   scale = 1024 * 1024;        break;
+            case 'G': case 'g':   scale = 1024 * 1024 * 1024; break;
+            default :             scale = 0;                  break;
+        }
+    }
+
+    if ( scale == 0 || value == 0 )
+    {
+        print_error("Invalid IO chunk '%s' in FWI_IO_CHUNK, using '4M'", chunk);
+        value = 4;
+        scale = 1024 * 1024;
+    }
+
+    io_chunk_bytes = ((value * scale + PAGE_BYTES - 1) / PAGE_BYTES) * PAGE_BYTES;
+
+    const char* depth = read_env_variable_or_default( "FWI_IO_DEPTH", "4" );
+    io_depth = atoi( depth );
+
+    if ( io_depth < 1 || io_depth > 64 )
+    {
+        print_error("Invalid IO depth '%s' in FWI_IO_DEPTH (1 to 64), using 4", depth);
+        io_depth = 4;
+    }
+
+    if ( io_backend == URING_BACKEND )
+        print_info("IO backend: uring, %zu KiB per transfer, %d in flight", io_chunk_bytes / 1024, io_depth);
+    else
+        print_info("IO backend: %s, %zu KiB per transfer",
+                   (io_backend == DIRECT_BACKEND) ? "direct" : "stdio", io_chunk_bytes / 1024);
+};
+
+#if defined(O_DIRECT)
+static void drop_direct ( io_file_t *file )
+{
+    const int flags = fcntl( file->fd, F_GETFL );
+
+    if ( flags == -1 || fcntl( file->fd, F_SETFL, flags & ~O_DIRECT ) == -1 )
+    {
+        print_error("Unable to clear O_DIRECT on %s: %s", file->name, strerror(errno));
+        abort();
+    }
+
+    print_debug("%s does not accept direct transfers, buffering them", file->name);
+    file->direct = 0;
+};
+#endif
+
+static void direct_pwrite ( io_file_t *file, const unsigned char *buffer, const size_t bytes, const size_t offset )
+{
+    size_t done = 0;
+
+    while ( done < bytes )
+    {
+        const ssize_t n = pwrite( file->fd, buffer + done, bytes - done, (off_t) (offset + done) );
+
+        if ( n < 0 && errno == EINTR ) continue;
+#if defined(O_DIRECT)
+        if ( n < 0 && errno == EINVAL && file->direct ) { drop_direct( file ); continue; }
+#endif
+        if ( n <= 0 )
+        {
+            print_error("Error while writing %s: %s", file->name, strerror(errno));
+            abort();
+        }
+
+        done += (size_t) n;
+    }
+};
+
+/* returns less than 'bytes' only at the end of the file */
+static size_t direct_pread ( io_file_t *file, unsigned char *buffer, const size_t bytes, const size_t offset )
+{
+    size_t done = 0;
+
+    while ( done < bytes )
+    {
+        const ssize_t n = pread( file->fd, buffer + done, bytes - done, (off_t) (offset + done) );
+
+        if ( n == 0 ) break;
+        if ( n < 0 && errno == EINTR ) continue;
+#if defined(O_DIRECT)
+        if ( n < 0 && errno == EINVAL && file->direct ) { drop_direct( file ); continue; }
+#endif
+        if ( n < 0 )
+        {
+            print_error("Error while reading %s: %s", file->name, strerror(errno));
+            abort();
+        }
+
+        done += (size_t) n;
+    }
+
+    return done;
+};
+
+#if defined(HAVE_IO_URING)
+static void submit_slot ( io_file_t *file, const int s, unsigned char *buffer, const size_t bytes,
+                          const size_t offset, const int reading )
+{
+    io_ring_t *ring = &file->ring;
+    io_slot_t *slot = &file->slots[s];
+
+    slot->iov.iov_base = buffer;
+    slot->iov.iov_len  = bytes;
+    slot->offset       = offset;
+    slot->reading      = reading;
+    slot->busy         = 1;
+
+    /* only this thread fills the submission queue */
+    const unsigned tail  = *ring->sq_tail;
+    const unsigned index = tail & *ring->sq_mask;
+
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset( sqe, 0, sizeof(*sqe) );
+
+    sqe->opcode    = reading ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd        = file->fd;
+    sqe->addr      = (uint64_t) (uintptr_t) &slot->iov;
+    sqe->len       = 1;
+    sqe->off       = offset;
+    sqe->user_data = (uint64_t) s;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n( ring->sq_tail, tail + 1, __ATOMIC_RELEASE );
+
+    if ( ring_enter( ring, 1, 0 ) != 1 )
+    {
+        print_error("Unable to queue a transfer of %s: %s", file->name, strerror(errno));
+        abort();
+    }
+
+    file->inflight++;
+};
+
+/*
+ * Waits for one transfer. Short transfers and the ones the file system
+ * refused in direct mode are completed synchronously.
+ */
+static void complete_slot ( io_file_t *file )
+{
+    io_ring_t *ring = &file->ring;
+    unsigned   head;
+
+    while ( (head = *ring->cq_head) == __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE ) )
+    {
+        if ( ring_enter( ring, 0, 1 ) < 0 )
+        {
+            print_error("Unable to wait for the transfers of %s: %s", file->name, strerror(errno));
+            abort();
+        }
+    }
+
+    const struct io_uring_cqe *cqe = &ring->cqes[ head & *ring->cq_mask ];
+    io_slot_t *slot = &file->slots[ cqe->user_data ];
+    const int  res  = cqe->res;
+
+    __atomic_store_n( ring->cq_head, head + 1, __ATOMIC_RELEASE );
+    file->inflight--;
+
+    unsigned char *buffer = (unsigned char*) slot->iov.iov_base;
+    const size_t   bytes  = slot->iov.iov_len;
+    size_t         done   = (res > 0) ? (size_t) res : 0;
+
+    if ( res < 0 && res != -EINTR && res != -EAGAIN )
+    {
+#if defined(O_DIRECT)
+        if ( res == -EINVAL && file->direct )
+            drop_direct( file );
+        else
+#endif
+        {
+            print_error("Error while %s %s: %s", slot->reading ? "reading" : "writing",
+                        file->name, strerror(-res));
+            abort();
+        }
+    }
+
+    if ( done < bytes )
+    {
+        if ( slot->reading )
+            done += direct_pread( file, buffer + done, bytes - done, slot->offset + done );
+        else
+        {
+            direct_pwrite( file, buffer + done, bytes - done, slot->offset + done );
+            done = bytes;
+        }
+    }
+
+    if ( slot->reading )
+    {
+        const size_t needed = slot->target ? slot->skip + slot->count : bytes;
+
+        if ( done < needed )
+        {
+            print_error("Unexpected end of file %s", file->name);
+            abort();
+        }
+
+        if ( slot->target )
+            memcpy( slot->target, slot->stage + slot->skip, slot->count );
+    }
+
+    slot->busy     = 0;
+    slot->borrowed = 0;
+};
+
+static int acquire_slot ( io_file_t *file )
+{
+    for (;;)
+    {
+        for (int s = 0; s < io_depth; s++)
+        {
+            if ( !file->slots[s].busy )
+            {
+                file->slots[s].busy = 1;
+                return s;
+            }
+        }
+
+        complete_slot( file );
+    }
+};
+
+static void wait_slots ( io_file_t *file )
+{
+    while ( file->inflight > 0 )
+        complete_slot( file );
+};
+
+/* queues every chunk of [position, position + bytes) and waits for them */
+static void ring_read ( io_file_t *file, unsigned char *dst, const size_t bytes )
+{
+    const size_t start = file->position;
+    const size_t end   = start + bytes;
+    const size_t last  = ((end + PAGE_BYTES - 1) / PAGE_BYTES) * PAGE_BYTES;
+
+    for (size_t p = start - start % PAGE_BYTES; p < end; )
+    {
+        const size_t n    = (last - p < io_chunk_bytes) ? last - p : io_chunk_bytes;
+        const int    s    = acquire_slot( file );
+        io_slot_t   *slot = &file->slots[s];
+
+        if ( p >= start && p + n <= end && (uintptr_t) (dst + (p - start)) % PAGE_BYTES == 0 )
+        {
+            /* whole chunks go straight to the caller's buffer */
+            slot->target = NULL;
+            submit_slot( file, s, dst + (p - start), n, p, 1 );
+        }
+        else
+        {
+            const size_t first = (p > start) ? p : start;
+            const size_t stop  = (p + n < end) ? p + n : end;
+
+            slot->target = dst + (first - start);
+            slot->skip   = first - p;
+            slot->count  = stop - first;
+            submit_slot( file, s, slot->stage, n, p, 1 );
+        }
+
+        p += n;
+    }
+
+    while ( file->inflight > 0 )
+        complete_slot( file );
+
+    file->position = end;
+};
+#endif
+
+/* sends a chunk (the staged one or the caller's memory) to the end of the file */
+static void write_chunk ( io_file_t *file, const unsigned char *buffer, const size_t bytes )
+{
+#if defined(HAVE_IO_URING)
+    if ( file->uring )
+    {
+        /* io_write waits for the chunks of the caller's memory before returning */
+        file->slots[ file->current ].borrowed = ( buffer != file->stage );
+        submit_slot( file, file->current, (unsigned char*) buffer, bytes, file->offset, 0 );
+
+        file->current = acquire_slot( file );
+        file->stage   = file->slots[ file->current ].stage;
+    }
+    else
+#endif
+        direct_pwrite( file, buffer, bytes, file->offset );
+
+    file->offset += bytes;
+};
+
+static int page_aligned ( const void *ptr, const size_t offset )
+{
+    return ( (uintptr_t) ptr % PAGE_BYTES == 0 ) && ( offset % PAGE_BYTES == 0 );
+};
+
+static const char* file_backend ( const io_file_t *file )
+{
+#if defined(HAVE_IO_URING)
+    if ( file->uring ) return file->direct ? "uring" : "uring, buffered";
+#endif
+    if ( file->stream != NULL ) return "stdio";
+
+    return file->direct ? "direct" : "buffered";
+};
+
+io_file_t* io_open ( const char *fname, const char *mode, const char* srcfilename, const int linenumber )
+{
+    io_file_t *file = (io_file_t*) calloc( 1, sizeof(io_file_t) );
+
+    if ( file == NULL )
+    {
+        print_error("Cant allocate the handle of %s", fname);
+        abort();
+    }
+
+    strncpy( file->name, fname, sizeof(file->name) - 1 );
+    file->writing = ( mode[0] == 'w' );
+    file->fd      = -1;
+
+    if ( io_backend == STDIO_BACKEND )
+    {
+        file->stream = safe_fopen( fname, mode, srcfilename, linenumber );
+        return file;
+    }
+
+    const int flags = file->writing ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+
+#if defined(O_DIRECT)
+    file->fd     = open( fname, flags | O_DIRECT, 0644 );
+    file->direct = ( file->fd != -1 );
+
+    /* the file system does not support direct transfers */
+    if ( file->fd == -1 && errno == EINVAL )
+    {
+        print_debug("%s cannot be opened with O_DIRECT, buffering its transfers", fname);
+        file->fd = open( fname, flags, 0644 );
+    }
+#else
+    file->fd = open( fname, flags, 0644 );
+#endif
+
+    if ( file->fd == -1 )
+    {
+        print_error("Cant open filename %s, openmode '%s' (called from %s - %d): %s",
+                    fname, mode, srcfilename, linenumber, strerror(errno));
+        exit(-1);
+    }
+
+#if defined(HAVE_IO_URING)
+    if ( io_backend == URING_BACKEND )
+    {
+        if ( ring_setup( &file->ring, (unsigned) io_depth ) == 0 )
+        {
+            file->uring = 1;
+            file->slots = (io_slot_t*) calloc( io_depth, sizeof(io_slot_t) );
+
+            for (int s = 0; s < io_depth; s++)
+                file->slots[s].stage = (unsigned char*) __malloc( PAGE_BYTES, io_chunk_bytes );
+
+            if ( file->writing )
+            {
+                file->current = acquire_slot( file );
+                file->stage   = file->slots[ file->current ].stage;
+            }
+
+            return file;
+        }
+
+        print_debug("Unable to set up an io_uring for %s (%s), transferring it synchronously",
+                    fname, strerror(errno));
+    }
+#endif
+
+    file->stage = (unsigned char*) __malloc( PAGE_BYTES, io_chunk_bytes );
+
+    return file;
+};
+
+void io_close ( io_file_t *file )
+{
+    const double tstart = dtime();
+
+    if ( file->stream != NULL )
+    {
+        safe_fclose( file->name, file->stream, __FILE__, __LINE__ );
+    }
+    else
+    {
+        /* the tail goes out as whole pages and the file is cut back to its size */
+        const size_t size = file->offset + file->staged;
+
+        if ( file->writing && file->staged > 0 )
+        {
+            const size_t padded = ((file->staged + PAGE_BYTES - 1) / PAGE_BYTES) * PAGE_BYTES;
+
+            memset( file->stage + file->staged, 0, padded - file->staged );
+            write_chunk( file, file->stage, padded );
+        }
+
+#if defined(HAVE_IO_URING)
+        if ( file->uring ) wait_slots( file );
+#endif
+
+        if ( file->writing && file->offset != size && ftruncate( file->fd, (off_t) size ) != 0 )
+        {
+            print_error("Unable to truncate %s: %s", file->name, strerror(errno));
+            abort();
+        }
+
+        if ( close( file->fd ) != 0 )
+        {
+            print_error("Cant close filename %s: %s", file->name, strerror(errno));
+            abort();
+        }
+
+#if defined(HAVE_IO_URING)
+        if ( file->uring )
+        {
+            for (int s = 0; s < io_depth; s++)
+                __free( file->slots[s].stage );
+
+            free( file->slots );
+            ring_teardown( &file->ring );
+        }
+        else
+#endif
+            __free( file->stage );
+    }
+
+    print_debug("%s %s (%s): %lf MB", file->writing ? "Wrote" : "Read",
+                file->name, file_backend( file ), file->moved / (1000.0 * 1000.0));
+
+    account( file, 0, 1, tstart );
+
+    free( file );
+};
+
+static void write_bytes ( io_file_t *file, const void *buffer, const size_t bytes )
+{
+    const unsigned char *src  = (const unsigned char*) buffer;
+    size_t               left = bytes;
+
+    file->moved += bytes;
+
+    while ( left > 0 )
+    {
+        size_t n = (left < io_chunk_bytes) ? left : io_chunk_bytes;
+
+        if ( file->stream != NULL )
+        {
+            if ( fwrite( src, 1, n, file->stream ) != n )
+            {
+                print_error("Error while writing %s", file->name);
+                abort();
+            }
+        }
+        else if ( file->staged == 0 && n >= PAGE_BYTES && page_aligned( src, file->offset ) )
+        {
+            /* whole pages go straight from the caller's buffer, only a partial page is staged */
+            n -= n % PAGE_BYTES;
+            write_chunk( file, src, n );
+        }
+        else
+        {
+            const size_t room   = io_chunk_bytes - file->staged;
+            const size_t copied = (n < room) ? n : room;
+
+            memcpy( file->stage + file->staged, src, copied );
+            file->staged += copied;
+
+            if ( file->staged == io_chunk_bytes )
+            {
+                file->staged = 0;
+                write_chunk( file, file->stage, io_chunk_bytes );
+            }
+
+            src  += copied;
+            left -= copied;
+            continue;
+        }
+
+        src  += n;
+        left -= n;
+    }
+
+#if defined(HAVE_IO_URING)
+    /* the caller may change or free its buffer once this returns, only the staged chunks stay in flight */
+    if ( file->uring )
+    {
+        for (int s = 0; s < io_depth; s++)
+            while ( file->slots[s].borrowed )
+                complete_slot( file );
+    }
+#endif
+};
+
+static void read_bytes ( io_file_t *file, void *buffer, const size_t bytes )
+{
+    unsigned char *dst  = (unsigned char*) buffer;
+    size_t         left = bytes;
+
+    file->moved += bytes;
+
+#if defined(HAVE_IO_URING)
+    if ( file->uring )
+    {
+        ring_read( file, dst, bytes );
+        return;
+    }
+#endif
+
+    while ( left > 0 )
+    {
+        size_t n = (left < io_chunk_bytes) ? left : io_chunk_bytes;
+
+        if ( file->stream != NULL )
+        {
+            if ( fread( dst, 1, n, file->stream ) != n )
+            {
+                print_error("Error while reading %s", file->name);
+                abort();
+            }
+        }
+        else if ( file->position >= file->offset && file->position < file->offset + file->staged )
+        {
+            /* the staged chunk holds the next bytes */
+            const size_t avail = file->offset + file->staged - file->position;
+            n = (n < avail) ? n : avail;
+
+            memcpy( dst, file->stage + (file->position - file->offset), n );
+            file->position += n;
+        }
+        else if ( n == io_chunk_bytes && page_aligned( dst, file->position ) )
+        {
+            /* whole chunks go straight to the caller's buffer */
+            if ( direct_pread( file, dst, n, file->position ) != n )
+            {
+                print_error("Unexpected end of file %s", file->name);
+                abort();
+            }
+            file->position += n;
+        }
+        else
+        {
+            file->offset = file->position - file->position % PAGE_BYTES;
+            file->staged = direct_pread( file, file->stage, io_chunk_bytes, file->offset );
+
+            if ( file->position >= file->offset + file->staged )
+            {
+                print_error("Unexpected end of file %s", file->name);
+                abort();
+            }
+            continue;
+        }
+
+        dst  += n;
+        left -= n;
+    }
+};
+
+void io_write ( io_file_t *file, const void *buffer, const size_t bytes )
+{
+    const double tstart = dtime();
+
+    write_bytes( file, buffer, bytes );
+
+    account( file, bytes, 0, tstart );
+};
+
+void io_read ( io_file_t *file, void *buffer, const size_t bytes )
+{
+    const double tstart = dtime();
+
+    read_bytes( file, buffer, bytes );
+
+    account( file, bytes, 0, tstart );
+};
+
+void io_drain ( io_file_t *file )
+{
+#if defined(HAVE_IO_URING)
+    if ( file->uring && file->inflight > 0 )
+    {
+        const double tstart = dtime();
+
+        wait_slots( file );
+
+        account( file, 0, 0, tstart );
+    }
+#endif
+};
+
+void io_pad ( io_file_t *file )
+{
+    static const unsigned char zeroes[4096];
+
+    const size_t pad = (PAGE_BYTES - file->moved % PAGE_BYTES) % PAGE_BYTES;
+
+    for (size_t done = 0; done < pad; done += sizeof(zeroes))
+        io_write( file, zeroes, (pad - done < sizeof(zeroes)) ? pad - done : sizeof(zeroes) );
+
+    /* the staged pages go out now, so the next write starts with an empty stage */
+    if ( file->stream == NULL && file->staged > 0 )
+    {
+        const double tstart = dtime();
+
+        write_chunk( file, file->stage, file->staged );
+        file->staged = 0;
+
+        account( file, 0, 0, tstart );
+    }
+};
+
+void io_reserve ( io_file_t *file, const size_t bytes )
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    const int fd = (file->stream != NULL) ? fileno( file->stream ) : file->fd;
+
+    if ( fallocate( fd, FALLOC_FL_KEEP_SIZE, 0, (off_t) bytes ) != 0 )
+        print_debug("Unable to preallocate %zu bytes for %s: %s", bytes, file->name, strerror(errno));
+#else
+    print_debug("Preallocation of %s is not supported on this system", file->name);
+#endif
+};
+
+void io_seek ( io_file_t *file, const size_t offset )
+{
+    if ( file->writing )
+    {
+        print_error("Cant seek %s, it is open for writing", file->name);
+        abort();
+    }
+
+    if ( file->stream != NULL )
+    {
+        if ( fseek( file->stream, (long) offset, SEEK_SET ) != 0 )
+        {
+            print_error("fseek() failed to set the correct position in %s", file->name);
+            abort();
+        }
+    }
+    else
+        file->position = offset;
+};
+
+size_t io_size ( io_file_t *file )
+{
+    if ( file->writing && file->stream == NULL )
+        return file->offset + file->staged;
+
+    if ( file->stream != NULL )
+        fflush( file->stream );
+
+    struct stat status;
+    const int fd = (file->stream != NULL) ? fileno( file->stream ) : file->fd;
+
+    if ( fstat( fd, &status ) != 0 )
+    {
+        print_error("Unable to query the size of %s: %s", file->name, strerror(errno));
+        abort();
+    }
+
+    return (size_t) status.st_size;
+};
+
+void io_report ( const char *pass )
+{
+    static const char *backends[] = { "stdio", "direct", "uring" };
+
+    pthread_mutex_lock( &io_totals_lock );
+
+    for (int b = 0; b < 3; b++)
+    {
+        for (int writing = 1; writing >= 0; writing--)
+        {
+            const io_totals_t *t = &io_totals[b];
+
+            if ( t->files[writing] == 0 && t->bytes[writing] == 0 ) continue;
+
+            const double mbytes = t->bytes[writing] / (1000.0 * 1000.0);
+
+            print_stats("%s: %s %lf MB %s %d %s files in %lf seconds of I/O calls (%lf MB/s)", pass,
+                        writing ? "wrote" : "read", mbytes, writing ? "to" : "from", t->files[writing],
+                        backends[b], t->seconds[writing],
+                        (t->seconds[writing] > 0.0) ? mbytes / t->seconds[writing] : 0.0);
+        }
+    }
+
+    memset( io_totals, 0, sizeof(io_totals) );
+
+    pthread_mutex_unlock( &io_totals_lock );
+};
@@ -29,6 +29,76 @@
 
 #include "fwi/fwi_kernel.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+
+numa_placement_t numa_placement = FIRST_TOUCH;
+model_loader_t   model_loader   = MMAP_LOADER;
+halo_diagnostics_t halo_diagnostics = NO_HALO_DIAGNOSTICS;
+
+/*
+ * FWI_NUMA selects how the pages of the shot arena get their NUMA node:
+ * 'first-touch' (default) zeroes every field with the y-partition of the
+ * propagator loops, 'bind' additionally mbinds each thread's planes to its
+ * node and 'none' leaves the placement to whoever writes the fields first.
+ */
+void select_numa_placement (void)
+{
+    const char* name = read_env_variable_or_default( "FWI_NUMA", "first-touch" );
+
+    if      ( strcmp( name, "first-touch" ) == 0 ) numa_placement = FIRST_TOUCH;
+    else if ( strcmp( name, "bind"        ) == 0 ) numa_placement = BIND_PAGES;
+    else if ( strcmp( name, "none"        ) == 0 ) numa_placement = SERIAL_TOUCH;
+    else
+    {
+        print_error("Unknown NUMA placement '%s' in FWI_NUMA, using 'first-touch'", name);
+        numa_placement = FIRST_TOUCH;
+    }
+
+    print_info("NUMA placement of shot arrays: %s", (numa_placement == BIND_PAGES ) ? "bind" :
+                                                    (numa_placement == FIRST_TOUCH) ? "first-touch" : "none");
+};
+
+/*
+ * FWI_MODEL_LOADER selects how the initial velocity model is read: 'mmap'
+ * (default) maps the slab of the rank and copies it with the y-partition of
+ * the propagator loops, 'read' issues one fread per field.
+ */
+void select_model_loader (void)
+{
+    const char* name = read_env_variable_or_default( "FWI_MODEL_LOADER", "mmap" );
+
+    if      ( strcmp( name, "mmap" ) == 0 ) model_loader = MMAP_LOADER;
+    else if ( strcmp( name, "read" ) == 0 ) model_loader = READ_LOADER;
+    else
+    {
+        print_error("Unknown model loader '%s' in FWI_MODEL_LOADER, using 'mmap'", name);
+        model_loader = MMAP_LOADER;
+    }
+
+    print_info("Velocity model loader: %s", (model_loader == MMAP_LOADER) ? "mmap" : "read");
+};
+
+/*
+ * FWI_HALO_DIAGNOSTICS=waits times every boundary exchange wait and, at the
+ * end of each shot, logs how long the rank waited on each neighbour.
+ * 'none' (default) waits for all the messages of a phase at once.
+ */
+void select_halo_diagnostics (void)
+{
+    const char* name = read_env_variable_or_default( "FWI_HALO_DIAGNOSTICS", "none" );
+
+    if      ( strcmp( name, "none"  ) == 0 ) halo_diagnostics = NO_HALO_DIAGNOSTICS;
+    else if ( strcmp( name, "waits" ) == 0 ) halo_diagnostics = HALO_WAIT_TIMES;
+    else
+    {
+        print_error("Unknown halo diagnostics '%s' in FWI_HALO_DIAGNOSTICS, using 'none'", name);
+        halo_diagnostics = NO_HALO_DIAGNOSTICS;
+    }
+
+    print_info("Boundary exchange diagnostics: %s", (halo_diagnostics == HALO_WAIT_TIMES) ? "waits" : "none");
+};
+
 /*
  * Initializes an array of length "length" to a random number.
  */
@@ -48,6 +118,8 @@ void set_array_to_constant( real* restrict array, const real value, const intege
 {
 #if defined(_OPENACC)
     #pragma acc kernels copyin(array[0:length])
+#elif defined(_OPENMP)
+    #pragma omp parallel for
 #endif
     for( integer i = 0; i < length; i++ )
         array[i] = value;
@@ -116,6 +188,161 @@ void check_memory_shot( const integer dimmz,
 };
 
 
+/*
+ * All the per-shot fields (21 coefficients, 12 velocities, 24 stresses and
+ * the density) live in a single huge-page backed allocation. Each field is
+ * rounded up to whole pages plus one spare page, and field 'f' starts 'f'
+ * cache lines past its page boundary, so that the streams of a stencil do
+ * not alias in the 4K-indexed L1 sets. free_memory_shot keeps the arena
+ * around and the next shot with the same dimensions (the common case
+ * across shots, gradients and frequencies) reuses it.
+ */
+#define SHOT_FIELDS 58
+
+struct shot_arena_s {
+    char    *base;
+    size_t   bytes;
+    integer  ncells;
+};
+
+/* arena returned by the last free_memory_shot, if any */
+static shot_arena_t *idle_arena = NULL;
+
+static size_t arena_field_stride (const integer ncells)
+{
+    const size_t size = ncells * sizeof(real);
+
+    return ((size + PAGE_BYTES - 1) / PAGE_BYTES + 1) * PAGE_BYTES;
+};
+
+static real* arena_field (const shot_arena_t *arena, const int field)
+{
+    const size_t offset = field * arena_field_stride( arena->ncells ) +
+                          (field * ALIGN_REAL) % PAGE_BYTES;
+
+    return (real*) (arena->base + offset);
+};
+
+static void destroy_shot_arena (shot_arena_t *arena)
+{
+    __free_pages( arena->base, arena->bytes );
+    free( arena );
+};
+
+/*
+ * Planes [y0, yf) of the thread 'tid' out of 'nthreads': the Phase-2 planes
+ * [2*HALO, dimmy-2*HALO) are split in contiguous blocks like the static
+ * schedule of the propagator loops, and the boundary planes go to the first
+ * and the last thread, which compute the neighbouring blocks.
+ */
+static void thread_planes (const integer  dimmy,
+                           const integer  tid,
+                           const integer  nthreads,
+                           integer       *y0,
+                           integer       *yf)
+{
+    const integer ny0   = min_int( 2*HALO, dimmy );
+    const integer nyf   = max_int( dimmy - 2*HALO, ny0 );
+    const integer chunk = (nyf - ny0) / nthreads;
+    const integer extra = (nyf - ny0) % nthreads;
+
+    *y0 = ny0 + tid * chunk + min_int( tid, extra );
+    *yf = *y0 + chunk + ((tid < extra) ? 1 : 0);
+
+    if ( tid == 0          ) *y0 = 0;
+    if ( tid == nthreads-1 ) *yf = dimmy;
+};
+
+/*
+ * Places the pages of a new arena by zeroing every field from the thread
+ * that will update it (see thread_planes).
+ */
+static void place_shot_arena (const shot_arena_t *arena,
+                              const integer       dimmz,
+                              const integer       dimmx,
+                              const integer       dimmy)
+{
+    if ( numa_placement == SERIAL_TOUCH ) return;
+
+    const integer plane = dimmz * dimmx;
+    int           failed = 0;
+
+#if defined(_OPENMP)
+    #pragma omp parallel reduction(+:failed)
+#endif
+    {
+#if defined(_OPENMP)
+        const integer nthreads = omp_get_num_threads();
+        const integer tid      = omp_get_thread_num();
+#else
+        const integer nthreads = 1;
+        const integer tid      = 0;
+#endif
+        integer y0, yf;
+        thread_planes( dimmy, tid, nthreads, &y0, &yf );
+
+        for (int field = 0; field < SHOT_FIELDS; field++)
+        {
+            real *slab = arena_field( arena, field ) + y0 * plane;
+            const size_t bytes = (size_t) (yf - y0) * plane * sizeof(real);
+
+            if ( numa_placement == BIND_PAGES && bytes > 0 )
+                failed += (bind_to_local_node( slab, bytes ) != 0);
+
+            memset( slab, 0, bytes );
+        }
+    }
+
+    if ( failed )
+        print_info("mbind() is not available, shot arrays placed by first touch only");
+};
+
+static shot_arena_t* acquire_shot_arena (const integer dimmz,
+                                         const integer dimmx,
+                                         const integer dimmy)
+{
+    const integer ncells = dimmz * dimmx * dimmy;
+    shot_arena_t *arena  = idle_arena;
+    idle_arena = NULL;
+
+    if ( arena != NULL && arena->ncells == ncells )
+    {
+        print_debug("Reusing the shot arena of "I" cells", ncells);
+        return (arena);
+    }
+
+    if ( arena != NULL ) destroy_shot_arena( arena );
+
+    arena = (shot_arena_t*) malloc( sizeof(shot_arena_t) );
+    arena->ncells = ncells;
+    arena->bytes  = SHOT_FIELDS * arena_field_stride( ncells );
+    arena->base   = (char*) __malloc_pages( arena->bytes );
+
+    place_shot_arena( arena, dimmz, dimmx, dimmy );
+
+    print_stats("Shot arena of %d fields uses %zu bytes (%lf GB)",
+            SHOT_FIELDS, arena->bytes, TOGB(arena->bytes));
+
+    return (arena);
+};
+
+/* keeps 'arena' for the next shot, only the most recent one is retained */
+static void park_shot_arena (shot_arena_t *arena)
+{
+    if ( arena == NULL ) return;
+
+    if ( idle_arena != NULL ) destroy_shot_arena( idle_arena );
+
+    idle_arena = arena;
+};
+
+void release_shot_arena (void)
+{
+    if ( idle_arena != NULL ) destroy_shot_arena( idle_arena );
+
+    idle_arena = NULL;
+};
+
 void alloc_memory_shot( const integer dimmz,
                         const integer dimmx,
                         const integer dimmy,
@@ -132,81 +359,88 @@ void alloc_memory_shot( const integer dimmz,
     print_debug("ptr size = " I " bytes ("I" elements)", 
             size, (size_t) ncells);
 
+    shot_arena_t *arena = acquire_shot_arena( dimmz, dimmx, dimmy );
+    int           field = 0;
+
     /* allocate coefficients */
-    c->c11 = (real*) __malloc( ALIGN_REAL, size);
-    c->c12 = (real*) __malloc( ALIGN_REAL, size);
-    c->c13 = (real*) __malloc( ALIGN_REAL, size);
-    c->c14 = (real*) __malloc( ALIGN_REAL, size);
-    c->c15 = (real*) __malloc( ALIGN_REAL, size);
-    c->c16 = (real*) __malloc( ALIGN_REAL, size);
-
-    c->c22 = (real*) __malloc( ALIGN_REAL, size);
-    c->c23 = (real*) __malloc( ALIGN_REAL, size);
-    c->c24 = (real*) __malloc( ALIGN_REAL, size);
-    c->c25 = (real*) __malloc( ALIGN_REAL, size);
-    c->c26 = (real*) __malloc( ALIGN_REAL, size);
-
-    c->c33 = (real*) __malloc( ALIGN_REAL, size);
-    c->c34 = (real*) __malloc( ALIGN_REAL, size);
-    c->c35 = (real*) __malloc( ALIGN_REAL, size);
-    c->c36 = (real*) __malloc( ALIGN_REAL, size);
-
-    c->c44 = (real*) __malloc( ALIGN_REAL, size);
-    c->c45 = (real*) __malloc( ALIGN_REAL, size);
-    c->c46 = (real*) __malloc( ALIGN_REAL, size);
-
-    c->c55 = (real*) __malloc( ALIGN_REAL, size);
-    c->c56 = (real*) __malloc( ALIGN_REAL, size);
-    c->c66 = (real*) __malloc( ALIGN_REAL, size);
+    c->c11 = arena_field( arena, field++ );
+    c->c12 = arena_field( arena, field++ );
+    c->c13 = arena_field( arena, field++ );
+    c->c14 = arena_field( arena, field++ );
+    c->c15 = arena_field( arena, field++ );
+    c->c16 = arena_field( arena, field++ );
+
+    c->c22 = arena_field( arena, field++ );
+    c->c23 = arena_field( arena, field++ );
+    c->c24 = arena_field( arena, field++ );
+    c->c25 = arena_field( arena, field++ );
+    c->c26 = arena_field( arena, field++ );
+
+    c->c33 = arena_field( arena, field++ );
+    c->c34 = arena_field( arena, field++ );
+    c->c35 = arena_field( arena, field++ );
+    c->c36 = arena_field( arena, field++ );
+
+    c->c44 = arena_field( arena, field++ );
+    c->c45 = arena_field( arena, field++ );
+    c->c46 = arena_field( arena, field++ );
+
+    c->c55 = arena_field( arena, field++ );
+    c->c56 = arena_field( arena, field++ );
+    c->c66 = arena_field( arena, field++ );
 
     /* allocate velocity components */
-    v->tl.u = (real*) __malloc( ALIGN_REAL, size);
-    v->tl.v = (real*) __malloc( ALIGN_REAL, size);
-    v->tl.w = (real*) __malloc( ALIGN_REAL, size);
+    v->tl.u = arena_field( arena, field++ );
+    v->tl.v = arena_field( arena, field++ );
+    v->tl.w = arena_field( arena, field++ );
 
-    v->tr.u = (real*) __malloc( ALIGN_REAL, size);
-    v->tr.v = (real*) __malloc( ALIGN_REAL, size);
-    v->tr.w = (real*) __malloc( ALIGN_REAL, size);
+    v->tr.u = arena_field( arena, field++ );
+    v->tr.v = arena_field( arena, field++ );
+    v->tr.w = arena_field( arena, field++ );
 
-    v->bl.u = (real*) __malloc( ALIGN_REAL, size);
-    v->bl.v = (real*) __malloc( ALIGN_REAL, size);
-    v->bl.w = (real*) __malloc( ALIGN_REAL, size);
+    v->bl.u = arena_field( arena, field++ );
+    v->bl.v = arena_field( arena, field++ );
+    v->bl.w = arena_field( arena, field++ );
 
-    v->br.u = (real*) __malloc( ALIGN_REAL, size);
-    v->br.v = (real*) __malloc( ALIGN_REAL, size);
-    v->br.w = (real*) __malloc( ALIGN_REAL, size);
+    v->br.u = arena_field( arena, field++ );
+    v->br.v = arena_field( arena, field++ );
+    v->br.w = arena_field( arena, field++ );
 
     /* allocate stress components   */
-    s->tl.zz = (real*) __malloc( ALIGN_REAL, size);
-    s->tl.xz = (real*) __malloc( ALIGN_REAL, size);
-    s->tl.yz = (real*) __malloc( ALIGN_REAL, size);
-    s->tl.xx = (real*) __malloc( ALIGN_REAL, size);
-    s->tl.xy = (real*) __malloc( ALIGN_REAL, size);
-    s->tl.yy = (real*) __malloc( ALIGN_REAL, size);
-
-    s->tr.zz = (real*) __malloc( ALIGN_REAL, size);
-    s->tr.xz = (real*) __malloc( ALIGN_REAL, size);
-    s->tr.yz = (real*) __malloc( ALIGN_REAL, size);
-    s->tr.xx = (real*) __malloc( ALIGN_REAL, size);
-    s->tr.xy = (real*) __malloc( ALIGN_REAL, size);
-    s->tr.yy = (real*) __malloc( ALIGN_REAL, size);
-
-    s->bl.zz = (real*) __malloc( ALIGN_REAL, size);
-    s->bl.xz = (real*) __malloc( ALIGN_REAL, size);
-    s->bl.yz = (real*) __malloc( ALIGN_REAL, size);
-    s->bl.xx = (real*) __malloc( ALIGN_REAL, size);
-    s->bl.xy = (real*) __malloc( ALIGN_REAL, size);
-    s->bl.yy = (real*) __malloc( ALIGN_REAL, size);
-
-    s->br.zz = (real*) __malloc( ALIGN_REAL, size);
-    s->br.xz = (real*) __malloc( ALIGN_REAL, size);
-    s->br.yz = (real*) __malloc( ALIGN_REAL, size);
-    s->br.xx = (real*) __malloc( ALIGN_REAL, size);
-    s->br.xy = (real*) __malloc( ALIGN_REAL, size);
-    s->br.yy = (real*) __malloc( ALIGN_REAL, size);
+    s->tl.zz = arena_field( arena, field++ );
+    s->tl.xz = arena_field( arena, field++ );
+    s->tl.yz = arena_field( arena, field++ );
+    s->tl.xx = arena_field( arena, field++ );
+    s->tl.xy = arena_field( arena, field++ );
+    s->tl.yy = arena_field( arena, field++ );
+
+    s->tr.zz = arena_field( arena, field++ );
+    s->tr.xz = arena_field( arena, field++ );
+    s->tr.yz = arena_field( arena, field++ );
+    s->tr.xx = arena_field( arena, field++ );
+    s->tr.xy = arena_field( arena, field++ );
+    s->tr.yy = arena_field( arena, field++ );
+
+    s->bl.zz = arena_field( arena, field++ );
+    s->bl.xz = arena_field( arena, field++ );
+    s->bl.yz = arena_field( arena, field++ );
+    s->bl.xx = arena_field( arena, field++ );
+    s->bl.xy = arena_field( arena, field++ );
+    s->bl.yy = arena_field( arena, field++ );
+
+    s->br.zz = arena_field( arena, field++ );
+    s->br.xz = arena_field( arena, field++ );
+    s->br.yz = arena_field( arena, field++ );
+    s->br.xx = arena_field( arena, field++ );
+    s->br.xy = arena_field( arena, field++ );
+    s->br.yy = arena_field( arena, field++ );
 
     /* allocate density array       */
-    *rho = (real*) __malloc( ALIGN_REAL, size);
+    *rho = arena_field( arena, field++ );
+
+    /* the coefficient cache is built on demand by build_coeff_cache */
+    c->cache = NULL;
+    c->arena = arena;
 
 #if defined(_OPENACC)
     const real* rrho  = *rho;
@@ -363,108 +597,384 @@ void free_memory_shot( coeff_t *c,
 
 #endif /* end pragma _OPENACC */
 
-    /* deallocate coefficients */
-    __free( (void*) c->c11 );
-    __free( (void*) c->c12 );
-    __free( (void*) c->c13 );
-    __free( (void*) c->c14 );
-    __free( (void*) c->c15 );
-    __free( (void*) c->c16 );
-
-    __free( (void*) c->c22 );
-    __free( (void*) c->c23 );
-    __free( (void*) c->c24 );
-    __free( (void*) c->c25 );
-    __free( (void*) c->c26 );
-    __free( (void*) c->c33 );
-
-    __free( (void*) c->c34 );
-    __free( (void*) c->c35 );
-    __free( (void*) c->c36 );
-
-    __free( (void*) c->c44 );
-    __free( (void*) c->c45 );
-    __free( (void*) c->c46 );
-
-    __free( (void*) c->c55 );
-    __free( (void*) c->c56 );
-
-    __free( (void*) c->c66 );
-
-    /* deallocate velocity components */
-    __free( (void*) v->tl.u );
-    __free( (void*) v->tl.v );
-    __free( (void*) v->tl.w );
-
-    __free( (void*) v->tr.u );
-    __free( (void*) v->tr.v );
-    __free( (void*) v->tr.w );
-
-    __free( (void*) v->bl.u );
-    __free( (void*) v->bl.v );
-    __free( (void*) v->bl.w );
-
-    __free( (void*) v->br.u );
-    __free( (void*) v->br.v );
-    __free( (void*) v->br.w );
-
-    /* deallocate stres components   */
-    __free( (void*) s->tl.zz );
-    __free( (void*) s->tl.xz );
-    __free( (void*) s->tl.yz );
-    __free( (void*) s->tl.xx );
-    __free( (void*) s->tl.xy );
-    __free( (void*) s->tl.yy );
-
-    __free( (void*) s->tr.zz );
-    __free( (void*) s->tr.xz );
-    __free( (void*) s->tr.yz );
-    __free( (void*) s->tr.xx );
-    __free( (void*) s->tr.xy );
-    __free( (void*) s->tr.yy );
-
-    __free( (void*) s->bl.zz );
-    __free( (void*) s->bl.xz );
-    __free( (void*) s->bl.yz );
-    __free( (void*) s->bl.xx );
-    __free( (void*) s->bl.xy );
-    __free( (void*) s->bl.yy );
-
-    __free( (void*) s->br.zz );
-    __free( (void*) s->br.xz );
-    __free( (void*) s->br.yz );
-    __free( (void*) s->br.xx );
-    __free( (void*) s->br.xy );
-    __free( (void*) s->br.yy );
-
-
-    /* deallocate density array       */
-    __free( (void*) *rho );
+    /* deallocate cached cell averages */
+    free_coeff_cache( c );
+
+    /* hand the arrays back to the shot arena */
+    park_shot_arena( c->arena );
+    c->arena = NULL;
+
+    POP_RANGE
+};
+
+static void alloc_cell_coeffs( coeff_t *cc, const size_t size )
+{
+    cc->c11 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c12 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c13 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c14 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c15 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c16 = (real*) __malloc( ALIGN_REAL, size);
+
+    cc->c22 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c23 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c24 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c25 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c26 = (real*) __malloc( ALIGN_REAL, size);
+
+    cc->c33 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c34 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c35 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c36 = (real*) __malloc( ALIGN_REAL, size);
+
+    cc->c44 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c45 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c46 = (real*) __malloc( ALIGN_REAL, size);
+
+    cc->c55 = (real*) __malloc( ALIGN_REAL, size);
+    cc->c56 = (real*) __malloc( ALIGN_REAL, size);
+
+    cc->c66 = (real*) __malloc( ALIGN_REAL, size);
+
+    cc->cache = NULL;
+};
+
+static void free_cell_coeffs( coeff_t *cc )
+{
+    __free( (void*) cc->c11 );
+    __free( (void*) cc->c12 );
+    __free( (void*) cc->c13 );
+    __free( (void*) cc->c14 );
+    __free( (void*) cc->c15 );
+    __free( (void*) cc->c16 );
+
+    __free( (void*) cc->c22 );
+    __free( (void*) cc->c23 );
+    __free( (void*) cc->c24 );
+    __free( (void*) cc->c25 );
+    __free( (void*) cc->c26 );
+
+    __free( (void*) cc->c33 );
+    __free( (void*) cc->c34 );
+    __free( (void*) cc->c35 );
+    __free( (void*) cc->c36 );
+
+    __free( (void*) cc->c44 );
+    __free( (void*) cc->c45 );
+    __free( (void*) cc->c46 );
+
+    __free( (void*) cc->c55 );
+    __free( (void*) cc->c56 );
+
+    __free( (void*) cc->c66 );
+};
+
+/*
+ * Averages the 21 coefficients of a cell type over the whole volume. The
+ * last z, x and y planes have no upper neighbour and are left untouched,
+ * propagators never reach them (they stop HALO planes before).
+ */
+static void fill_cell_coeffs( coeff_t       *cc,
+                              const coeff_t  c,
+                              cell_coeff_t   cell_coeff,
+                              cell_coeff_t   cell_coeff_ARTM,
+                              const integer  dimmz,
+                              const integer  dimmx,
+                              const integer  dimmy)
+{
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+    for (integer y = 0; y < dimmy-1; y++)
+    {
+        for (integer x = 0; x < dimmx-1; x++)
+        {
+            for (integer z = 0; z < dimmz-1; z++)
+            {
+                const integer i = IDX(z, x, y, dimmz, dimmx);
+
+                cc->c11[i] = cell_coeff      (c.c11, z, x, y, dimmz, dimmx);
+                cc->c12[i] = cell_coeff      (c.c12, z, x, y, dimmz, dimmx);
+                cc->c13[i] = cell_coeff      (c.c13, z, x, y, dimmz, dimmx);
+                cc->c14[i] = cell_coeff_ARTM (c.c14, z, x, y, dimmz, dimmx);
+                cc->c15[i] = cell_coeff_ARTM (c.c15, z, x, y, dimmz, dimmx);
+                cc->c16[i] = cell_coeff_ARTM (c.c16, z, x, y, dimmz, dimmx);
+                cc->c22[i] = cell_coeff      (c.c22, z, x, y, dimmz, dimmx);
+                cc->c23[i] = cell_coeff      (c.c23, z, x, y, dimmz, dimmx);
+                cc->c24[i] = cell_coeff_ARTM (c.c24, z, x, y, dimmz, dimmx);
+                cc->c25[i] = cell_coeff_ARTM (c.c25, z, x, y, dimmz, dimmx);
+                cc->c26[i] = cell_coeff_ARTM (c.c26, z, x, y, dimmz, dimmx);
+                cc->c33[i] = cell_coeff      (c.c33, z, x, y, dimmz, dimmx);
+                cc->c34[i] = cell_coeff_ARTM (c.c34, z, x, y, dimmz, dimmx);
+                cc->c35[i] = cell_coeff_ARTM (c.c35, z, x, y, dimmz, dimmx);
+                cc->c36[i] = cell_coeff_ARTM (c.c36, z, x, y, dimmz, dimmx);
+                cc->c44[i] = cell_coeff      (c.c44, z, x, y, dimmz, dimmx);
+                cc->c45[i] = cell_coeff_ARTM (c.c45, z, x, y, dimmz, dimmx);
+                cc->c46[i] = cell_coeff_ARTM (c.c46, z, x, y, dimmz, dimmx);
+                cc->c55[i] = cell_coeff      (c.c55, z, x, y, dimmz, dimmx);
+                cc->c56[i] = cell_coeff_ARTM (c.c56, z, x, y, dimmz, dimmx);
+                cc->c66[i] = cell_coeff      (c.c66, z, x, y, dimmz, dimmx);
+            }
+        }
+    }
+};
+
+/*
+ * Precomputes the cell averages read by the fused propagators. Coefficients
+ * and density do not change during a shot, so this runs once after
+ * load_local_velocity_model instead of every timestep. RHO_CACHE stores the
+ * 4 inverse densities (4 extra arrays), FULL_CACHE also the 21 coefficients
+ * of every cell type (88 extra arrays).
+ */
+void build_coeff_cache( const integer      dimmz,
+                        const integer      dimmx,
+                        const integer      dimmy,
+                        coeff_t            *c,
+                        const real         *rho,
+                        const cache_mode_t mode)
+{
+    c->cache = NULL;
+
+    if ( mode == NO_CACHE ) return;
+
+    PUSH_RANGE
+
+    const integer ncells = dimmz * dimmx * dimmy;
+    const size_t  size   = ncells * sizeof(real);
+
+    coeff_cache_t *cache = (coeff_cache_t*) calloc( 1, sizeof(coeff_cache_t) );
+
+    cache->rho_tl = (real*) __malloc( ALIGN_REAL, size);
+    cache->rho_tr = (real*) __malloc( ALIGN_REAL, size);
+    cache->rho_bl = (real*) __malloc( ALIGN_REAL, size);
+    cache->rho_br = (real*) __malloc( ALIGN_REAL, size);
+
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+    for (integer y = 0; y < dimmy-1; y++)
+        for (integer x = 0; x < dimmx-1; x++)
+            for (integer z = 0; z < dimmz-1; z++)
+            {
+                const integer i = IDX(z, x, y, dimmz, dimmx);
+
+                cache->rho_tl[i] = rho_TL(rho, z, x, y, dimmz, dimmx);
+                cache->rho_tr[i] = rho_TR(rho, z, x, y, dimmz, dimmx);
+                cache->rho_bl[i] = rho_BL(rho, z, x, y, dimmz, dimmx);
+                cache->rho_br[i] = rho_BR(rho, z, x, y, dimmz, dimmx);
+            }
+
+    size_t extra = 4 * size;
+
+    if ( mode == FULL_CACHE )
+    {
+        alloc_cell_coeffs( &cache->tl, size );
+        alloc_cell_coeffs( &cache->tr, size );
+        alloc_cell_coeffs( &cache->bl, size );
+        alloc_cell_coeffs( &cache->br, size );
+
+        fill_cell_coeffs( &cache->tl, *c, cell_coeff_TL, cell_coeff_ARTM_TL, dimmz, dimmx, dimmy );
+        fill_cell_coeffs( &cache->tr, *c, cell_coeff_TR, cell_coeff_ARTM_TR, dimmz, dimmx, dimmy );
+        fill_cell_coeffs( &cache->bl, *c, cell_coeff_BL, cell_coeff_ARTM_BL, dimmz, dimmx, dimmy );
+        fill_cell_coeffs( &cache->br, *c, cell_coeff_BR, cell_coeff_ARTM_BR, dimmz, dimmx, dimmy );
+
+        extra += 4 * 21 * size;
+    }
+
+    c->cache = cache;
+
+    print_stats("Coefficient cache uses %lu extra bytes (%lf GB)", extra, TOGB(extra));
 
     POP_RANGE
 };
 
+void free_coeff_cache( coeff_t *c )
+{
+    coeff_cache_t *cache = c->cache;
+
+    if ( cache == NULL ) return;
+
+    __free( (void*) cache->rho_tl );
+    __free( (void*) cache->rho_tr );
+    __free( (void*) cache->rho_bl );
+    __free( (void*) cache->rho_br );
+
+    if ( cache->br.c11 != NULL )
+    {
+        free_cell_coeffs( &cache->tl );
+        free_cell_coeffs( &cache->tr );
+        free_cell_coeffs( &cache->bl );
+        free_cell_coeffs( &cache->br );
+    }
+
+    free( cache );
+    c->cache = NULL;
+};
+
 /*
  * Loads initial values from coeffs, stress and velocity.
  *
- * dimmz: number of z planes
- * dimmx: number of x planes
- * FirstYPlane: first Y plane of my local domain (includes HALO)
- * LastYPlane: last Y plane of my local domain (includes HALO)
+ * d: local volume of this rank (includes HALO) inside the global model,
+ *    whose fields are stored one after the other
+ */
+#if !defined(DO_NOT_PERFORM_IO)
+/* global index, inside a model field, of the local cell (0, x, y) */
+static size_t model_cell (const domain_t *d, const integer x, const integer y)
+{
+    return (( (size_t) (d->offset[AXIS_Y] + y) * d->global[AXIS_X]
+                     + (d->offset[AXIS_X] + x)) * d->global[AXIS_Z]) + d->offset[AXIS_Z];
+};
+
+/*
+ * Copies the local planes [y0,yf) of a model field: one run per plane when
+ * the rank has whole z columns, one per column otherwise.
  */
-void load_local_velocity_model ( const real    waveletFreq,
-                                 const integer dimmz,
-                                 const integer dimmx,
-                                 const integer FirstYPlane,
-                                 const integer LastYPlane,
-                                 coeff_t *c,
-                                 s_t     *s,
-                                 v_t     *v,
-                                 real    *rho)
+static void copy_model_planes (real           *dst,
+                               const real     *field,
+                               const domain_t *d,
+                               const integer   y0,
+                               const integer   yf)
+{
+    const integer lz = d->size[AXIS_Z];
+    const integer lx = d->size[AXIS_X];
+
+    for (integer y = y0; y < yf; y++)
+    {
+        if ( lz == d->global[AXIS_Z] )
+            memcpy( dst + (size_t) y * lx * lz, field + model_cell( d, 0, y ), (size_t) lx * lz * sizeof(real) );
+        else
+            for (integer x = 0; x < lx; x++)
+                memcpy( dst + ((size_t) y * lx + x) * lz, field + model_cell( d, x, y ), (size_t) lz * sizeof(real) );
+    }
+};
+
+/*
+ * Maps the model and copies the 'fields' of the local volume in parallel,
+ * every thread the planes it updates in the propagator (see thread_planes),
+ * so the copies are NUMA-local and the page faults on the mapping read the
+ * file concurrently. The 'constants' are set to 1 in the same pass. Returns
+ * -1, leaving the fields untouched, when the model cannot be mapped.
+ */
+static int map_velocity_model (const char     *modelname,
+                               const domain_t *d,
+                               real          **fields,
+                               real          **constants,
+                               double         *tstart_inner)
+{
+    const integer plane       = d->size[AXIS_Z] * d->size[AXIS_X];
+    const integer dimmy       = d->size[AXIS_Y];
+    const size_t  globalCells = (size_t) d->global[AXIS_Z] * d->global[AXIS_X] * d->global[AXIS_Y];
+    const size_t  bytes       = globalCells * sizeof(real) * 12;
+
+    const int fd = open( modelname, O_RDONLY );
+    if ( fd < 0 ) return -1;
+
+    struct stat status;
+    if ( fstat( fd, &status ) != 0 || (size_t) status.st_size < bytes )
+    {
+        close( fd );
+        return -1;
+    }
+
+    /* only the pages of the local volume are read */
+    char *map = (char*) mmap( NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+
+    if ( map == MAP_FAILED )
+    {
+        print_info("mmap() of %s failed (%s), reading the model with fread", modelname, strerror(errno));
+        return -1;
+    }
+
+    const real *model = (const real*) map;
+
+    *tstart_inner = dtime();
+
+#if defined(_OPENACC)
+    /* the coefficients live on the device */
+    for (int i = 0; i < 22; i++)
+        set_array_to_constant( constants[i], 1.0, plane * dimmy );
+
+    const int nconstants = 0;
+#else
+    const int nconstants = 22;
+#endif
+
+#if defined(_OPENMP)
+    #pragma omp parallel
+#endif
+    {
+#if defined(_OPENMP)
+        const integer nthreads = omp_get_num_threads();
+        const integer tid      = omp_get_thread_num();
+#else
+        const integer nthreads = 1;
+        const integer tid      = 0;
+#endif
+        integer y0, yf;
+        thread_planes( dimmy, tid, nthreads, &y0, &yf );
+
+        const size_t first = (size_t) y0 * plane;
+        const size_t cells = (size_t) (yf - y0) * plane;
+
+        for (int i = 0; i < nconstants; i++)
+            for (size_t j = first; j < first + cells; j++)
+                constants[i][j] = 1.0;
+
+        for (int i = 0; i < 12; i++)
+            copy_model_planes( fields[i], model + i * globalCells, d, y0, yf );
+    }
+
+    munmap( map, bytes );
+
+    return 0;
+};
+
+/* reads the local volume of a model field with one read per contiguous run */
+static void read_model_field (io_file_t      *model,
+                              real           *dst,
+                              const size_t    field,
+                              const domain_t *d)
+{
+    const integer lz = d->size[AXIS_Z];
+    const integer lx = d->size[AXIS_X];
+    const integer ly = d->size[AXIS_Y];
+
+    /* whole planes are contiguous in the file */
+    if ( lz == d->global[AXIS_Z] && lx == d->global[AXIS_X] )
+    {
+        io_seek( model, (field + model_cell( d, 0, 0 )) * sizeof(real) );
+        io_read( model, dst, (size_t) lz * lx * ly * sizeof(real) );
+        return;
+    }
+
+    for (integer y = 0; y < ly; y++)
+    {
+        if ( lz == d->global[AXIS_Z] )
+        {
+            io_seek( model, (field + model_cell( d, 0, y )) * sizeof(real) );
+            io_read( model, dst + (size_t) y * lx * lz, (size_t) lx * lz * sizeof(real) );
+        }
+        else
+            for (integer x = 0; x < lx; x++)
+            {
+                io_seek( model, (field + model_cell( d, x, y )) * sizeof(real) );
+                io_read( model, dst + ((size_t) y * lx + x) * lz, (size_t) lz * sizeof(real) );
+            }
+    }
+};
+#endif /* end pragma DO_NOT_PERFORM_IO */
+
+void load_local_velocity_model ( const real      waveletFreq,
+                                 const domain_t *d,
+                                 coeff_t        *c,
+                                 s_t            *s,
+                                 v_t            *v,
+                                 real           *rho)
 {
     PUSH_RANGE
 
-    const integer cellsInVolume = dimmz * dimmx * (LastYPlane - FirstYPlane);
+    const integer cellsInVolume = domain_cells( d );
 
     /*
      * Material, velocities and stresses are initizalized
@@ -542,31 +1052,17 @@ void load_local_velocity_model ( const real    waveletFreq,
 
 #else /* load velocity model from external file */
 
-    /* initialize material coefficients */
-    set_array_to_constant( c->c11, 1.0, cellsInVolume);
-    set_array_to_constant( c->c12, 1.0, cellsInVolume);
-    set_array_to_constant( c->c13, 1.0, cellsInVolume);
-    set_array_to_constant( c->c14, 1.0, cellsInVolume);
-    set_array_to_constant( c->c15, 1.0, cellsInVolume);
-    set_array_to_constant( c->c16, 1.0, cellsInVolume);
-    set_array_to_constant( c->c22, 1.0, cellsInVolume);
-    set_array_to_constant( c->c23, 1.0, cellsInVolume);
-    set_array_to_constant( c->c24, 1.0, cellsInVolume);
-    set_array_to_constant( c->c25, 1.0, cellsInVolume);
-    set_array_to_constant( c->c26, 1.0, cellsInVolume);
-    set_array_to_constant( c->c33, 1.0, cellsInVolume);
-    set_array_to_constant( c->c34, 1.0, cellsInVolume);
-    set_array_to_constant( c->c35, 1.0, cellsInVolume);
-    set_array_to_constant( c->c36, 1.0, cellsInVolume);
-    set_array_to_constant( c->c44, 1.0, cellsInVolume);
-    set_array_to_constant( c->c45, 1.0, cellsInVolume);
-    set_array_to_constant( c->c46, 1.0, cellsInVolume);
-    set_array_to_constant( c->c55, 1.0, cellsInVolume);
-    set_array_to_constant( c->c56, 1.0, cellsInVolume);
-    set_array_to_constant( c->c66, 1.0, cellsInVolume);
+    /* velocity components in the order they are stored in the model */
+    real* fields[12] = { v->tl.u, v->tl.v, v->tl.w, v->tr.u, v->tr.v, v->tr.w,
+                         v->bl.u, v->bl.v, v->bl.w, v->br.u, v->br.v, v->br.w };
 
-    /* initialize density (rho) */
-    set_array_to_constant( rho, 1.0, cellsInVolume );
+    /* material coefficients and density are initialized to a constant */
+    real* constants[22] = { c->c11, c->c12, c->c13, c->c14, c->c15, c->c16,
+                            c->c22, c->c23, c->c24, c->c25, c->c26,
+                            c->c33, c->c34, c->c35, c->c36,
+                            c->c44, c->c45, c->c46,
+                            c->c55, c->c56,
+                            c->c66, rho };
 
     /* local variables */
     double tstart_outer, tstart_inner;
@@ -578,36 +1074,39 @@ void load_local_velocity_model ( const real    waveletFreq,
     sprintf( modelname, "../data/inputmodels/velocitymodel_%.2f.bin", waveletFreq );
     print_info("Loading input model %s from disk (this could take a while)", modelname);
 
+    const size_t globalCells = (size_t) d->global[AXIS_Z] * d->global[AXIS_X] * d->global[AXIS_Y];
+
     /* start clock, take into account file opening */
     tstart_outer = dtime();
-    FILE* model = safe_fopen( modelname, "rb", __FILE__, __LINE__ );
 
-    /* start clock, do not take into account file opening */
-    tstart_inner = dtime();
+    /* the mapping goes through the page cache, which the direct backend bypasses */
+    if ( model_loader == MMAP_LOADER && io_backend != DIRECT_BACKEND &&
+         map_velocity_model( modelname, d, fields, constants, &tstart_inner ) == 0 )
+    {
+        /* stop inner timer */
+        tend_inner = dtime() - tstart_inner;
+    }
+    else
+    {
+        for (int i = 0; i < 22; i++)
+            set_array_to_constant( constants[i], 1.0, cellsInVolume );
 
-    /* seek to the correct position corresponding to mpi_rank */
-    if (fseek ( model, sizeof(real) * WRITTEN_FIELDS * dimmz * dimmx * FirstYPlane, SEEK_SET) != 0)
-        print_error("fseek() failed to set the correct position");
+        io_file_t* model = io_open( modelname, "rb", __FILE__, __LINE__ );
 
-    /* initalize velocity components */
-    safe_fread( v->tl.u, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->tl.v, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->tl.w, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->tr.u, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->tr.v, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->tr.w, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->bl.u, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->bl.v, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->bl.w, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->br.u, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->br.v, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
-    safe_fread( v->br.w, sizeof(real), cellsInVolume, model, __FILE__, __LINE__ );
+        /* start clock, do not take into account file opening */
+        tstart_inner = dtime();
 
-    /* stop inner timer */
-    tend_inner = dtime() - tstart_inner;
+        /* initalize velocity components, the local volume of every field */
+        for (int i = 0; i < 12; i++)
+            read_model_field( model, fields[i], i * globalCells, d );
+
+        /* stop inner timer */
+        tend_inner = dtime() - tstart_inner;
+
+        io_close( model );
+    }
 
     /* stop timer and compute statistics */
-    safe_fclose ( modelname, model, __FILE__, __LINE__ );
     tend_outer = dtime() - tstart_outer;
 
     const integer bytesForVolume = WRITTEN_FIELDS * cellsInVolume * sizeof(real);
@@ -688,33 +1187,47 @@ void write_snapshot(char *folder,
 #if defined(LOG_IO_STATS)
     double tstart_outer = dtime();
 #endif
-    FILE *snapshot = safe_fopen(fname,"wb", __FILE__, __LINE__ );
+    io_file_t *snapshot = io_open( fname, "wb", __FILE__, __LINE__ );
 #if defined(LOG_IO_STATS)
     double tstart_inner = dtime();
 #endif
 
-    safe_fwrite( v->tr.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tr.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tr.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+    if ( snapshot_codec != RAW_CODEC )
+    {
+        real* fields[12];
+        snapshot_fields( v, fields );
 
-    safe_fwrite( v->tl.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tl.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tl.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+        unsigned char *encoded = (unsigned char*) __malloc( PAGE_BYTES, encoded_snapshot_bound( 12, cellsInVolume ) );
+        const size_t   bytes   = encode_snapshot( encoded, fields, 12, cellsInVolume );
 
-    safe_fwrite( v->br.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->br.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->br.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+        io_write( snapshot, encoded, bytes );
+        __free( encoded );
+    }
+    else
+    {
+        io_write( snapshot, v->tr.u, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->tr.v, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->tr.w, cellsInVolume * sizeof(real) );
+
+        io_write( snapshot, v->tl.u, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->tl.v, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->tl.w, cellsInVolume * sizeof(real) );
 
-    safe_fwrite( v->bl.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->bl.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->bl.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+        io_write( snapshot, v->br.u, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->br.v, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->br.w, cellsInVolume * sizeof(real) );
+
+        io_write( snapshot, v->bl.u, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->bl.v, cellsInVolume * sizeof(real) );
+        io_write( snapshot, v->bl.w, cellsInVolume * sizeof(real) );
+    }
 
 #if defined(LOG_IO_STATS)
     /* stop inner timer */
     double tend_inner = dtime();
 #endif
     /* close file and stop outer timer */
-    safe_fclose(fname, snapshot, __FILE__, __LINE__ );
+    io_close( snapshot );
 #if defined(LOG_IO_STATS)
     double tend_outer = dtime();
 
@@ -760,35 +1273,50 @@ void read_snapshot(char *folder,
 #if defined(LOG_IO_STATS)
     double tstart_outer = dtime();
 #endif
-    FILE *snapshot = safe_fopen(fname,"rb", __FILE__, __LINE__ );
+    io_file_t *snapshot = io_open( fname, "rb", __FILE__, __LINE__ );
 #if defined(LOG_IO_STATS)
     double tstart_inner = dtime();
 #endif
 
     const integer cellsInVolume  = dimmz * dimmx * dimmy;
 
-    safe_fread( v->tr.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tr.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tr.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+    if ( snapshot_codec != RAW_CODEC )
+    {
+        real* fields[12];
+        snapshot_fields( v, fields );
 
-    safe_fread( v->tl.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tl.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tl.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+        const size_t   capacity = encoded_snapshot_bound( 12, cellsInVolume );
+        unsigned char *encoded  = (unsigned char*) __malloc( PAGE_BYTES, capacity );
+        const size_t   bytes    = read_snapshot_bytes( snapshot, fname, encoded, capacity );
 
-    safe_fread( v->br.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->br.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->br.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+        decode_snapshot( encoded, bytes, fields, 12, cellsInVolume );
+        __free( encoded );
+    }
+    else
+    {
+        io_read ( snapshot, v->tr.u, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->tr.v, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->tr.w, cellsInVolume * sizeof(real) );
 
-    safe_fread( v->bl.u, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->bl.v, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->bl.w, sizeof(real), cellsInVolume, snapshot, __FILE__, __LINE__ );
+        io_read ( snapshot, v->tl.u, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->tl.v, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->tl.w, cellsInVolume * sizeof(real) );
+
+        io_read ( snapshot, v->br.u, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->br.v, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->br.w, cellsInVolume * sizeof(real) );
+
+        io_read ( snapshot, v->bl.u, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->bl.v, cellsInVolume * sizeof(real) );
+        io_read ( snapshot, v->bl.w, cellsInVolume * sizeof(real) );
+    }
 
 #if defined(LOG_IO_STATS)
     /* stop inner timer */
     double tend_inner = dtime() - tstart_inner;
 #endif
     /* close file and stop outer timer */
-    safe_fclose(fname, snapshot, __FILE__, __LINE__ );
+    io_close( snapshot );
 #if defined(LOG_IO_STATS)
     double tend_outer = dtime() - tstart_outer;
 
@@ -813,6 +1341,370 @@ void read_snapshot(char *folder,
     POP_RANGE
 };
 
+/*
+ * Number of time steps advanced by the temporal block that starts at 't'.
+ * Snapshots are written after (FORWARD) or read before (BACKWARD) every
+ * step multiple of stacki, so such steps must close or open a block.
+ */
+static int time_block_length (const int     t,
+                              const int     timesteps,
+                              const integer stacki,
+                              const time_d  direction,
+                              const integer block)
+{
+    int steps = (timesteps - t < block) ? timesteps - t : block;
+
+    if ( direction == FORWARD )
+    {
+        const int last = ((t + stacki - 1) / stacki) * stacki;
+        if ( last - t + 1 < steps ) steps = last - t + 1;
+    }
+    else if ( direction == BACKWARD )
+    {
+        const int next = (t / stacki + 1) * stacki;
+        if ( next - t < steps ) steps = next - t;
+    }
+
+    return steps;
+};
+
+/*
+ * Advances 'steps' time steps over the [nz0,nzf)x[nx0,nxf)x[ny0,nyf) volume
+ * in cache-sized tiles. Half step h (velocity when even, stress when odd)
+ * is shifted by h*HALO cells along z, x and y, which covers the dependency
+ * cone of the 8th order stencils: in those skewed coordinates a cell only
+ * reads values produced by cells with lower or equal coordinates, and only
+ * overwrites values already consumed by them. Tiles are boxes of that
+ * skewed space, so every tile depends on tiles with lower or equal indices
+ * and tiles on the same diagonal (tz+tx+ty constant) run in parallel.
+ * Cells get exactly the same updates as in the plain time loop, hence the
+ * results are bit-identical.
+ */
+static void propagate_time_block (v_t           v,
+                                  s_t           s,
+                                  coeff_t       coeffs,
+                                  real          *rho,
+                                  const integer steps,
+                                  const real    dt,
+                                  const real    dzi,
+                                  const real    dxi,
+                                  const real    dyi,
+                                  const integer nz0,
+                                  const integer nzf,
+                                  const integer nx0,
+                                  const integer nxf,
+                                  const integer ny0,
+                                  const integer nyf,
+                                  const tile_t  size,
+                                  const integer dimmz,
+                                  const integer dimmx)
+{
+    const integer halfsteps = 2 * steps;
+    const integer skew      = HALO * (halfsteps - 1);
+
+    /* tile sizes of 0 stand for the whole (skewed) range */
+    tile_t tile = size;
+    if ( tile.z <= 0 ) tile.z = nzf - nz0 + skew;
+    if ( tile.x <= 0 ) tile.x = nxf - nx0 + skew;
+    if ( tile.y <= 0 ) tile.y = nyf - ny0 + skew;
+
+    const integer ntz = (nzf - nz0 + skew + tile.z - 1) / tile.z;
+    const integer ntx = (nxf - nx0 + skew + tile.x - 1) / tile.x;
+    const integer nty = (nyf - ny0 + skew + tile.y - 1) / tile.y;
+
+    for (integer diagonal = 0; diagonal < ntz + ntx + nty - 2; diagonal++)
+    {
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (integer t = 0; t < ntz * ntx; t++)
+        {
+            const integer tz = t % ntz;
+            const integer tx = t / ntz;
+            const integer ty = diagonal - tz - tx;
+
+            if ( ty < 0 || ty >= nty ) continue;
+
+            for (integer h = 0; h < halfsteps; h++)
+            {
+                const integer shift = h * HALO;
+
+                const integer z0 = max_int( nz0, nz0 + tz * tile.z - shift );
+                const integer zf = min_int( nzf, nz0 + (tz+1) * tile.z - shift );
+                const integer x0 = max_int( nx0, nx0 + tx * tile.x - shift );
+                const integer xf = min_int( nxf, nx0 + (tx+1) * tile.x - shift );
+                const integer y0 = max_int( ny0, ny0 + ty * tile.y - shift );
+                const integer yf = min_int( nyf, ny0 + (ty+1) * tile.y - shift );
+
+                if ( z0 >= zf || x0 >= xf || y0 >= yf ) continue;
+
+                if ( h % 2 == 0 )
+                    velocity_fused_block(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                                         z0, zf, x0, xf, y0, yf, dimmz, dimmx);
+                else
+                    stress_fused_block(s, v, coeffs, dt, dzi, dxi, dyi,
+                                       z0, zf, x0, xf, y0, yf, dimmz, dimmx);
+            }
+        }
+    }
+};
+
+static void phase_propagator(const int     stress,
+                             v_t           v,
+                             s_t           s,
+                             coeff_t       coeffs,
+                             real          *rho,
+                             real          dt,
+                             real          dzi,
+                             real          dxi,
+                             real          dyi,
+                             integer       z0,
+                             integer       zf,
+                             integer       x0,
+                             integer       xf,
+                             integer       y0,
+                             integer       yf,
+                             integer       dimmz,
+                             integer       dimmx,
+                             phase_t       phase)
+{
+    if ( stress )
+        stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
+                          z0, zf, x0, xf, y0, yf, dimmz, dimmx, phase);
+    else
+        velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                            z0, zf, x0, xf, y0, yf, dimmz, dimmx, phase);
+};
+
+/*
+ * Phase 1: the HALO planes next to each exchanged face of the computed box
+ * [nz0+HALO,nzf-HALO) x [nx0+HALO,nxf-HALO) x [ny0+HALO,nyf-HALO). The y
+ * planes are always peeled; the x and z ones only when that axis is split,
+ * each over the range the previous axes left.
+ */
+static void boundary_phase(const int     stress,
+                           v_t           v,
+                           s_t           s,
+                           coeff_t       coeffs,
+                           real          *rho,
+                           real          dt,
+                           real          dzi,
+                           real          dxi,
+                           real          dyi,
+                           integer       nz0,
+                           integer       nzf,
+                           integer       nx0,
+                           integer       nxf,
+                           integer       ny0,
+                           integer       nyf,
+                           integer       dimmz,
+                           integer       dimmx,
+                           halo_exchange_t *halo)
+{
+    const integer z0 = nz0 + HALO, zf = nzf - HALO;
+    const integer x0 = nx0 + HALO, xf = nxf - HALO;
+    const integer y0 = ny0 + HALO, yf = nyf - HALO;
+
+    /* left-most and right-most y planes of the domain */
+    phase_propagator(stress, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                     z0, zf, x0, xf, y0, y0 + HALO, dimmz, dimmx, ONE_L);
+    phase_propagator(stress, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                     z0, zf, x0, xf, yf - HALO, yf, dimmz, dimmx, ONE_R);
+
+    if ( exchanges_axis(halo, AXIS_X) )
+    {
+        phase_propagator(stress, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                         z0, zf, x0, x0 + HALO, y0 + HALO, yf - HALO, dimmz, dimmx, ONE_L);
+        phase_propagator(stress, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                         z0, zf, xf - HALO, xf, y0 + HALO, yf - HALO, dimmz, dimmx, ONE_R);
+    }
+
+    if ( exchanges_axis(halo, AXIS_Z) )
+    {
+        const integer ix0 = exchanges_axis(halo, AXIS_X) ? x0 + HALO : x0;
+        const integer ixf = exchanges_axis(halo, AXIS_X) ? xf - HALO : xf;
+
+        phase_propagator(stress, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                         z0, z0 + HALO, ix0, ixf, y0 + HALO, yf - HALO, dimmz, dimmx, ONE_L);
+        phase_propagator(stress, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                         zf - HALO, zf, ix0, ixf, y0 + HALO, yf - HALO, dimmz, dimmx, ONE_R);
+    }
+};
+
+/* Phase 2: the cells Phase 1 left, which do not depend on the exchanged planes */
+static void central_phase(const int     stress,
+                          v_t           v,
+                          s_t           s,
+                          coeff_t       coeffs,
+                          real          *rho,
+                          real          dt,
+                          real          dzi,
+                          real          dxi,
+                          real          dyi,
+                          integer       nz0,
+                          integer       nzf,
+                          integer       nx0,
+                          integer       nxf,
+                          integer       ny0,
+                          integer       nyf,
+                          integer       dimmz,
+                          integer       dimmx,
+                          halo_exchange_t *halo)
+{
+    const integer zpeel = exchanges_axis(halo, AXIS_Z) ? 2*HALO : HALO;
+    const integer xpeel = exchanges_axis(halo, AXIS_X) ? 2*HALO : HALO;
+
+    phase_propagator(stress, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                     nz0 + zpeel, nzf - zpeel,
+                     nx0 + xpeel, nxf - xpeel,
+                     ny0 + 2*HALO, nyf - 2*HALO,
+                     dimmz, dimmx, TWO);
+};
+
+/*
+ * One step of the plain time loop. Velocity and stress are both computed in
+ * two phases: the planes next to the exchanged faces first, so the boundary
+ * exchange overlaps the central cells. Adds the central-cell times to
+ * tvel and tstress.
+ */
+static void time_step(v_t           v,
+                      s_t           s,
+                      coeff_t       coeffs,
+                      real          *rho,
+                      real          dt,
+                      real          dzi,
+                      real          dxi,
+                      real          dyi,
+                      integer       nz0,
+                      integer       nzf,
+                      integer       nx0,
+                      integer       nxf,
+                      integer       ny0,
+                      integer       nyf,
+                      integer       dimmz,
+                      integer       dimmx,
+                      halo_exchange_t *halo,
+                      double        *tvel,
+                      double        *tstress)
+{
+    /* ------------------------------------------------------------------------------ */
+    /*                      VELOCITY COMPUTATION                                      */
+    /* ------------------------------------------------------------------------------ */
+
+    /* Phase 1. Computation of the planes next to the exchanged faces */
+    boundary_phase(0, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                   nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, halo);
+
+    /* Boundary exchange for velocity values, in flight during Phase 2 */
+    start_velocity_exchange( halo );
+
+    /* Phase 2. Computation of the central cells. */
+    const double tvel_start = dtime();
+
+    central_phase(0, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                  nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, halo);
+
+#if defined(_OPENACC)
+    #pragma acc wait(ONE_L, ONE_R, TWO)
+#endif
+    *tvel += (dtime() - tvel_start);
+
+    /* the stress planes next to the boundaries read the received velocities */
+    wait_boundary_exchange( halo );
+
+    /* ------------------------------------------------------------------------------ */
+    /*                        STRESS COMPUTATION                                      */
+    /* ------------------------------------------------------------------------------ */
+
+    /* Phase 1. Computation of the planes next to the exchanged faces */
+    boundary_phase(1, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                   nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, halo);
+
+    /* Boundary exchange for stress values, in flight during Phase 2 */
+    start_stress_exchange( halo );
+
+    /* Phase 2 computation. Central cells of the domain */
+    const double tstress_start = dtime();
+
+    central_phase(1, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                  nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, halo);
+
+#if defined(_OPENACC)
+    #pragma acc wait(ONE_L, ONE_R, TWO, H2D, D2H)
+#endif
+    *tstress += (dtime() - tstress_start);
+
+    wait_boundary_exchange( halo );
+};
+
+/*
+ * Time steps per temporal block: temporal blocking needs the whole volume
+ * locally, so it is disabled when there are boundary exchanges.
+ */
+static integer usable_time_block (void)
+{
+#if defined(USE_MPI)
+    int nranks;
+    MPI_Comm_size( shot_comm, &nranks );
+
+    if ( nranks > 1 ) return 1;
+#endif
+    return time_block_steps;
+};
+
+/*
+ * Advances (v,s) 'timesteps' time steps exactly as the forward pass does,
+ * but without snapshots or statistics. Used to recompute forward states
+ * from a checkpoint.
+ */
+void advance_shot(v_t           v,
+                  s_t           s,
+                  coeff_t       coeffs,
+                  real          *rho,
+                  int           timesteps,
+                  real          dt,
+                  real          dzi,
+                  real          dxi,
+                  real          dyi,
+                  integer       nz0,
+                  integer       nzf,
+                  integer       nx0,
+                  integer       nxf,
+                  integer       ny0,
+                  integer       nyf,
+                  integer       dimmz,
+                  integer       dimmx,
+                  halo_exchange_t *halo)
+{
+    PUSH_RANGE
+
+    double tvel = 0.0, tstress = 0.0;
+
+    const integer time_block = usable_time_block();
+    const tile_t  time_tile  = (tiling_mode == FIXED_TILING) ? propagator_tile :
+                               auto_time_tile_size( nzf - nz0, nxf - nx0, nyf - ny0,
+                                                    time_block, cache_size_per_thread() );
+    int steps;
+
+    for(int t=0; t < timesteps; t += steps)
+    {
+        steps = (time_block > 1) ? min_int( time_block, timesteps - t ) : 1;
+
+        if ( steps > 1 )
+            propagate_time_block(v, s, coeffs, rho, steps, dt, dzi, dxi, dyi,
+                                 nz0 + HALO, nzf - HALO,
+                                 nx0 + HALO, nxf - HALO,
+                                 ny0 + HALO, nyf - HALO,
+                                 time_tile, dimmz, dimmx);
+        else
+            time_step(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                      nz0, nzf, nx0, nxf, ny0, nyf,
+                      dimmz, dimmx, halo, &tvel, &tstress);
+    }
+
+    POP_RANGE
+};
+
 void propagate_shot(time_d        direction,
                     v_t           v,
                     s_t           s,
@@ -831,7 +1723,8 @@ void propagate_shot(time_d        direction,
                     integer       ny0,
                     integer       nyf,
                     integer       stacki,
-                    char          *folder,
+                    snapshot_store_t *store,
+                    halo_exchange_t *halo,
                     real          *UNUSED(dataflush),
                     integer       dimmz,
                     integer       dimmx,
@@ -840,134 +1733,69 @@ void propagate_shot(time_d        direction,
     PUSH_RANGE
 
     double tglobal_start, tglobal_total = 0.0;
-    double tstress_start, tstress_total = 0.0;
-    double tvel_start, tvel_total = 0.0;
+    double tstress_total = 0.0;
+    double tvel_total = 0.0;
 
-    for(int t=0; t < timesteps; t++)
-    {
-        PUSH_RANGE
+    const integer time_block = usable_time_block();
 
-        if( t % 10 == 0 ) print_info("Computing %d-th timestep", t);
+    if ( time_block_steps > 1 && time_block == 1 )
+        print_info("Temporal blocking is not available with MPI boundary exchanges, using the plain time loop");
 
-        /* perform IO */
-        if ( t%stacki == 0 && direction == BACKWARD) read_snapshot(folder, ntbwd-t, &v, dimmz, dimmx, dimmy);
+    const tile_t time_tile = (tiling_mode == FIXED_TILING) ? propagator_tile :
+                             auto_time_tile_size( nzf - nz0, nxf - nx0, nyf - ny0,
+                                                  time_block, cache_size_per_thread() );
 
-        tglobal_start = dtime();
+    if ( time_block > 1 )
+        print_info("Temporal blocking: up to "I" time steps per block, "I"x"I"x"I" cells per tile",
+                time_block, time_tile.z, time_tile.x, time_tile.y);
 
-        /* wait read_snapshot H2D copies */
-#if defined(_OPENACC)
-        #pragma acc wait(H2D) if ( (t%stacki == 0 && direction == BACKWARD) || t==0 )
-#endif
+    int steps;
 
-        /* ------------------------------------------------------------------------------ */
-        /*                      VELOCITY COMPUTATION                                      */
-        /* ------------------------------------------------------------------------------ */
+    for(int t=0; t < timesteps; t += steps)
+    {
+        PUSH_RANGE
 
-        /* Phase 1. Computation of the left-most planes of the domain */
-        velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
-                            nz0 +   HALO,
-                            nzf -   HALO,
-                            nx0 +   HALO,
-                            nxf -   HALO,
-                            ny0 +   HALO,
-                            ny0 + 2*HALO,
-                            dimmz, dimmx,
-                            ONE_L);
-
-        /* Phase 1. Computation of the right-most planes of the domain */
-        velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
-                            nz0 +   HALO,
-                            nzf -   HALO,
-                            nx0 +   HALO,
-                            nxf -   HALO,
-                            nyf - 2*HALO,
-                            nyf -   HALO,
-                            dimmz, dimmx,
-                            ONE_R);
+        steps = (time_block > 1) ? time_block_length(t, timesteps, stacki, direction, time_block) : 1;
 
-#if defined(USE_MPI)
-        /* Boundary exchange for velocity values */
-        exchange_velocity_boundaries( v, dimmz * dimmx, nyf, ny0);
-#endif
+        if( t % 10 == 0 || t % 10 + steps > 10 ) print_info("Computing %d-th timestep", t);
 
-        /* Phase 2. Computation of the central planes. */
-        tvel_start = dtime();
+        /* perform IO */
+        if ( t%stacki == 0 && direction == BACKWARD) load_snapshot(store, ntbwd-t, &v);
 
-        velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
-                            nz0 +   HALO,
-                            nzf -   HALO,
-                            nx0 +   HALO,
-                            nxf -   HALO,
-                            ny0 + 2*HALO,
-                            nyf - 2*HALO,
-                            dimmz, dimmx,
-                            TWO);
+        tglobal_start = dtime();
 
+        /* wait read_snapshot H2D copies */
 #if defined(_OPENACC)
-        #pragma acc wait(ONE_L, ONE_R, TWO)
-#endif
-        tvel_total += (dtime() - tvel_start);
-
-        /* ------------------------------------------------------------------------------ */
-        /*                        STRESS COMPUTATION                                      */
-        /* ------------------------------------------------------------------------------ */
-
-        /* Phase 1. Computation of the left-most planes of the domain */
-        stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
-                          nz0 +   HALO,
-                          nzf -   HALO,
-                          nx0 +   HALO,
-                          nxf -   HALO,
-                          ny0 +   HALO,
-                          ny0 + 2*HALO,
-                          dimmz, dimmx,
-                          ONE_L);
-
-        /* Phase 1. Computation of the right-most planes of the domain */
-        stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
-                          nz0 +   HALO,
-                          nzf -   HALO,
-                          nx0 +   HALO,
-                          nxf -   HALO,
-                          nyf - 2*HALO,
-                          nyf -   HALO,
-                          dimmz, dimmx,
-                          ONE_R);
-
-#if defined(USE_MPI)
-        /* Boundary exchange for stress values */
-        exchange_stress_boundaries( s, dimmz * dimmx, nyf, ny0);
+        #pragma acc wait(H2D) if ( (t%stacki == 0 && direction == BACKWARD) || t==0 )
 #endif
 
-        /* Phase 2 computation. Central planes of the domain */
-        tstress_start = dtime();
-
-        stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
-                          nz0 +   HALO,
-                          nzf -   HALO,
-                          nx0 +   HALO,
-                          nxf -   HALO,
-                          ny0 + 2*HALO,
-                          nyf - 2*HALO,
-                          dimmz, dimmx,
-                          TWO);
-
-#if defined(_OPENACC)
-        #pragma acc wait(ONE_L, ONE_R, TWO, H2D, D2H)
-#endif
-        tstress_total += (dtime() - tstress_start);
+        if ( steps > 1 )
+        {
+            /* the block spans the same volume as phases ONE_L, TWO and ONE_R together */
+            propagate_time_block(v, s, coeffs, rho, steps, dt, dzi, dxi, dyi,
+                                 nz0 + HALO, nzf - HALO,
+                                 nx0 + HALO, nxf - HALO,
+                                 ny0 + HALO, nyf - HALO,
+                                 time_tile, dimmz, dimmx);
+        }
+        else
+        {
+            time_step(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                      nz0, nzf, nx0, nxf, ny0, nyf,
+                      dimmz, dimmx, halo, &tvel_total, &tstress_total);
+        }
 
         tglobal_total += (dtime() - tglobal_start);
 
         /* perform IO */
-        if ( t%stacki == 0 && direction == FORWARD) write_snapshot(folder, ntbwd-t, &v, dimmz, dimmx, dimmy);
+        if ( (t+steps-1)%stacki == 0 && direction == FORWARD) store_snapshot(store, ntbwd-(t+steps-1), &v, &s);
 
-#if defined(USE_MPI)
-        MPI_Barrier( MPI_COMM_WORLD );
-#endif
         POP_RANGE
     }
 
+    /* the backward pass reads what the writer still holds */
+    if ( store ) flush_snapshot_store( store );
+
     /* compute some statistics */
     double megacells = ((nzf - nz0) * (nxf - nx0) * (nyf - ny0)) / 1e6;
     tglobal_total /= (double) timesteps;
@@ -975,191 +1803,285 @@ void propagate_shot(time_d        direction,
     tvel_total    /= (double) timesteps;
 
     print_stats("Maingrid GLOBAL   computation took %lf seconds - %lf Mcells/s", tglobal_total, (2*megacells) / tglobal_total);
-    print_stats("Maingrid STRESS   computation took %lf seconds - %lf Mcells/s", tstress_total,  megacells / tstress_total);
-    print_stats("Maingrid VELOCITY computation took %lf seconds - %lf Mcells/s", tvel_total, megacells / tvel_total);
+
+    /* temporally blocked steps are not split into velocity and stress times */
+    if ( time_block == 1 )
+    {
+        print_stats("Maingrid STRESS   computation took %lf seconds - %lf Mcells/s", tstress_total,  megacells / tstress_total);
+        print_stats("Maingrid VELOCITY computation took %lf seconds - %lf Mcells/s", tvel_total, megacells / tvel_total);
+    }
 
     POP_RANGE
 };
 
 #if defined(USE_MPI)
+/* receive and send, through the two faces normal to each axis, of every field of a phase */
+#define VELOCITY_MESSAGES (2 * 2 * 3 * 12)
+#define STRESS_MESSAGES   (2 * 2 * 3 * 24)
+
+struct halo_exchange_s
+{
+    MPI_Comm     comm;
+    int          split[3];      /* axes with more than one rank */
+
+    /* HALO planes received and sent through each face (2*axis + side) */
+    int          neighbour[6];
+    MPI_Datatype recv_type[6];
+    MPI_Datatype send_type[6];
+
+    int          nvelocity;
+    int          nstress;
+    MPI_Request  velocity[VELOCITY_MESSAGES];
+    MPI_Request  stress[STRESS_MESSAGES];
+
+    /* face of every request */
+    char         velocity_face[VELOCITY_MESSAGES];
+    char         stress_face[STRESS_MESSAGES];
+
+    /* requests started and not waited for yet */
+    MPI_Request *active;
+    char        *active_face;
+    int          nactive;
+
+    /* FWI_HALO_DIAGNOSTICS=waits statistics */
+    double       waited[6];
+    long         waits;
+};
+
 /*
-NAME:exchange_boundaries
-PURPOSE: data exchanges between the boundary layers of the analyzed volume
-
-v                   (in) struct containing velocity arrays (4 points / cell x 3 components / point = 12 arrays)
-plane_size          (in) Number of elements per plane to exchange
-nyf                 (in) final plane to be exchanged
-ny0                 (in) intial plane to be exchanged
-
-RETURN none
-*/
-void exchange_velocity_boundaries ( v_t v,
-                                    const integer plane_size,
-                                    const integer nyf,
-                                    const integer ny0 )
+ * HALO planes normal to 'axis' starting at local plane 'first'. Along the
+ * other split axes they only span the computed cells, so the planes of
+ * different faces never overlap; along the axes that are not split they
+ * span the whole local volume.
+ */
+static MPI_Datatype face_type ( const domain_t *d,
+                                const int       split[3],
+                                const int       axis,
+                                const integer   first )
 {
-    PUSH_RANGE
+    int sizes[3], subsizes[3], starts[3];
 
-    int     rank;          // mpi local rank
-    int     nranks;        // num mpi ranks
+    /* C order: y is the slowest axis, z the contiguous one */
+    for (int a = 0; a < 3; a++)
+    {
+        const int c = 2 - a;
 
-    /* Initialize local variables */
-    MPI_Comm_rank ( MPI_COMM_WORLD, &rank );
-    MPI_Comm_size ( MPI_COMM_WORLD, &nranks );
+        sizes[c]    = d->size[a];
+        subsizes[c] = (a == axis) ? HALO  : split[a] ? d->size[a] - 2*HALO : d->size[a];
+        starts[c]   = (a == axis) ? first : split[a] ? HALO                : 0;
+    }
 
-    const integer num_planes = HALO;
-    const integer nelems     = num_planes * plane_size;
+    MPI_Datatype type;
+    MPI_Type_create_subarray( 3, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &type );
+    MPI_Type_commit( &type );
 
-    const integer left_recv  = ny0;
-    const integer left_send  = ny0+HALO;
+    return type;
+};
 
-    const integer right_recv = nyf-HALO;
-    const integer right_send = nyf-2*HALO;
+/*
+ * Sets up the receive and the send of the HALO boundary planes of every
+ * field through each face with a neighbour. The field index tags the
+ * messages: two ranks only share one face.
+ */
+static int init_boundary_exchange ( halo_exchange_t *halo,
+                                    MPI_Request     *requests,
+                                    char            *faces,
+                                    real            **fields,
+                                    const int       nfields )
+{
+    int count = 0;
 
-    if ( rank != 0 )
+    for (int face = 0; face < 6; face++)
     {
-        // [RANK-1] <---> [RANK] communication
-        EXCHANGE( &v.tl.u[left_send], &v.tl.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tl.v[left_send], &v.tl.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tl.w[left_send], &v.tl.w[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &v.tr.u[left_send], &v.tr.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tr.v[left_send], &v.tr.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tr.w[left_send], &v.tr.w[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &v.bl.u[left_send], &v.bl.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.bl.v[left_send], &v.bl.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.bl.w[left_send], &v.bl.w[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &v.br.u[left_send], &v.br.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.br.v[left_send], &v.br.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.br.w[left_send], &v.br.w[left_recv], rank-1, rank, nelems );
+        if ( halo->neighbour[face] < 0 ) continue;
+
+        for (int f = 0; f < nfields; f++)
+        {
+            real* field = fields[f];
+
+#if defined(_OPENACC)
+            #pragma acc host_data use_device(field)
+#endif
+            {
+                MPI_Recv_init( field, 1, halo->recv_type[face], halo->neighbour[face], f, halo->comm, &requests[count] );
+                MPI_Send_init( field, 1, halo->send_type[face], halo->neighbour[face], f, halo->comm, &requests[count+1] );
+            }
+
+            faces[count++] = (char) face;
+            faces[count++] = (char) face;
+        }
     }
 
-    if ( rank != nranks -1 )  //task to exchange stress boundaries
+    return count;
+};
+
+halo_exchange_t* open_boundary_exchange ( const domain_t *d,
+                                          v_t             v,
+                                          s_t             s )
+{
+    if ( d == NULL || d->ranks[AXIS_Z] * d->ranks[AXIS_X] * d->ranks[AXIS_Y] == 1 ) return NULL;
+
+    halo_exchange_t *halo = (halo_exchange_t*) calloc( 1, sizeof(halo_exchange_t) );
+
+    halo->comm = d->comm;
+
+    for (int axis = 0; axis < 3; axis++)
+        halo->split[axis] = d->ranks[axis] > 1;
+
+    for (int axis = 0; axis < 3; axis++)
     {
-        //                [RANK] <---> [RANK+1] communication
-        EXCHANGE( &v.tl.u[right_send], &v.tl.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tl.v[right_send], &v.tl.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tl.w[right_send], &v.tl.w[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &v.tr.u[right_send], &v.tr.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tr.v[right_send], &v.tr.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tr.w[right_send], &v.tr.w[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &v.bl.u[right_send], &v.bl.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.bl.v[right_send], &v.bl.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.bl.w[right_send], &v.bl.w[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &v.br.u[right_send], &v.br.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.br.v[right_send], &v.br.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.br.w[right_send], &v.br.w[right_recv], rank+1, rank, nelems );
+        const integer n = d->size[axis];
+
+        /* lower face: receive planes [0,HALO), send [HALO,2*HALO); the upper one mirrors it */
+        halo->neighbour[2*axis  ] = d->neighbour[axis][0];
+        halo->neighbour[2*axis+1] = d->neighbour[axis][1];
+        halo->recv_type[2*axis  ] = face_type( d, halo->split, axis, 0          );
+        halo->send_type[2*axis  ] = face_type( d, halo->split, axis, HALO       );
+        halo->recv_type[2*axis+1] = face_type( d, halo->split, axis, n - HALO   );
+        halo->send_type[2*axis+1] = face_type( d, halo->split, axis, n - 2*HALO );
     }
 
+    real* vfields[12];
+    snapshot_fields( &v, vfields );
+
+    real* sfields[24] = {
+        s.tl.zz, s.tl.xz, s.tl.yz, s.tl.xx, s.tl.xy, s.tl.yy,
+        s.tr.zz, s.tr.xz, s.tr.yz, s.tr.xx, s.tr.xy, s.tr.yy,
+        s.bl.zz, s.bl.xz, s.bl.yz, s.bl.xx, s.bl.xy, s.bl.yy,
+        s.br.zz, s.br.xz, s.br.yz, s.br.xx, s.br.xy, s.br.yy
+    };
+
+    halo->nvelocity = init_boundary_exchange( halo, halo->velocity, halo->velocity_face, vfields, 12 );
+    halo->nstress   = init_boundary_exchange( halo, halo->stress,   halo->stress_face,   sfields, 24 );
+
+    print_debug("Boundary exchange: %d velocity and %d stress messages per time step",
+            halo->nvelocity, halo->nstress);
+
+    return halo;
+};
+
+int exchanges_axis ( const halo_exchange_t *halo, const int axis )
+{
+    return halo != NULL && halo->split[axis];
+};
+
+void start_velocity_exchange ( halo_exchange_t *halo )
+{
+    if ( halo == NULL ) return;
+
+    PUSH_RANGE
+
+    MPI_Startall( halo->nvelocity, halo->velocity );
+
+    halo->active      = halo->velocity;
+    halo->active_face = halo->velocity_face;
+    halo->nactive     = halo->nvelocity;
+
     POP_RANGE
 };
 
-/*
-NAME:exchange_stress_boundaries
-PURPOSE: data exchanges between the boundary layers of the analyzed volume
-
-s                   (in) struct containing stress arrays (4 points / cell x 6 components / point = 24 arrays)
-plane_size          (in) Number of elements per plane to exchange
-rank                (in) rank id (CPU id)
-nranks              (in) number of CPUs
-nyf                 (in) final plane to be exchanged
-ny0                 (in) intial plane to be exchanged
-
-RETURN none
-*/
-void exchange_stress_boundaries ( s_t s,
-                                  const integer plane_size,
-                                  const integer nyf,
-                                  const integer ny0 )
+void start_stress_exchange ( halo_exchange_t *halo )
 {
+    if ( halo == NULL ) return;
+
     PUSH_RANGE
 
-    int     rank;          // mpi local rank
-    int     nranks;        // num mpi ranks
+    MPI_Startall( halo->nstress, halo->stress );
 
-    /* Initialize local variables */
-    MPI_Comm_rank ( MPI_COMM_WORLD, &rank );
-    MPI_Comm_size ( MPI_COMM_WORLD, &nranks );
+    halo->active      = halo->stress;
+    halo->active_face = halo->stress_face;
+    halo->nactive     = halo->nstress;
 
-    const integer num_planes = HALO;
-    const integer nelems     = num_planes * plane_size;
+    POP_RANGE
+};
 
-    const integer left_recv  = ny0;
-    const integer left_send  = ny0+HALO;
+void wait_boundary_exchange ( halo_exchange_t *halo )
+{
+    if ( halo == NULL || halo->nactive == 0 ) return;
 
-    const integer right_recv = nyf-HALO;
-    const integer right_send = nyf-2*HALO;
+    PUSH_RANGE
 
-    if ( rank != 0 )
+    if ( halo_diagnostics == HALO_WAIT_TIMES )
     {
-        // [RANK-1] <---> [RANK] communication
-        EXCHANGE( &s.tl.zz[left_send], &s.tl.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.xz[left_send], &s.tl.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.yz[left_send], &s.tl.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.xx[left_send], &s.tl.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.xy[left_send], &s.tl.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.yy[left_send], &s.tl.yy[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &s.tr.zz[left_send], &s.tr.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.xz[left_send], &s.tr.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.yz[left_send], &s.tr.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.xx[left_send], &s.tr.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.xy[left_send], &s.tr.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.yy[left_send], &s.tr.yy[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &s.bl.zz[left_send], &s.bl.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.xz[left_send], &s.bl.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.yz[left_send], &s.bl.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.xx[left_send], &s.bl.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.xy[left_send], &s.bl.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.yy[left_send], &s.bl.yy[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &s.br.zz[left_send], &s.br.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.xz[left_send], &s.br.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.yz[left_send], &s.br.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.xx[left_send], &s.br.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.xy[left_send], &s.br.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.yy[left_send], &s.br.yy[left_recv], rank-1, rank, nelems );
+        /* the time until each message completes is charged to its neighbour */
+        double last = dtime();
+        int    index;
+
+        for (int i = 0; i < halo->nactive; i++)
+        {
+            MPI_Waitany( halo->nactive, halo->active, &index, MPI_STATUS_IGNORE );
+
+            const double now = dtime();
+            halo->waited[ (int) halo->active_face[index] ] += now - last;
+            last = now;
+        }
+
+        halo->waits++;
     }
+    else
+        MPI_Waitall( halo->nactive, halo->active, MPI_STATUSES_IGNORE );
 
-    if ( rank != nranks-1 )
+    halo->nactive = 0;
+
+    POP_RANGE
+};
+
+void close_boundary_exchange ( halo_exchange_t *halo )
+{
+    if ( halo == NULL ) return;
+
+    wait_boundary_exchange( halo );
+
+    if ( halo_diagnostics == HALO_WAIT_TIMES )
     {
-        //                [RANK] <---> [RANK+1] communication
-        EXCHANGE( &s.tl.zz[right_send], &s.tl.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.xz[right_send], &s.tl.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.yz[right_send], &s.tl.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.xx[right_send], &s.tl.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.xy[right_send], &s.tl.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.yy[right_send], &s.tl.yy[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &s.tr.zz[right_send], &s.tr.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.xz[right_send], &s.tr.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.yz[right_send], &s.tr.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.xx[right_send], &s.tr.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.xy[right_send], &s.tr.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.yy[right_send], &s.tr.yy[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &s.bl.zz[right_send], &s.bl.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.xz[right_send], &s.bl.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.yz[right_send], &s.bl.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.xx[right_send], &s.bl.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.xy[right_send], &s.bl.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.yy[right_send], &s.bl.yy[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &s.br.zz[right_send], &s.br.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.xz[right_send], &s.br.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.yz[right_send], &s.br.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.xx[right_send], &s.br.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.xy[right_send], &s.br.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.yy[right_send], &s.br.yy[right_recv], rank+1, rank, nelems );
+        /* the neighbours are ranks of the shot group, the log and snapshot files are named by world rank */
+        MPI_Group group, everyone;
+        MPI_Comm_group( halo->comm, &group );
+        MPI_Comm_group( MPI_COMM_WORLD, &everyone );
+
+        for (int face = 0; face < 6; face++)
+        {
+            if ( halo->neighbour[face] < 0 ) continue;
+
+            int world;
+            MPI_Group_translate_ranks( group, 1, &halo->neighbour[face], everyone, &world );
+
+            print_info("Boundary exchange: waited %lf seconds on rank %d over %ld exchanges (%lf ms per exchange)",
+                    halo->waited[face], world, halo->waits,
+                    1e3 * halo->waited[face] / ((halo->waits > 0) ? halo->waits : 1));
+        }
+
+        MPI_Group_free( &group );
+        MPI_Group_free( &everyone );
     }
 
-    POP_RANGE
+    for (int i = 0; i < halo->nvelocity; i++) MPI_Request_free( &halo->velocity[i] );
+    for (int i = 0; i < halo->nstress;   i++) MPI_Request_free( &halo->stress[i] );
+
+    for (int face = 0; face < 6; face++)
+    {
+        MPI_Type_free( &halo->recv_type[face] );
+        MPI_Type_free( &halo->send_type[face] );
+    }
+
+    free( halo );
+};
+#else
+halo_exchange_t* open_boundary_exchange ( const domain_t *UNUSED(d),
+                                          v_t             UNUSED(v),
+                                          s_t             UNUSED(s) )
+{
+    return NULL;
+};
+
+int exchanges_axis ( const halo_exchange_t *UNUSED(halo), const int UNUSED(axis) )
+{
+    return 0;
 };
+
+void start_velocity_exchange ( halo_exchange_t *UNUSED(halo) ) {};
+void start_stress_exchange   ( halo_exchange_t *UNUSED(halo) ) {};
+void wait_boundary_exchange  ( halo_exchange_t *UNUSED(halo) ) {};
+void close_boundary_exchange ( halo_exchange_t *UNUSED(halo) ) {};
 #endif /* end of pragma USE_MPI */
 
@@ -29,6 +29,261 @@
 
 #include "fwi/fwi_propagator.h"
 
+#if defined(_OPENMP)
+    #define OMP_PARALLEL_FOR _Pragma("omp parallel for")
+#else
+    #define OMP_PARALLEL_FOR
+#endif
+
+engine_t     velocity_engine  = SPLIT_ENGINE;
+engine_t     stress_engine    = SPLIT_ENGINE;
+cache_mode_t coeff_cache_mode = NO_CACHE;
+simd_isa_t   simd_isa         = SIMD_NONE;
+tiling_t     tiling_mode      = NO_TILING;
+tile_t       propagator_tile  = {0, 0, 0};
+integer      time_block_steps = 1;
+
+static engine_t parse_engine (const char* varname)
+{
+    const char* name = read_env_variable_or_default( varname, "split" );
+
+    if ( strcmp( name, "fused" ) == 0 ) return FUSED_ENGINE;
+    if ( strcmp( name, "split" ) == 0 ) return SPLIT_ENGINE;
+
+    print_error("Unknown engine '%s' in %s, using 'split'", name, varname);
+    return SPLIT_ENGINE;
+};
+
+static cache_mode_t parse_cache_mode (const char* varname)
+{
+    const char* name = read_env_variable_or_default( varname, "none" );
+
+    if ( strcmp( name, "none" ) == 0 ) return NO_CACHE;
+    if ( strcmp( name, "rho"  ) == 0 ) return RHO_CACHE;
+    if ( strcmp( name, "full" ) == 0 ) return FULL_CACHE;
+
+    print_error("Unknown cache mode '%s' in %s, using 'none'", name, varname);
+    return NO_CACHE;
+};
+
+/*
+ * Widest instruction set supported by both the build and the running CPU.
+ */
+simd_isa_t detect_simd_isa (void)
+{
+#if defined(USE_SIMD_KERNELS)
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("avx512f") ) return SIMD_AVX512;
+    if ( __builtin_cpu_supports("avx2")    ) return SIMD_AVX2;
+#endif
+    return SIMD_NONE;
+};
+
+static simd_isa_t parse_simd_isa (const char* varname)
+{
+    const char* name     = read_env_variable_or_default( varname, "auto" );
+    const simd_isa_t cpu = detect_simd_isa();
+    simd_isa_t isa       = cpu;
+
+    if      ( strcmp( name, "none"   ) == 0 ) isa = SIMD_NONE;
+    else if ( strcmp( name, "avx2"   ) == 0 ) isa = SIMD_AVX2;
+    else if ( strcmp( name, "avx512" ) == 0 ) isa = SIMD_AVX512;
+    else if ( strcmp( name, "auto"   ) != 0 )
+        print_error("Unknown instruction set '%s' in %s, using 'auto'", name, varname);
+
+    if ( isa > cpu )
+    {
+        print_info("Instruction set '%s' not available, using the widest supported one", name);
+        isa = cpu;
+    }
+
+    return isa;
+};
+
+static tiling_t parse_tiling (const char* varname, tile_t* tile)
+{
+    const char* name = read_env_variable_or_default( varname, "none" );
+
+    if ( strcmp( name, "none" ) == 0 ) return NO_TILING;
+    if ( strcmp( name, "auto" ) == 0 ) return AUTO_TILING;
+
+    tile->y = 0;
+    if ( sscanf( name, I "x" I "x" I, &tile->z, &tile->x, &tile->y ) >= 2 &&
+         tile->z > 0 && tile->x > 0 && tile->y >= 0 )
+        return FIXED_TILING;
+
+    print_error("Unknown tile size '%s' in %s, using 'none'", name, varname);
+    return NO_TILING;
+};
+
+/*
+ * Size of the cache private to each core (L2), 1 MiB when unknown.
+ */
+size_t cache_size_per_core (void)
+{
+    long bytes = 0;
+
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+    bytes = sysconf( _SC_LEVEL2_CACHE_SIZE );
+#endif
+
+    return (bytes > 0) ? (size_t) bytes : (size_t) 1 << 20;
+};
+
+/* arrays read through stencil_Y by a fused engine, and the remaining ones */
+#define TILE_STENCIL_STREAMS 12
+#define TILE_PLAIN_STREAMS   36
+#define TILE_MIN_COLUMNS      4
+#define TILE_Z_QUANTUM       16
+
+/*
+ * Tile that keeps the working set of the fused engines in half of
+ * 'cache_bytes'. Tiles sweep the whole y range, so the 2*HALO+1 planes
+ * touched by stencil_Y must stay resident for every array read along y.
+ * Whole z-columns are kept while TILE_MIN_COLUMNS of them fit, otherwise
+ * z is split into even blocks rounded to TILE_Z_QUANTUM cells, so the
+ * vector kernels do not fall into their scalar remainder.
+ */
+tile_t auto_tile_size (const integer nz,
+                       const integer nx,
+                       const size_t  cache_bytes)
+{
+    const size_t  cell_bytes = (TILE_STENCIL_STREAMS * (2*HALO+1) + TILE_PLAIN_STREAMS) * sizeof(real);
+    const integer cells      = max_int( (cache_bytes / 2) / cell_bytes, TILE_Z_QUANTUM );
+
+    tile_t tile = {nz, 1, 0};
+
+    if ( nz * TILE_MIN_COLUMNS > cells )
+    {
+        const integer blocks = (nz * TILE_MIN_COLUMNS + cells - 1) / cells;
+        tile.z = roundup( (nz + blocks - 1) / blocks, TILE_Z_QUANTUM );
+    }
+
+    tile.x = max_int( cells / tile.z, 1 );
+    if ( tile.x > nx ) tile.x = nx;
+
+    return tile;
+};
+
+static integer parse_time_block (const char* varname)
+{
+    const char* name = read_env_variable_or_default( varname, "1" );
+    const integer steps = atoi( name );
+
+    if ( steps >= 1 ) return steps;
+
+    print_error("Invalid number of time steps per block '%s' in %s, using 1", name, varname);
+    return 1;
+};
+
+/*
+ * Share of the last level cache that corresponds to each thread.
+ */
+size_t cache_size_per_thread (void)
+{
+    long bytes = 0;
+
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+    bytes = sysconf( _SC_LEVEL3_CACHE_SIZE );
+#endif
+
+    if ( bytes <= 0 ) return cache_size_per_core();
+
+#if defined(_OPENMP)
+    bytes /= omp_get_max_threads();
+#endif
+
+    return ( (size_t) bytes > cache_size_per_core() ) ? (size_t) bytes : cache_size_per_core();
+};
+
+/* arrays touched by a full time step: 12 velocities, 24 stresses, 21 coefficients and rho */
+#define TIME_TILE_STREAMS    58
+
+/*
+ * Tile (in skewed coordinates) for blocks of 'steps' time steps. Along each
+ * axis a tile spans its extent plus the skew of the last half step, and
+ * that footprint of every array must fit in half of 'cache_bytes'. Tiles
+ * are cubes of multiples of TILE_Z_QUANTUM cells, clamped to the domain.
+ */
+tile_t auto_time_tile_size (const integer nz,
+                            const integer nx,
+                            const integer ny,
+                            const integer steps,
+                            const size_t  cache_bytes)
+{
+    const size_t  cell_bytes = TIME_TILE_STREAMS * sizeof(real);
+    const size_t  cells      = (cache_bytes / 2) / cell_bytes;
+    const integer skew       = HALO * (2 * steps - 1);
+
+    integer side = TILE_Z_QUANTUM;
+
+    for (integer next = 2 * TILE_Z_QUANTUM; ; next += TILE_Z_QUANTUM)
+    {
+        const size_t extent = next + skew;
+        if ( extent * extent * extent > cells ) break;
+        side = next;
+    }
+
+    tile_t tile = {side, side, side};
+
+    if ( tile.z > nz ) tile.z = nz;
+    if ( tile.x > nx ) tile.x = nx;
+    if ( tile.y > ny ) tile.y = ny;
+
+    return tile;
+};
+
+/*
+ * Selects the propagator engines from the FWI_VELOCITY_ENGINE and
+ * FWI_STRESS_ENGINE env. variables ("split" or "fused"). Fused engines
+ * are CPU only, accelerator builds always use the split kernels.
+ * FWI_COEFF_CACHE ("none", "rho" or "full") sets which cell averages
+ * the fused engines read from a precomputed cache, FWI_SIMD_ISA
+ * ("auto", "avx512", "avx2" or "none") their vector instruction set and
+ * FWI_TILE ("none", "auto" or "ZxX[xY]" cells) their cache blocking.
+ * FWI_TIME_BLOCK sets how many time steps propagate_shot advances per
+ * temporal block (1 disables temporal blocking).
+ */
+void select_propagator_engines (void)
+{
+#if defined(_OPENACC) || defined(USE_CUDA)
+    velocity_engine  = SPLIT_ENGINE;
+    stress_engine    = SPLIT_ENGINE;
+    coeff_cache_mode = NO_CACHE;
+    time_block_steps = 1;
+#else
+    velocity_engine  = parse_engine( "FWI_VELOCITY_ENGINE" );
+    stress_engine    = parse_engine( "FWI_STRESS_ENGINE"   );
+    coeff_cache_mode = parse_cache_mode( "FWI_COEFF_CACHE" );
+    simd_isa         = parse_simd_isa  ( "FWI_SIMD_ISA"    );
+    tiling_mode      = parse_tiling    ( "FWI_TILE", &propagator_tile );
+    time_block_steps = parse_time_block( "FWI_TIME_BLOCK" );
+#endif
+
+    if ( coeff_cache_mode != NO_CACHE &&
+         velocity_engine == SPLIT_ENGINE && stress_engine == SPLIT_ENGINE )
+    {
+        print_info("Coefficient cache is only used by fused engines, disabling it");
+        coeff_cache_mode = NO_CACHE;
+    }
+
+    print_info("Velocity engine: %s", (velocity_engine == FUSED_ENGINE) ? "fused" : "split");
+    print_info("Stress engine: %s"  , (stress_engine   == FUSED_ENGINE) ? "fused" : "split");
+    print_info("Coefficient cache: %s", (coeff_cache_mode == FULL_CACHE) ? "full" :
+                                        (coeff_cache_mode == RHO_CACHE ) ? "rho"  : "none");
+    print_info("Fused engines instruction set: %s", (simd_isa == SIMD_AVX512) ? "avx512" :
+                                                    (simd_isa == SIMD_AVX2  ) ? "avx2"   : "none");
+
+    if ( tiling_mode == FIXED_TILING )
+        print_info("Fused engines tiles: "I"x"I"x"I" cells (0 = whole range)",
+                propagator_tile.z, propagator_tile.x, propagator_tile.y);
+    else
+        print_info("Fused engines tiles: %s", (tiling_mode == AUTO_TILING) ? "auto" : "none");
+
+    print_info("Time steps per temporal block: "I, time_block_steps);
+};
+
 inline
 integer IDX (const integer z,
              const integer x,
@@ -424,6 +679,42 @@ void compute_component_vcell_BL (      real* restrict vptr,
 #endif /* end USE_CUDA */
 };
 
+typedef void (*velocity_column_t) (v_t, s_t, coeff_t, const real*,
+                                   const real, const real, const real, const real,
+                                   const integer, const integer, const integer, const integer,
+                                   const integer, const integer);
+
+typedef void (*stress_column_t) (s_t, v_t, coeff_t,
+                                 const real, const real, const real, const real,
+                                 const integer, const integer, const integer, const integer,
+                                 const integer, const integer);
+
+/*
+ * Tile extents of the fused engines for a nz*nx*ny iteration space.
+ * Without tiling every y-plane is a tile, i.e. the classic traversal.
+ */
+static tile_t traversal_tile (const integer nz,
+                              const integer nx,
+                              const integer ny)
+{
+    tile_t tile = {nz, nx, 1};
+
+    if ( tiling_mode == AUTO_TILING )
+        tile = auto_tile_size( nz, nx, cache_size_per_core() );
+    else if ( tiling_mode == FIXED_TILING )
+        tile = propagator_tile;
+
+    if ( tile.z <= 0 || tile.z > nz ) tile.z = nz;
+    if ( tile.x <= 0 || tile.x > nx ) tile.x = nx;
+    if ( tile.y <= 0 || tile.y > ny ) tile.y = ny;
+
+    return tile;
+};
+
+/* first and last+1 cells of tile 't' along an axis that starts at 'n0' */
+#define TILE_BEGIN(n0, t, size)      ((n0) + (t) * (size))
+#define TILE_END(n0, t, size, nf)    (((n0) + ((t)+1) * (size) < (nf)) ? (n0) + ((t)+1) * (size) : (nf))
+
 void velocity_propagator(v_t           v,
                          s_t           s,
                          coeff_t       coeffs,
@@ -446,6 +737,14 @@ void velocity_propagator(v_t           v,
     fprintf(stderr, "Integration limits of %s are (z "I"-"I",x "I"-"I",y "I"-"I")\n", __FUNCTION__, nz0,nzf,nx0,nxf,ny0,nyf);
 #endif
 
+    if ( velocity_engine == FUSED_ENGINE )
+    {
+        velocity_propagator_fused(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                                  nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, phase);
+        return;
+    }
+
+#if defined(_OPENACC) || defined(USE_CUDA)
 #if defined(__INTEL_COMPILER)
     #pragma forceinline recursive
 #endif
@@ -463,6 +762,276 @@ void velocity_propagator(v_t           v,
         compute_component_vcell_BL (v.bl.v, s.tl.yz, s.br.xy, s.bl.yy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, forw_offset, back_offset, back_offset, dimmz, dimmx, phase);
         compute_component_vcell_BR (v.br.v, s.tr.yz, s.bl.xy, s.br.yy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, forw_offset, forw_offset, forw_offset, dimmz, dimmx, phase);
     }
+#else
+    {
+        compute_component_vcell_TL_spec (v.tl.w, s.bl.zz, s.tr.xz, s.tl.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_TR_spec (v.tr.w, s.br.zz, s.tl.xz, s.tr.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BL_spec (v.bl.w, s.tl.zz, s.br.xz, s.bl.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BR_spec (v.br.w, s.tr.zz, s.bl.xz, s.br.yz, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_TL_spec (v.tl.u, s.bl.xz, s.tr.xx, s.tl.xy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_TR_spec (v.tr.u, s.br.xz, s.tl.xx, s.tr.xy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BL_spec (v.bl.u, s.tl.xz, s.br.xx, s.bl.xy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BR_spec (v.br.u, s.tr.xz, s.bl.xx, s.br.xy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_TL_spec (v.tl.v, s.bl.yz, s.tr.xy, s.tl.yy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_TR_spec (v.tr.v, s.br.yz, s.tl.xy, s.tr.yy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BL_spec (v.bl.v, s.tl.yz, s.br.xy, s.bl.yy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_vcell_BR_spec (v.br.v, s.tr.yz, s.bl.xy, s.br.yy, rho, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+    }
+#endif
+};
+
+/*
+ * Strided counterpart of stencil_Z/X/Y for the host kernels: 'i' is the
+ * linear index of the cell, already hoisted out of the IDX() arithmetic,
+ * and 'stride' the distance between two neighbours along the derivative
+ * axis (1, dimmz or dimmz*dimmx). Same expression, same rounding.
+ */
+static inline
+real stencil_at (const real* restrict ptr,
+                 const integer        i,
+                 const integer        off,
+                 const integer        stride,
+                 const real           di)
+{
+    const real* restrict p = ptr + i + off * stride;
+
+    return ((C0 * ( p[0       ] - p[ -stride  ]) +
+             C1 * ( p[ stride ] - p[ -2*stride]) +
+             C2 * ( p[2*stride] - p[ -3*stride]) +
+             C3 * ( p[3*stride] - p[ -4*stride])) * di );
+};
+
+static inline
+real rho_TL_at (const real* restrict rho, const integer i, const integer dimmz, const integer plane)
+{
+    return (2.0f / (rho[i] + rho[i + plane]));
+};
+
+static inline
+real rho_TR_at (const real* restrict rho, const integer i, const integer dimmz, const integer plane)
+{
+    return (2.0f / (rho[i] + rho[i + dimmz]));
+};
+
+static inline
+real rho_BL_at (const real* restrict rho, const integer i, const integer dimmz, const integer plane)
+{
+    return (2.0f / (rho[i] + rho[i + 1]));
+};
+
+static inline
+real rho_BR_at (const real* restrict rho, const integer i, const integer dimmz, const integer plane)
+{
+    return ( 8.0f/ ( rho[i                  ] +
+                     rho[i + 1              ] +
+                     rho[i     + dimmz      ] +
+                     rho[i             + plane] +
+                     rho[i     + dimmz + plane] +
+                     rho[i + 1 + dimmz      ] +
+                     rho[i + 1         + plane] +
+                     rho[i + 1 + dimmz + plane]) );
+};
+
+static inline
+void vcell_update (      real* restrict vptr,
+                   const real* restrict szptr,
+                   const real* restrict sxptr,
+                   const real* restrict syptr,
+                   const real           lrho,
+                   const real           dt,
+                   const real           dzi,
+                   const real           dxi,
+                   const real           dyi,
+                   const integer        i,
+                   const offset_t       _SZ,
+                   const offset_t       _SX,
+                   const offset_t       _SY,
+                   const integer        dimmz,
+                   const integer        plane)
+{
+    const real stx  = stencil_at( sxptr, i, _SX, dimmz, dxi);
+    const real sty  = stencil_at( syptr, i, _SY, plane, dyi);
+    const real stz  = stencil_at( szptr, i, _SZ, 1    , dzi);
+
+    vptr[i] += (stx  + sty  + stz) * dt * lrho;
+};
+
+/*
+ * Specialised host kernels, see DECLARE_VCELL_SPEC. Same loop nest and
+ * expressions as compute_component_vcell_*, with the offsets fixed and
+ * the index arithmetic hoisted to one base index per column.
+ */
+#define DEFINE_VCELL_SPEC(CELL, _SZ, _SX, _SY)                                       \
+void compute_component_vcell_##CELL##_spec (      real* restrict vptr,               \
+                                            const real* restrict szptr,              \
+                                            const real* restrict sxptr,              \
+                                            const real* restrict syptr,              \
+                                            const real* restrict rho,                \
+                                            const real           dt,                 \
+                                            const real           dzi,                \
+                                            const real           dxi,                \
+                                            const real           dyi,                \
+                                            const integer        nz0,                \
+                                            const integer        nzf,                \
+                                            const integer        nx0,                \
+                                            const integer        nxf,                \
+                                            const integer        ny0,                \
+                                            const integer        nyf,                \
+                                            const integer        dimmz,              \
+                                            const integer        dimmx)              \
+{                                                                                    \
+    const integer plane = dimmz * dimmx;                                             \
+                                                                                     \
+    OMP_PARALLEL_FOR                                                                 \
+    for(integer y=ny0; y < nyf; y++)                                                 \
+        for(integer x=nx0; x < nxf; x++)                                             \
+        {                                                                            \
+            const integer col = IDX(0, x, y, dimmz, dimmx);                          \
+                                                                                     \
+            for(integer z=nz0; z < nzf; z++)                                         \
+                vcell_update(vptr, szptr, sxptr, syptr,                              \
+                             rho_##CELL##_at(rho, col + z, dimmz, plane),            \
+                             dt, dzi, dxi, dyi, col + z, _SZ, _SX, _SY, dimmz, plane); \
+        }                                                                            \
+};
+
+DEFINE_VCELL_SPEC(TL, back_offset, back_offset, forw_offset)
+DEFINE_VCELL_SPEC(TR, back_offset, forw_offset, back_offset)
+DEFINE_VCELL_SPEC(BL, forw_offset, back_offset, back_offset)
+DEFINE_VCELL_SPEC(BR, forw_offset, forw_offset, forw_offset)
+
+/*
+ * Updates the twelve velocity components of the (y,x) column between nz0
+ * and nzf. Inverse densities come from coeffs.cache when available.
+ */
+void velocity_fused_column(v_t           v,
+                           s_t           s,
+                           coeff_t       coeffs,
+                           const real*   rho,
+                           const real    dt,
+                           const real    dzi,
+                           const real    dxi,
+                           const real    dyi,
+                           const integer nz0,
+                           const integer nzf,
+                           const integer x,
+                           const integer y,
+                           const integer dimmz,
+                           const integer dimmx)
+{
+    const coeff_cache_t* cache = (coeffs.cache && coeffs.cache->rho_tl) ? coeffs.cache : NULL;
+    const integer plane = dimmz * dimmx;
+    const integer col   = IDX(0, x, y, dimmz, dimmx);
+
+#if defined(__INTEL_COMPILER)
+    #pragma simd
+#endif
+    for(integer z=nz0; z < nzf; z++)
+    {
+        const integer i = col + z;
+
+        const real lrho_tl = (cache) ? cache->rho_tl[i] : rho_TL_at(rho, i, dimmz, plane);
+        const real lrho_tr = (cache) ? cache->rho_tr[i] : rho_TR_at(rho, i, dimmz, plane);
+        const real lrho_bl = (cache) ? cache->rho_bl[i] : rho_BL_at(rho, i, dimmz, plane);
+        const real lrho_br = (cache) ? cache->rho_br[i] : rho_BR_at(rho, i, dimmz, plane);
+
+        vcell_update(v.tl.w, s.bl.zz, s.tr.xz, s.tl.yz, lrho_tl, dt, dzi, dxi, dyi, i, back_offset, back_offset, forw_offset, dimmz, plane);
+        vcell_update(v.tr.w, s.br.zz, s.tl.xz, s.tr.yz, lrho_tr, dt, dzi, dxi, dyi, i, back_offset, forw_offset, back_offset, dimmz, plane);
+        vcell_update(v.bl.w, s.tl.zz, s.br.xz, s.bl.yz, lrho_bl, dt, dzi, dxi, dyi, i, forw_offset, back_offset, back_offset, dimmz, plane);
+        vcell_update(v.br.w, s.tr.zz, s.bl.xz, s.br.yz, lrho_br, dt, dzi, dxi, dyi, i, forw_offset, forw_offset, forw_offset, dimmz, plane);
+        vcell_update(v.tl.u, s.bl.xz, s.tr.xx, s.tl.xy, lrho_tl, dt, dzi, dxi, dyi, i, back_offset, back_offset, forw_offset, dimmz, plane);
+        vcell_update(v.tr.u, s.br.xz, s.tl.xx, s.tr.xy, lrho_tr, dt, dzi, dxi, dyi, i, back_offset, forw_offset, back_offset, dimmz, plane);
+        vcell_update(v.bl.u, s.tl.xz, s.br.xx, s.bl.xy, lrho_bl, dt, dzi, dxi, dyi, i, forw_offset, back_offset, back_offset, dimmz, plane);
+        vcell_update(v.br.u, s.tr.xz, s.bl.xx, s.br.xy, lrho_br, dt, dzi, dxi, dyi, i, forw_offset, forw_offset, forw_offset, dimmz, plane);
+        vcell_update(v.tl.v, s.bl.yz, s.tr.xy, s.tl.yy, lrho_tl, dt, dzi, dxi, dyi, i, back_offset, back_offset, forw_offset, dimmz, plane);
+        vcell_update(v.tr.v, s.br.yz, s.tl.xy, s.tr.yy, lrho_tr, dt, dzi, dxi, dyi, i, back_offset, forw_offset, back_offset, dimmz, plane);
+        vcell_update(v.bl.v, s.tl.yz, s.br.xy, s.bl.yy, lrho_bl, dt, dzi, dxi, dyi, i, forw_offset, back_offset, back_offset, dimmz, plane);
+        vcell_update(v.br.v, s.tr.yz, s.bl.xy, s.br.yy, lrho_br, dt, dzi, dxi, dyi, i, forw_offset, forw_offset, forw_offset, dimmz, plane);
+    }
+};
+
+/*
+ * Sequential update of the velocities of the box [nz0,nzf)x[nx0,nxf)x[ny0,nyf)
+ * with the fused column kernels of the selected instruction set.
+ */
+void velocity_fused_block(v_t           v,
+                          s_t           s,
+                          coeff_t       coeffs,
+                          const real*   rho,
+                          const real    dt,
+                          const real    dzi,
+                          const real    dxi,
+                          const real    dyi,
+                          const integer nz0,
+                          const integer nzf,
+                          const integer nx0,
+                          const integer nxf,
+                          const integer ny0,
+                          const integer nyf,
+                          const integer dimmz,
+                          const integer dimmx)
+{
+    velocity_column_t column = velocity_fused_column;
+
+#if defined(USE_SIMD_KERNELS)
+    if ( simd_isa == SIMD_AVX512 ) column = velocity_fused_column_avx512;
+    if ( simd_isa == SIMD_AVX2   ) column = velocity_fused_column_avx2;
+#endif
+
+    for (integer y = ny0; y < nyf; y++)
+        for (integer x = nx0; x < nxf; x++)
+            column(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                   nz0, nzf, x, y, dimmz, dimmx);
+};
+
+/*
+ * Single sweep version of velocity_propagator: every cell updates the
+ * u, v and w components of the four staggered points, so rho and the
+ * stress neighbourhoods are streamed once per phase instead of twelve
+ * times. Same expressions and offsets as the split kernels, hence the
+ * results are bit-identical. Columns are visited tile by tile, see
+ * traversal_tile.
+ */
+void velocity_propagator_fused(v_t           v,
+                               s_t           s,
+                               coeff_t       coeffs,
+                               real*         rho,
+                               const real    dt,
+                               const real    dzi,
+                               const real    dxi,
+                               const real    dyi,
+                               const integer nz0,
+                               const integer nzf,
+                               const integer nx0,
+                               const integer nxf,
+                               const integer ny0,
+                               const integer nyf,
+                               const integer dimmz,
+                               const integer dimmx,
+                               const phase_t UNUSED(phase))
+{
+    if ( nzf <= nz0 || nxf <= nx0 || nyf <= ny0 ) return;
+
+    const tile_t  tile = traversal_tile( nzf-nz0, nxf-nx0, nyf-ny0 );
+    const integer ntz  = (nzf - nz0 + tile.z - 1) / tile.z;
+    const integer ntx  = (nxf - nx0 + tile.x - 1) / tile.x;
+    const integer nty  = (nyf - ny0 + tile.y - 1) / tile.y;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+    for (integer t = 0; t < ntz * ntx * nty; t++)
+    {
+        const integer tz = t % ntz;
+        const integer tx = (t / ntz) % ntx;
+        const integer ty = t / (ntz * ntx);
+
+        velocity_fused_block(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                TILE_BEGIN(nz0, tz, tile.z), TILE_END(nz0, tz, tile.z, nzf),
+                TILE_BEGIN(nx0, tx, tile.x), TILE_END(nx0, tx, tile.x, nxf),
+                TILE_BEGIN(ny0, ty, tile.y), TILE_END(ny0, ty, tile.y, nyf),
+                dimmz, dimmx);
+    }
 };
 
 
@@ -529,6 +1098,14 @@ void stress_propagator(s_t           s,
     fprintf(stderr, "Integration limits of %s are (z "I"-"I",x "I"-"I",y "I"-"I")\n", __FUNCTION__, nz0,nzf,nx0,nxf,ny0,nyf);
 #endif
 
+    if ( stress_engine == FUSED_ENGINE )
+    {
+        stress_propagator_fused(s, v, coeffs, rho, dt, dzi, dxi, dyi,
+                                nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx, phase);
+        return;
+    }
+
+#if defined(_OPENACC) || defined(USE_CUDA)
 #if defined(__INTEL_COMPILER)
     #pragma forceinline recursive
 #endif
@@ -538,6 +1115,14 @@ void stress_propagator(s_t           s,
         compute_component_scell_TR ( s, v.br, v.tl, v.tr, coeffs, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, back_offset, forw_offset, forw_offset, dimmz, dimmx, phase);
         compute_component_scell_TL ( s, v.bl, v.tr, v.tl, coeffs, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, back_offset, back_offset, back_offset, dimmz, dimmx, phase);
     }
+#else
+    {
+        compute_component_scell_BR_spec ( s, v.tr, v.bl, v.br, coeffs, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_scell_BL_spec ( s, v.tl, v.br, v.bl, coeffs, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_scell_TR_spec ( s, v.br, v.tl, v.tr, coeffs, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+        compute_component_scell_TL_spec ( s, v.bl, v.tr, v.tl, coeffs, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf, ny0, nyf, dimmz, dimmx);
+    }
+#endif
 };
 
 real cell_coeff_BR ( const real* restrict ptr,
@@ -1275,3 +1860,300 @@ void compute_component_scell_BL (s_t             s,
     }
 #endif /* end USE_CUDA */
 };
+
+/*
+ * Strided counterpart of cell_coeff_* (COEFF_AVERAGE) and cell_coeff_ARTM_*
+ * (COEFF_ARTM). Averages run over i, i+s1, i+s2 and i+s1+s2, in the same
+ * order as the IDX() versions; s1 == 0 stands for TL cells, which are not
+ * averaged. COEFF_CACHED reads a coefficient averaged by build_coeff_cache.
+ */
+static inline
+real cell_coeff_at (const real* restrict ptr,
+                    const integer        i,
+                    const coeff_kind_t   kind,
+                    const integer        s1,
+                    const integer        s2)
+{
+    if ( kind == COEFF_CACHED ) return ptr[i];
+
+    if ( s1 == 0 ) return ( 1.0f / ptr[i] );
+
+    if ( kind == COEFF_AVERAGE )
+        return ( 1.0f / ( 2.5f * (ptr[i          ] +
+                                  ptr[i + s1     ] +
+                                  ptr[i      + s2] +
+                                  ptr[i + s1 + s2])) );
+
+    return ((1.0f / ptr[i          ]  +
+             1.0f / ptr[i + s1     ]  +
+             1.0f / ptr[i      + s2]  +
+             1.0f / ptr[i + s1 + s2]) * 0.25f);
+};
+
+static inline
+void stress_update_at (      real* restrict sptr,
+                       const real           c1,
+                       const real           c2,
+                       const real           c3,
+                       const real           c4,
+                       const real           c5,
+                       const real           c6,
+                       const integer        i,
+                       const real           dt,
+                       const real           u_x,
+                       const real           u_y,
+                       const real           u_z,
+                       const real           v_x,
+                       const real           v_y,
+                       const real           v_z,
+                       const real           w_x,
+                       const real           w_y,
+                       const real           w_z)
+{
+    real accum  = dt * c1 * u_x;
+         accum += dt * c2 * v_y;
+         accum += dt * c3 * w_z;
+         accum += dt * c4 * (w_y + v_z);
+         accum += dt * c5 * (w_x + u_z);
+         accum += dt * c6 * (v_x + u_y);
+    sptr[i] += accum;
+};
+
+static inline
+void scell_update ( point_s_t          sp,
+                    point_v_t          vnode_z,
+                    point_v_t          vnode_x,
+                    point_v_t          vnode_y,
+                    coeff_t            cc,
+                    const coeff_kind_t kind,
+                    const coeff_kind_t kind_ARTM,
+                    const integer      s1,
+                    const integer      s2,
+                    const real         dt,
+                    const real         dzi,
+                    const real         dxi,
+                    const real         dyi,
+                    const integer      i,
+                    const offset_t     _SZ,
+                    const offset_t     _SX,
+                    const offset_t     _SY,
+                    const integer      dimmz,
+                    const integer      plane)
+{
+    const real c11 = cell_coeff_at (cc.c11, i, kind     , s1, s2);
+    const real c12 = cell_coeff_at (cc.c12, i, kind     , s1, s2);
+    const real c13 = cell_coeff_at (cc.c13, i, kind     , s1, s2);
+    const real c14 = cell_coeff_at (cc.c14, i, kind_ARTM, s1, s2);
+    const real c15 = cell_coeff_at (cc.c15, i, kind_ARTM, s1, s2);
+    const real c16 = cell_coeff_at (cc.c16, i, kind_ARTM, s1, s2);
+    const real c22 = cell_coeff_at (cc.c22, i, kind     , s1, s2);
+    const real c23 = cell_coeff_at (cc.c23, i, kind     , s1, s2);
+    const real c24 = cell_coeff_at (cc.c24, i, kind_ARTM, s1, s2);
+    const real c25 = cell_coeff_at (cc.c25, i, kind_ARTM, s1, s2);
+    const real c26 = cell_coeff_at (cc.c26, i, kind_ARTM, s1, s2);
+    const real c33 = cell_coeff_at (cc.c33, i, kind     , s1, s2);
+    const real c34 = cell_coeff_at (cc.c34, i, kind_ARTM, s1, s2);
+    const real c35 = cell_coeff_at (cc.c35, i, kind_ARTM, s1, s2);
+    const real c36 = cell_coeff_at (cc.c36, i, kind_ARTM, s1, s2);
+    const real c44 = cell_coeff_at (cc.c44, i, kind     , s1, s2);
+    const real c45 = cell_coeff_at (cc.c45, i, kind_ARTM, s1, s2);
+    const real c46 = cell_coeff_at (cc.c46, i, kind_ARTM, s1, s2);
+    const real c55 = cell_coeff_at (cc.c55, i, kind     , s1, s2);
+    const real c56 = cell_coeff_at (cc.c56, i, kind_ARTM, s1, s2);
+    const real c66 = cell_coeff_at (cc.c66, i, kind     , s1, s2);
+
+    const real u_x = stencil_at (vnode_x.u, i, _SX, dimmz, dxi);
+    const real v_x = stencil_at (vnode_x.v, i, _SX, dimmz, dxi);
+    const real w_x = stencil_at (vnode_x.w, i, _SX, dimmz, dxi);
+
+    const real u_y = stencil_at (vnode_y.u, i, _SY, plane, dyi);
+    const real v_y = stencil_at (vnode_y.v, i, _SY, plane, dyi);
+    const real w_y = stencil_at (vnode_y.w, i, _SY, plane, dyi);
+
+    const real u_z = stencil_at (vnode_z.u, i, _SZ, 1    , dzi);
+    const real v_z = stencil_at (vnode_z.v, i, _SZ, 1    , dzi);
+    const real w_z = stencil_at (vnode_z.w, i, _SZ, 1    , dzi);
+
+    stress_update_at (sp.xx,c11,c12,c13,c14,c15,c16,i,dt,u_x,u_y,u_z,v_x,v_y,v_z,w_x,w_y,w_z );
+    stress_update_at (sp.yy,c12,c22,c23,c24,c25,c26,i,dt,u_x,u_y,u_z,v_x,v_y,v_z,w_x,w_y,w_z );
+    stress_update_at (sp.zz,c13,c23,c33,c34,c35,c36,i,dt,u_x,u_y,u_z,v_x,v_y,v_z,w_x,w_y,w_z );
+    stress_update_at (sp.yz,c14,c24,c34,c44,c45,c46,i,dt,u_x,u_y,u_z,v_x,v_y,v_z,w_x,w_y,w_z );
+    stress_update_at (sp.xz,c15,c25,c35,c45,c55,c56,i,dt,u_x,u_y,u_z,v_x,v_y,v_z,w_x,w_y,w_z );
+    stress_update_at (sp.xy,c16,c26,c36,c46,c56,c66,i,dt,u_x,u_y,u_z,v_x,v_y,v_z,w_x,w_y,w_z );
+};
+
+/*
+ * Specialised host kernels, see DECLARE_SCELL_SPEC. Same loop nest and
+ * expressions as compute_component_scell_*, with the offsets fixed and
+ * the index arithmetic hoisted to one base index per column.
+ */
+#define DEFINE_SCELL_SPEC(CELL, SP, _S1, _S2, _SZ, _SX, _SY)                         \
+void compute_component_scell_##CELL##_spec (s_t           s,                         \
+                                            point_v_t     vnode_z,                   \
+                                            point_v_t     vnode_x,                   \
+                                            point_v_t     vnode_y,                   \
+                                            coeff_t       coeffs,                    \
+                                            const real    dt,                        \
+                                            const real    dzi,                       \
+                                            const real    dxi,                       \
+                                            const real    dyi,                       \
+                                            const integer nz0,                       \
+                                            const integer nzf,                       \
+                                            const integer nx0,                       \
+                                            const integer nxf,                       \
+                                            const integer ny0,                       \
+                                            const integer nyf,                       \
+                                            const integer dimmz,                     \
+                                            const integer dimmx)                     \
+{                                                                                    \
+    const integer plane = dimmz * dimmx;                                             \
+                                                                                     \
+    OMP_PARALLEL_FOR                                                                 \
+    for(integer y=ny0; y < nyf; y++)                                                 \
+        for(integer x=nx0; x < nxf; x++)                                             \
+        {                                                                            \
+            const integer col = IDX(0, x, y, dimmz, dimmx);                          \
+                                                                                     \
+            for(integer z=nz0; z < nzf; z++)                                         \
+                scell_update(s.SP, vnode_z, vnode_x, vnode_y, coeffs,                \
+                             COEFF_AVERAGE, COEFF_ARTM, _S1, _S2,                    \
+                             dt, dzi, dxi, dyi, col + z, _SZ, _SX, _SY, dimmz, plane); \
+        }                                                                            \
+};
+
+/* _S1/_S2 are the averaging strides of cell_coeff_at for each cell type */
+DEFINE_SCELL_SPEC(BR, br, dimmz, 1    , forw_offset, back_offset, back_offset)
+DEFINE_SCELL_SPEC(BL, br, plane, 1    , forw_offset, back_offset, forw_offset)
+DEFINE_SCELL_SPEC(TR, tr, dimmz, plane, back_offset, forw_offset, forw_offset)
+DEFINE_SCELL_SPEC(TL, tl, 0    , 0    , back_offset, back_offset, back_offset)
+
+/*
+ * Updates the 24 stress components of the (y,x) column between nz0 and
+ * nzf, cell types in the split order (BR, BL, TR, TL). When coeffs.cache
+ * holds the full cache the averaged coefficients are read directly.
+ */
+void stress_fused_column(s_t           s,
+                         v_t           v,
+                         coeff_t       coeffs,
+                         const real    dt,
+                         const real    dzi,
+                         const real    dxi,
+                         const real    dyi,
+                         const integer nz0,
+                         const integer nzf,
+                         const integer x,
+                         const integer y,
+                         const integer dimmz,
+                         const integer dimmx)
+{
+    const coeff_cache_t* cache = (coeffs.cache && coeffs.cache->br.c11) ? coeffs.cache : NULL;
+    const integer plane = dimmz * dimmx;
+    const integer col   = IDX(0, x, y, dimmz, dimmx);
+
+#if defined(__INTEL_COMPILER)
+    #pragma simd
+#endif
+    for (integer z = nz0; z < nzf; z++ )
+    {
+        const integer i = col + z;
+
+        if ( cache )
+        {
+            scell_update (s.br, v.tr, v.bl, v.br, cache->br, COEFF_CACHED, COEFF_CACHED, 0, 0, dt, dzi, dxi, dyi, i, forw_offset, back_offset, back_offset, dimmz, plane);
+            scell_update (s.br, v.tl, v.br, v.bl, cache->bl, COEFF_CACHED, COEFF_CACHED, 0, 0, dt, dzi, dxi, dyi, i, forw_offset, back_offset, forw_offset, dimmz, plane);
+            scell_update (s.tr, v.br, v.tl, v.tr, cache->tr, COEFF_CACHED, COEFF_CACHED, 0, 0, dt, dzi, dxi, dyi, i, back_offset, forw_offset, forw_offset, dimmz, plane);
+            scell_update (s.tl, v.bl, v.tr, v.tl, cache->tl, COEFF_CACHED, COEFF_CACHED, 0, 0, dt, dzi, dxi, dyi, i, back_offset, back_offset, back_offset, dimmz, plane);
+        }
+        else
+        {
+            scell_update (s.br, v.tr, v.bl, v.br, coeffs, COEFF_AVERAGE, COEFF_ARTM, dimmz, 1    , dt, dzi, dxi, dyi, i, forw_offset, back_offset, back_offset, dimmz, plane);
+            /* BL cells accumulate into s.br, exactly as compute_component_scell_BL does */
+            scell_update (s.br, v.tl, v.br, v.bl, coeffs, COEFF_AVERAGE, COEFF_ARTM, plane, 1    , dt, dzi, dxi, dyi, i, forw_offset, back_offset, forw_offset, dimmz, plane);
+            scell_update (s.tr, v.br, v.tl, v.tr, coeffs, COEFF_AVERAGE, COEFF_ARTM, dimmz, plane, dt, dzi, dxi, dyi, i, back_offset, forw_offset, forw_offset, dimmz, plane);
+            scell_update (s.tl, v.bl, v.tr, v.tl, coeffs, COEFF_AVERAGE, COEFF_ARTM, 0    , 0    , dt, dzi, dxi, dyi, i, back_offset, back_offset, back_offset, dimmz, plane);
+        }
+    }
+};
+
+/*
+ * Sequential update of the stresses of the box [nz0,nzf)x[nx0,nxf)x[ny0,nyf)
+ * with the fused column kernels of the selected instruction set.
+ */
+void stress_fused_block(s_t           s,
+                        v_t           v,
+                        coeff_t       coeffs,
+                        const real    dt,
+                        const real    dzi,
+                        const real    dxi,
+                        const real    dyi,
+                        const integer nz0,
+                        const integer nzf,
+                        const integer nx0,
+                        const integer nxf,
+                        const integer ny0,
+                        const integer nyf,
+                        const integer dimmz,
+                        const integer dimmx)
+{
+    stress_column_t column = stress_fused_column;
+
+#if defined(USE_SIMD_KERNELS)
+    if ( simd_isa == SIMD_AVX512 ) column = stress_fused_column_avx512;
+    if ( simd_isa == SIMD_AVX2   ) column = stress_fused_column_avx2;
+#endif
+
+    for (integer y = ny0; y < nyf; y++)
+        for (integer x = nx0; x < nxf; x++)
+            column(s, v, coeffs, dt, dzi, dxi, dyi,
+                   nz0, nzf, x, y, dimmz, dimmx);
+};
+
+/*
+ * Single sweep version of stress_propagator: every (y,x) column is
+ * visited once and the four cell types are updated back to back, so the
+ * velocity neighbourhoods and the 21 coefficient arrays are streamed once
+ * per phase instead of four times. Within a cell the updates follow the
+ * order of the split kernels, which keeps results bit-identical whatever
+ * the tile traversal is.
+ */
+void stress_propagator_fused(s_t           s,
+                             v_t           v,
+                             coeff_t       coeffs,
+                             real*         UNUSED(rho),
+                             const real    dt,
+                             const real    dzi,
+                             const real    dxi,
+                             const real    dyi,
+                             const integer nz0,
+                             const integer nzf,
+                             const integer nx0,
+                             const integer nxf,
+                             const integer ny0,
+                             const integer nyf,
+                             const integer dimmz,
+                             const integer dimmx,
+                             const phase_t UNUSED(phase))
+{
+    if ( nzf <= nz0 || nxf <= nx0 || nyf <= ny0 ) return;
+
+    const tile_t  tile = traversal_tile( nzf-nz0, nxf-nx0, nyf-ny0 );
+    const integer ntz  = (nzf - nz0 + tile.z - 1) / tile.z;
+    const integer ntx  = (nxf - nx0 + tile.x - 1) / tile.x;
+    const integer nty  = (nyf - ny0 + tile.y - 1) / tile.y;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+    for (integer t = 0; t < ntz * ntx * nty; t++)
+    {
+        const integer tz = t % ntz;
+        const integer tx = (t / ntz) % ntx;
+        const integer ty = t / (ntz * ntx);
+
+        stress_fused_block(s, v, coeffs, dt, dzi, dxi, dyi,
+                TILE_BEGIN(nz0, tz, tile.z), TILE_END(nz0, tz, tile.z, nzf),
+                TILE_BEGIN(nx0, tx, tile.x), TILE_END(nx0, tx, tile.x, nxf),
+                TILE_BEGIN(ny0, ty, tile.y), TILE_END(ny0, ty, tile.y, nyf),
+                dimmz, dimmx);
+    }
+};
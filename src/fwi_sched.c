@@ -44,6 +44,9 @@ void schedule_free( schedule_t s )
     free ( s.dimmy );
     free ( s.ppd );
     free ( s.nworkers );
+    free ( s.gridz );
+    free ( s.gridx );
+    free ( s.gridy );
 };
 
 schedule_t load_schedule( const char* filename ) 
@@ -102,15 +105,33 @@ schedule_t load_schedule( const char* filename )
     s.dimmy    = (integer*) malloc( s.nfreqs * sizeof(integer));
     s.ppd      = (integer*) malloc( s.nfreqs * sizeof(integer));
     s.nworkers = (integer*) malloc( s.nfreqs * sizeof(integer));
+    s.gridz    = (integer*) malloc( s.nfreqs * sizeof(integer));
+    s.gridx    = (integer*) malloc( s.nfreqs * sizeof(integer));
+    s.gridy    = (integer*) malloc( s.nfreqs * sizeof(integer));
 
     /* read the list of simulation parameters */
     for( int i=0; i < s.nfreqs; i++ ) 
     {
-        if (fscanf( fschedule, "%f %d %d %d %f %f %f %f %d %d %d %d %d\n",
+        char line[512];
+
+        if ( fgets( line, sizeof(line), fschedule ) == NULL )
+            print_error("cannot read simulation parameters from file");
+
+        const int fields = sscanf( line, "%f %d %d %d %f %f %f %f %d %d %d %d %d %d %d %d",
                 &s.freq[i], &s.forws[i], &s.backs[i], &s.stacki[i],
                 &s.dt[i], &s.dz[i], &s.dy[i], &s.dx[i],
                 &s.dimmz[i], &s.dimmx[i], &s.dimmy[i],
-                &s.ppd[i], &s.nworkers[i]) != 13)
+                &s.ppd[i], &s.nworkers[i],
+                &s.gridz[i], &s.gridx[i], &s.gridy[i]);
+
+        /* schedules without a process grid split the y axis among the workers */
+        if ( fields == 13 )
+        {
+            s.gridz[i] = 1;
+            s.gridx[i] = 1;
+            s.gridy[i] = s.nworkers[i];
+        }
+        else if ( fields != 16 )
             print_error("cannot read simulation parameters from file");
 
 #if defined(SHARED_MEMORY_RUN)
@@ -126,11 +147,12 @@ schedule_t load_schedule( const char* filename )
 
     for( int i=0; i < s.nfreqs; i++ )
     {
-        print_info("%f %d %d %d %f %f %f %f %d %d %d %d %d", 
+        print_info("%f %d %d %d %f %f %f %f %d %d %d %d %d %d %d %d", 
             s.freq[i], s.forws[i], s.backs[i], s.stacki[i], 
             s.dt[i], s.dz[i], s.dy[i], s.dx[i], 
             s.dimmz[i], s.dimmx[i], s.dimmy[i], 
-            s.ppd[i], s.nworkers[i]);
+            s.ppd[i], s.nworkers[i],
+            s.gridz[i], s.gridx[i], s.gridy[i]);
     }
     /* clean up and resume */
     fclose( fschedule ); fschedule = NULL;
@@ -0,0 +1,1188 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_snapshot.h"
+#include "fwi/fwi_kernel.h"
+
+#include <pthread.h>
+
+int snapshot_buffers  = 2;
+int snapshot_prefetch = 2;
+
+store_backend_t snapshot_store_mode    = AUTO_STORE;
+size_t          snapshot_memory_budget = 0;
+
+#if !defined(DO_NOT_PERFORM_IO)
+/* ranks sharing the memory of this node */
+static int node_ranks = 1;
+#endif
+
+snapshot_layout_t snapshot_layout = CONTAINER_LAYOUT;
+
+/* cells copied per task when staging a snapshot */
+#define SNAPSHOT_COPY_BLOCK 16384
+
+static const char* store_backend_name (const store_backend_t backend)
+{
+    switch ( backend )
+    {
+        case MEMORY_STORE: return "memory";
+        case DISK_STORE  : return "disk";
+        case HYBRID_STORE: return "hybrid";
+        default          : return "auto";
+    }
+};
+
+static int parse_buffers (const char* varname, const char* defvalue)
+{
+    const char* name = read_env_variable_or_default( varname, defvalue );
+
+    if ( strlen( name ) > 0 && strspn( name, "0123456789" ) == strlen( name ) )
+        return atoi( name );
+
+    print_error("Invalid number of snapshot buffers '%s' in %s, using %s", name, varname, defvalue);
+    return atoi( defvalue );
+};
+
+/*
+ * FWI_SNAPSHOT_BUFFERS sets how many staging buffers the asynchronous
+ * snapshot writer may fill before the time loop has to wait for the disk.
+ * FWI_SNAPSHOT_PREFETCH sets how many snapshots the backward pass reads
+ * ahead. Each buffer holds a whole velocity field, 0 moves every snapshot
+ * synchronously from the time loop. FWI_SNAPSHOT_LAYOUT keeps the disk
+ * snapshots of a shot in one 'container' (default) or in one file each
+ * ('files').
+ */
+void select_snapshot_pipeline (void)
+{
+    snapshot_buffers  = parse_buffers( "FWI_SNAPSHOT_BUFFERS" , "2" );
+    snapshot_prefetch = parse_buffers( "FWI_SNAPSHOT_PREFETCH", "2" );
+
+    if ( snapshot_buffers > 0 )
+        print_info("Snapshot writer: asynchronous, %d staging buffers", snapshot_buffers);
+    else
+        print_info("Snapshot writer: synchronous");
+
+    if ( snapshot_prefetch > 0 )
+        print_info("Snapshot reader: %d snapshots read ahead", snapshot_prefetch);
+    else
+        print_info("Snapshot reader: synchronous");
+
+    const char* name = read_env_variable_or_default( "FWI_SNAPSHOT_STORE", "auto" );
+
+    if      ( strcmp( name, "auto"   ) == 0 ) snapshot_store_mode = AUTO_STORE;
+    else if ( strcmp( name, "memory" ) == 0 ) snapshot_store_mode = MEMORY_STORE;
+    else if ( strcmp( name, "disk"   ) == 0 ) snapshot_store_mode = DISK_STORE;
+    else if ( strcmp( name, "hybrid" ) == 0 ) snapshot_store_mode = HYBRID_STORE;
+    else
+    {
+        print_error("Unknown snapshot store '%s' in FWI_SNAPSHOT_STORE, using 'auto'", name);
+        snapshot_store_mode = AUTO_STORE;
+    }
+
+    const char* budget = read_env_variable_or_default( "FWI_SNAPSHOT_MEMORY", "auto" );
+
+    if ( strcmp( budget, "auto" ) == 0 )
+        snapshot_memory_budget = 0;
+    else if ( strlen( budget ) > 0 && strspn( budget, "0123456789" ) == strlen( budget ) )
+        snapshot_memory_budget = (size_t) atol( budget ) * 1024 * 1024;
+    else
+    {
+        print_error("Invalid snapshot memory '%s' in FWI_SNAPSHOT_MEMORY, using 'auto'", budget);
+        snapshot_memory_budget = 0;
+    }
+
+    print_info("Snapshot store: %s", store_backend_name( snapshot_store_mode ));
+
+#if defined(USE_MPI) && !defined(DO_NOT_PERFORM_IO)
+    /* collective: found once for all the shots, which the ranks may compute apart */
+    MPI_Comm node;
+    MPI_Comm_split_type( MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node );
+    MPI_Comm_size( node, &node_ranks );
+    MPI_Comm_free( &node );
+#endif
+
+    const char* layout = read_env_variable_or_default( "FWI_SNAPSHOT_LAYOUT", "container" );
+
+    if      ( strcmp( layout, "container" ) == 0 ) snapshot_layout = CONTAINER_LAYOUT;
+    else if ( strcmp( layout, "files"     ) == 0 ) snapshot_layout = FILE_LAYOUT;
+    else
+    {
+        print_error("Unknown snapshot layout '%s' in FWI_SNAPSHOT_LAYOUT, using 'container'", layout);
+        snapshot_layout = CONTAINER_LAYOUT;
+    }
+
+    print_info("Snapshot layout: %s", (snapshot_layout == CONTAINER_LAYOUT) ? "one container per shot"
+                                                                            : "one file per snapshot");
+};
+
+/*
+ * Velocity components in the order they are laid out in a snapshot file.
+ */
+void snapshot_fields ( v_t *v, real* fields[12] )
+{
+    fields[ 0] = v->tr.u; fields[ 1] = v->tr.v; fields[ 2] = v->tr.w;
+    fields[ 3] = v->tl.u; fields[ 4] = v->tl.v; fields[ 5] = v->tl.w;
+    fields[ 6] = v->br.u; fields[ 7] = v->br.v; fields[ 8] = v->br.w;
+    fields[ 9] = v->bl.u; fields[10] = v->bl.v; fields[11] = v->bl.w;
+};
+
+/*
+ * Copies 'nfields' arrays into consecutive ranges of a staging buffer
+ * (to_buffer) or back.
+ */
+void stage_fields ( real *buffer, real **fields, const int nfields, const integer cellsInVolume, const int to_buffer )
+{
+    const integer nblocks = (cellsInVolume + SNAPSHOT_COPY_BLOCK - 1) / SNAPSHOT_COPY_BLOCK;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for collapse(2) schedule(static)
+#endif
+    for (int f = 0; f < nfields; f++)
+        for (integer b = 0; b < nblocks; b++)
+        {
+            const integer first = b * SNAPSHOT_COPY_BLOCK;
+            const integer cells = min_int( SNAPSHOT_COPY_BLOCK, cellsInVolume - first );
+            real* staged = buffer + (size_t) f * cellsInVolume + first;
+
+            if ( to_buffer ) memcpy( staged, fields[f] + first, cells * sizeof(real) );
+            else             memcpy( fields[f] + first, staged, cells * sizeof(real) );
+        }
+};
+
+/*
+ * Copies the velocity field into a staging buffer (to_buffer) or back.
+ */
+static void stage_snapshot ( real *buffer, v_t *v, const integer cellsInVolume, const int to_buffer )
+{
+    real* fields[12];
+    snapshot_fields( v, fields );
+
+    stage_fields( buffer, fields, 12, cellsInVolume, to_buffer );
+};
+
+typedef struct
+{
+    real   *buffer;
+    size_t  bytes;    /* encoded size of the snapshot held */
+    int     suffix;
+} snapshot_slot_t;
+
+/*
+ * Reads a whole snapshot file, whose size depends on the codec, into a
+ * buffer of 'capacity' bytes.
+ */
+size_t read_snapshot_bytes ( io_file_t *snapshot, const char *fname, void *buffer, const size_t capacity )
+{
+    const size_t bytes = io_size( snapshot );
+
+    if ( bytes > capacity )
+    {
+        print_error("Snapshot %s has %zu bytes, more than the %zu of an encoded snapshot", fname, bytes, capacity);
+        abort();
+    }
+
+    io_read( snapshot, buffer, bytes );
+
+    return bytes;
+};
+
+static const char container_magic[4] = { 'F', 'W', 'I', 'S' };
+
+struct snapshot_container_s
+{
+    char               fname[300];
+    int                nsnapshots;
+
+    container_entry_t *index;
+    int                count;
+    int                cursor;   /* entry after the last one read */
+    size_t             data;     /* offset of the first snapshot */
+    size_t             end;      /* offset of the next snapshot */
+
+    io_file_t         *writer;   /* open until the container is sealed */
+    io_file_t         *reader;
+    pthread_mutex_t    lock;
+
+    /* statistics */
+    double             write_time;
+    double             read_time;
+    size_t             read_bytes;
+};
+
+static size_t page_roundup ( const size_t bytes )
+{
+    return ((bytes + PAGE_BYTES - 1) / PAGE_BYTES) * PAGE_BYTES;
+};
+
+/*
+ * Creates the container of this rank in 'folder' and reserves room for
+ * 'nsnapshots' encoded snapshots.
+ */
+snapshot_container_t* open_snapshot_container ( char          *folder,
+                                                const integer  cellsInVolume,
+                                                const int      nsnapshots )
+{
+    snapshot_container_t *c = (snapshot_container_t*) calloc( 1, sizeof(snapshot_container_t) );
+
+    int rank = 0;
+#if defined(USE_MPI)
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+#endif
+
+    sprintf( c->fname, "%s/snapshots.%03d", folder, rank );
+
+    c->nsnapshots = nsnapshots;
+    c->index      = (container_entry_t*) calloc( nsnapshots, sizeof(container_entry_t) );
+    c->data       = page_roundup( sizeof(container_header_t) + nsnapshots * sizeof(container_entry_t) );
+    c->end        = c->data;
+
+    pthread_mutex_init( &c->lock, NULL );
+
+    const double tstart = dtime();
+
+    c->writer = io_open( c->fname, "wb", __FILE__, __LINE__ );
+    io_reserve( c->writer, c->data + nsnapshots * page_roundup( encoded_snapshot_bound( 12, cellsInVolume ) ) );
+
+    /* an empty header and index for now, they are rewritten when the container is sealed */
+    container_header_t header;
+    memset( &header, 0, sizeof(header) );
+
+    io_write( c->writer, &header, sizeof(header) );
+    io_write( c->writer, c->index, nsnapshots * sizeof(container_entry_t) );
+    io_pad  ( c->writer );
+
+    c->write_time += dtime() - tstart;
+
+    return c;
+};
+
+/* appends a snapshot, called by one thread at a time in the forward pass */
+void append_snapshot ( snapshot_container_t *c,
+                       const int             suffix,
+                       const void           *buffer,
+                       const size_t          bytes )
+{
+    pthread_mutex_lock( &c->lock );
+
+    if ( c->writer == NULL || c->count == c->nsnapshots )
+    {
+        print_error("Snapshot %d does not fit in the sealed or full container %s", suffix, c->fname);
+        abort();
+    }
+
+    container_entry_t *entry = &c->index[ c->count ];
+    pthread_mutex_unlock( &c->lock );
+
+    const double tstart = dtime();
+
+    /* io_write is done with 'buffer' when it returns, the staged tail stays in flight until the container is sealed */
+    io_write( c->writer, buffer, bytes );
+    io_pad  ( c->writer );
+
+    pthread_mutex_lock( &c->lock );
+    entry->suffix = suffix;
+    entry->offset = c->end;
+    entry->bytes  = bytes;
+    c->end       += page_roundup( bytes );
+    c->count++;
+    c->write_time += dtime() - tstart;
+    pthread_mutex_unlock( &c->lock );
+};
+
+/* closes the write stream and stores the index in the header page */
+static void seal_container_locked ( snapshot_container_t *c )
+{
+    if ( c->writer == NULL ) return;
+
+    const double tstart = dtime();
+
+    io_close( c->writer );
+    c->writer = NULL;
+
+    container_header_t header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, container_magic, sizeof(container_magic) );
+    header.capacity = (uint32_t) c->nsnapshots;
+    header.count    = (uint32_t) c->count;
+    header.data     = (uint64_t) c->data;
+
+    FILE *container = safe_fopen( c->fname, "r+b", __FILE__, __LINE__ );
+    safe_fwrite( &header , sizeof(header)           , 1               , container, __FILE__, __LINE__ );
+    safe_fwrite( c->index, sizeof(container_entry_t), c->nsnapshots   , container, __FILE__, __LINE__ );
+    safe_fclose( c->fname, container, __FILE__, __LINE__ );
+
+    c->write_time += dtime() - tstart;
+
+    print_stats("Snapshot container %s: %d snapshots, %lf GB, written in %lf seconds",
+            c->fname, c->count, TOGB( c->end ), c->write_time );
+};
+
+void seal_snapshot_container ( snapshot_container_t *c )
+{
+    pthread_mutex_lock( &c->lock );
+    seal_container_locked( c );
+    pthread_mutex_unlock( &c->lock );
+};
+
+/*
+ * Reads a snapshot back, called by one thread at a time in the backward
+ * pass. Snapshots requested in the order they were written form a single
+ * sequential stream.
+ */
+size_t read_container_snapshot ( snapshot_container_t *c,
+                                 const int             suffix,
+                                 void                 *buffer,
+                                 const size_t          capacity )
+{
+    pthread_mutex_lock( &c->lock );
+
+    seal_container_locked( c );
+
+    int k = -1;
+    for (int i = 0; i < c->count && k < 0; i++)
+    {
+        const int candidate = (c->cursor + i) % c->count;
+        if ( c->index[ candidate ].suffix == suffix ) k = candidate;
+    }
+
+    if ( k < 0 )
+    {
+        print_error("Snapshot %d is not in container %s", suffix, c->fname);
+        abort();
+    }
+
+    c->cursor = (k + 1) % c->count;
+    const container_entry_t entry = c->index[k];
+
+    if ( c->reader == NULL )
+        c->reader = io_open( c->fname, "rb", __FILE__, __LINE__ );
+
+    pthread_mutex_unlock( &c->lock );
+
+    if ( entry.bytes > capacity )
+    {
+        print_error("Snapshot %d of %s has %zu bytes, more than the %zu of an encoded snapshot",
+                    suffix, c->fname, (size_t) entry.bytes, capacity);
+        abort();
+    }
+
+    const double tstart = dtime();
+
+    io_seek( c->reader, (size_t) entry.offset );
+    io_read( c->reader, buffer, (size_t) entry.bytes );
+
+    pthread_mutex_lock( &c->lock );
+    c->read_time  += dtime() - tstart;
+    c->read_bytes += entry.bytes;
+    pthread_mutex_unlock( &c->lock );
+
+    return (size_t) entry.bytes;
+};
+
+void close_snapshot_container ( snapshot_container_t *c )
+{
+    seal_snapshot_container( c );
+
+    if ( c->reader )
+    {
+        io_close( c->reader );
+
+        print_stats("Snapshot container %s: %lf GB read in %lf seconds", c->fname,
+                TOGB( c->read_bytes ), c->read_time );
+    }
+
+    pthread_mutex_destroy( &c->lock );
+
+    free( c->index );
+    free( c );
+};
+
+struct snapshot_writer_s
+{
+    char            *folder;
+    int              rank;
+    integer          cellsInVolume;
+
+    snapshot_container_t *container;
+
+    snapshot_slot_t *slots;
+    int              nslots;
+    int              head;    /* next slot to be written to disk  */
+    int              count;   /* slots holding a pending snapshot */
+    int              closing;
+
+    pthread_t        thread;
+    pthread_mutex_t  lock;
+    pthread_cond_t   not_empty;
+    pthread_cond_t   not_full;
+
+    /* statistics */
+    int              posted;
+    size_t           encoded;
+    int              stalls;
+    double           stall_time;
+    double           copy_time;
+    double           write_time;   /* accumulated by the writer thread */
+};
+
+#if !defined(DO_NOT_PERFORM_IO)
+static void* snapshot_writer_loop ( void* arg )
+{
+    snapshot_writer_t *w = (snapshot_writer_t*) arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock( &w->lock );
+
+        while ( w->count == 0 && !w->closing )
+            pthread_cond_wait( &w->not_empty, &w->lock );
+
+        if ( w->count == 0 )
+        {
+            pthread_mutex_unlock( &w->lock );
+            break;
+        }
+
+        snapshot_slot_t *slot = &w->slots[ w->head ];
+        pthread_mutex_unlock( &w->lock );
+
+        /* the slot stays counted (and untouched by post_snapshot) until it is on disk */
+        const double tstart = dtime();
+
+        if ( w->container )
+            append_snapshot( w->container, slot->suffix, slot->buffer, slot->bytes );
+        else
+        {
+            char fname[300];
+            sprintf(fname,"%s/snapshot.%03d.%05d", w->folder, w->rank, slot->suffix);
+
+            io_file_t *snapshot = io_open( fname, "wb", __FILE__, __LINE__ );
+            io_write( snapshot, slot->buffer, slot->bytes );
+            io_close( snapshot );
+        }
+        const double elapsed = dtime() - tstart;
+
+        pthread_mutex_lock( &w->lock );
+        w->write_time += elapsed;
+        w->head = (w->head + 1) % w->nslots;
+        w->count--;
+        pthread_cond_signal( &w->not_full );
+        pthread_mutex_unlock( &w->lock );
+    }
+
+    return NULL;
+};
+#endif /* end pragma DO_NOT_PERFORM_IO */
+
+/*
+ * Starts the writer thread. Returns NULL when snapshots have to be written
+ * synchronously (no staging buffers or IO disabled).
+ */
+snapshot_writer_t* open_snapshot_writer ( char                 *folder,
+                                          const integer         cellsInVolume,
+                                          const int             nbuffers,
+                                          snapshot_container_t *container )
+{
+#if defined(DO_NOT_PERFORM_IO)
+    return NULL;
+#else
+    if ( nbuffers <= 0 ) return NULL;
+
+    snapshot_writer_t *w = (snapshot_writer_t*) calloc( 1, sizeof(snapshot_writer_t) );
+
+    w->folder        = folder;
+    w->container     = container;
+    w->cellsInVolume = cellsInVolume;
+    w->nslots        = nbuffers;
+    w->slots         = (snapshot_slot_t*) calloc( nbuffers, sizeof(snapshot_slot_t) );
+
+#if defined(USE_MPI)
+    MPI_Comm_rank( MPI_COMM_WORLD, &w->rank );
+#endif
+
+    for (int i = 0; i < nbuffers; i++)
+        w->slots[i].buffer = (real*) __malloc( PAGE_BYTES, encoded_snapshot_bound( 12, cellsInVolume ) );
+
+    pthread_mutex_init( &w->lock, NULL );
+    pthread_cond_init ( &w->not_empty, NULL );
+    pthread_cond_init ( &w->not_full , NULL );
+
+    if ( pthread_create( &w->thread, NULL, snapshot_writer_loop, w ) != 0 )
+    {
+        print_error("Unable to start the snapshot writer thread, writing snapshots synchronously");
+
+        for (int i = 0; i < nbuffers; i++)
+            __free( w->slots[i].buffer );
+
+        free( w->slots );
+        free( w );
+        return NULL;
+    }
+
+    return w;
+#endif /* end pragma DO_NOT_PERFORM_IO */
+};
+
+/*
+ * Copies the velocity field into a free staging buffer and hands it to the
+ * writer thread. Only waits when every buffer is still pending.
+ */
+void post_snapshot ( snapshot_writer_t *w,
+                     const int          suffix,
+                     v_t               *v )
+{
+    PUSH_RANGE
+
+    const integer cellsInVolume = w->cellsInVolume;
+
+#if defined(_OPENACC)
+    #pragma acc update self(v->tr.u[0:cellsInVolume], v->tr.v[0:cellsInVolume], v->tr.w[0:cellsInVolume]) \
+                       self(v->tl.u[0:cellsInVolume], v->tl.v[0:cellsInVolume], v->tl.w[0:cellsInVolume]) \
+                       self(v->br.u[0:cellsInVolume], v->br.v[0:cellsInVolume], v->br.w[0:cellsInVolume]) \
+                       self(v->bl.u[0:cellsInVolume], v->bl.v[0:cellsInVolume], v->bl.w[0:cellsInVolume])
+#endif /* end pragma _OPENACC*/
+
+    pthread_mutex_lock( &w->lock );
+
+    if ( w->count == w->nslots )
+    {
+        const double tstart = dtime();
+
+        while ( w->count == w->nslots )
+            pthread_cond_wait( &w->not_full, &w->lock );
+
+        w->stalls++;
+        w->stall_time += dtime() - tstart;
+    }
+
+    snapshot_slot_t *slot = &w->slots[ (w->head + w->count) % w->nslots ];
+    pthread_mutex_unlock( &w->lock );
+
+    real* fields[12];
+    snapshot_fields( v, fields );
+
+    const double tstart = dtime();
+    slot->bytes = encode_snapshot( (unsigned char*) slot->buffer, fields, 12, cellsInVolume );
+    w->copy_time += dtime() - tstart;
+
+    pthread_mutex_lock( &w->lock );
+    slot->suffix = suffix;
+    w->count++;
+    w->posted++;
+    w->encoded += slot->bytes;
+    pthread_cond_signal( &w->not_empty );
+    pthread_mutex_unlock( &w->lock );
+
+    POP_RANGE
+};
+
+void close_snapshot_writer ( snapshot_writer_t *w )
+{
+    PUSH_RANGE
+
+    const double tstart = dtime();
+
+    pthread_mutex_lock( &w->lock );
+    w->closing = 1;
+    pthread_cond_signal( &w->not_empty );
+    pthread_mutex_unlock( &w->lock );
+
+    pthread_join( w->thread, NULL );
+
+    const double drain_time = dtime() - tstart;
+    const double megabytes  = ((double) w->encoded) / (1000.f * 1000.f);
+
+    print_stats("Snapshot writer: %d snapshots (%lf GB, %lf GB encoded) through %d staging buffers",
+            w->posted, TOGB((size_t) w->cellsInVolume * sizeof(real) * 12 * w->posted), TOGB( w->encoded ), w->nslots);
+    print_stats("\tStaging copies and encoding %lf seconds", w->copy_time);
+    print_stats("\tStalled %d times waiting for a free buffer, %lf seconds", w->stalls, w->stall_time);
+    print_stats("\tDrained the pending snapshots in %lf seconds", drain_time);
+    print_stats("\tWriter busy %lf seconds (%lf MB/s)", w->write_time,
+            (w->write_time > 0.0) ? megabytes / w->write_time : 0.0);
+
+    pthread_mutex_destroy( &w->lock );
+    pthread_cond_destroy ( &w->not_empty );
+    pthread_cond_destroy ( &w->not_full );
+
+    for (int i = 0; i < w->nslots; i++)
+        __free( w->slots[i].buffer );
+
+    free( w->slots );
+    free( w );
+
+    POP_RANGE
+};
+
+struct snapshot_reader_s
+{
+    char            *folder;
+    int              rank;
+    integer          cellsInVolume;
+
+    snapshot_container_t *container;
+
+    /* snapshot k of the schedule is first_suffix + k * step */
+    int              first_suffix;
+    int              step;
+    int              nsnapshots;
+
+    snapshot_slot_t *slots;
+    int              nslots;
+    int              head;    /* next slot to be handed to the propagator */
+    int              count;   /* slots holding a snapshot already read     */
+    int              closing;
+
+    pthread_t        thread;
+    pthread_mutex_t  lock;
+    pthread_cond_t   not_empty;
+    pthread_cond_t   not_full;
+
+    /* statistics */
+    int              fetched;
+    size_t           encoded;
+    int              stalls;
+    double           stall_time;
+    double           copy_time;
+    double           read_time;   /* accumulated by the reader thread */
+};
+
+#if !defined(DO_NOT_PERFORM_IO)
+static void* snapshot_reader_loop ( void* arg )
+{
+    snapshot_reader_t *r = (snapshot_reader_t*) arg;
+    const size_t capacity = encoded_snapshot_bound( 12, r->cellsInVolume );
+
+    for (int k = 0; k < r->nsnapshots; k++)
+    {
+        pthread_mutex_lock( &r->lock );
+
+        while ( r->count == r->nslots && !r->closing )
+            pthread_cond_wait( &r->not_full, &r->lock );
+
+        if ( r->closing )
+        {
+            pthread_mutex_unlock( &r->lock );
+            break;
+        }
+
+        /* free slots are owned by the reader thread until they are counted */
+        snapshot_slot_t *slot = &r->slots[ (r->head + r->count) % r->nslots ];
+        pthread_mutex_unlock( &r->lock );
+
+        slot->suffix = r->first_suffix + k * r->step;
+
+        const double tstart = dtime();
+
+        if ( r->container )
+            slot->bytes = read_container_snapshot( r->container, slot->suffix, slot->buffer, capacity );
+        else
+        {
+            char fname[300];
+            sprintf(fname,"%s/snapshot.%03d.%05d", r->folder, r->rank, slot->suffix);
+
+            io_file_t *snapshot = io_open( fname, "rb", __FILE__, __LINE__ );
+            slot->bytes = read_snapshot_bytes( snapshot, fname, slot->buffer, capacity );
+            io_close( snapshot );
+        }
+        const double elapsed = dtime() - tstart;
+
+        pthread_mutex_lock( &r->lock );
+        r->read_time += elapsed;
+        r->encoded   += slot->bytes;
+        r->count++;
+        pthread_cond_signal( &r->not_empty );
+        pthread_mutex_unlock( &r->lock );
+    }
+
+    return NULL;
+};
+#endif /* end pragma DO_NOT_PERFORM_IO */
+
+/*
+ * Starts reading the snapshots first_suffix, first_suffix + step, ... on a
+ * helper thread. Returns NULL when snapshots have to be read synchronously
+ * (no read-ahead buffers or IO disabled).
+ */
+snapshot_reader_t* open_snapshot_reader ( char                 *folder,
+                                          const integer         cellsInVolume,
+                                          const int             nbuffers,
+                                          const int             first_suffix,
+                                          const int             step,
+                                          const int             nsnapshots,
+                                          snapshot_container_t *container )
+{
+#if defined(DO_NOT_PERFORM_IO)
+    return NULL;
+#else
+    if ( nbuffers <= 0 || nsnapshots <= 0 ) return NULL;
+
+    snapshot_reader_t *r = (snapshot_reader_t*) calloc( 1, sizeof(snapshot_reader_t) );
+
+    r->folder        = folder;
+    r->container     = container;
+    r->cellsInVolume = cellsInVolume;
+    r->first_suffix  = first_suffix;
+    r->step          = step;
+    r->nsnapshots    = nsnapshots;
+    r->nslots        = min_int( nbuffers, nsnapshots );
+    r->slots         = (snapshot_slot_t*) calloc( r->nslots, sizeof(snapshot_slot_t) );
+
+#if defined(USE_MPI)
+    MPI_Comm_rank( MPI_COMM_WORLD, &r->rank );
+#endif
+
+    for (int i = 0; i < r->nslots; i++)
+        r->slots[i].buffer = (real*) __malloc( PAGE_BYTES, encoded_snapshot_bound( 12, cellsInVolume ) );
+
+    pthread_mutex_init( &r->lock, NULL );
+    pthread_cond_init ( &r->not_empty, NULL );
+    pthread_cond_init ( &r->not_full , NULL );
+
+    if ( pthread_create( &r->thread, NULL, snapshot_reader_loop, r ) != 0 )
+    {
+        print_error("Unable to start the snapshot reader thread, reading snapshots synchronously");
+
+        for (int i = 0; i < r->nslots; i++)
+            __free( r->slots[i].buffer );
+
+        free( r->slots );
+        free( r );
+        return NULL;
+    }
+
+    return r;
+#endif /* end pragma DO_NOT_PERFORM_IO */
+};
+
+/*
+ * Copies the next snapshot of the schedule into the velocity field. Only
+ * waits when the reader thread has not finished reading it yet.
+ */
+void fetch_snapshot ( snapshot_reader_t *r,
+                      const int          suffix,
+                      v_t               *v )
+{
+    PUSH_RANGE
+
+    const integer cellsInVolume = r->cellsInVolume;
+
+    if ( r->fetched == r->nsnapshots )
+    {
+        print_error("Snapshot %d requested past the end of the read-ahead schedule", suffix);
+        abort();
+    }
+
+    pthread_mutex_lock( &r->lock );
+
+    if ( r->count == 0 )
+    {
+        const double tstart = dtime();
+
+        while ( r->count == 0 )
+            pthread_cond_wait( &r->not_empty, &r->lock );
+
+        r->stalls++;
+        r->stall_time += dtime() - tstart;
+    }
+
+    snapshot_slot_t *slot = &r->slots[ r->head ];
+    pthread_mutex_unlock( &r->lock );
+
+    if ( slot->suffix != suffix )
+    {
+        print_error("Snapshot %d requested but snapshot %d was read ahead", suffix, slot->suffix);
+        abort();
+    }
+
+    real* fields[12];
+    snapshot_fields( v, fields );
+
+    const double tstart = dtime();
+    decode_snapshot( (unsigned char*) slot->buffer, slot->bytes, fields, 12, cellsInVolume );
+    r->copy_time += dtime() - tstart;
+
+    pthread_mutex_lock( &r->lock );
+    r->head = (r->head + 1) % r->nslots;
+    r->count--;
+    r->fetched++;
+    pthread_cond_signal( &r->not_full );
+    pthread_mutex_unlock( &r->lock );
+
+#if defined(_OPENACC)
+    #pragma acc update device(v->tr.u[0:cellsInVolume], v->tr.v[0:cellsInVolume], v->tr.w[0:cellsInVolume]) \
+                       device(v->tl.u[0:cellsInVolume], v->tl.v[0:cellsInVolume], v->tl.w[0:cellsInVolume]) \
+                       device(v->br.u[0:cellsInVolume], v->br.v[0:cellsInVolume], v->br.w[0:cellsInVolume]) \
+                       device(v->bl.u[0:cellsInVolume], v->bl.v[0:cellsInVolume], v->bl.w[0:cellsInVolume]) \
+                       async(H2D)
+#endif /* end pragma _OPENACC */
+
+    POP_RANGE
+};
+
+void close_snapshot_reader ( snapshot_reader_t *r )
+{
+    PUSH_RANGE
+
+    pthread_mutex_lock( &r->lock );
+    r->closing = 1;
+    pthread_cond_signal( &r->not_full );
+    pthread_mutex_unlock( &r->lock );
+
+    pthread_join( r->thread, NULL );
+
+    const double megabytes = ((double) r->encoded) / (1000.f * 1000.f);
+
+    print_stats("Snapshot reader: %d snapshots (%lf GB, %lf GB encoded) read up to %d ahead",
+            r->fetched, TOGB((size_t) r->cellsInVolume * sizeof(real) * 12 * r->fetched), TOGB( r->encoded ), r->nslots);
+    print_stats("\tStaging copies and decoding %lf seconds", r->copy_time);
+    print_stats("\tStalled %d times waiting for a snapshot, %lf seconds", r->stalls, r->stall_time);
+    print_stats("\tReader busy %lf seconds (%lf MB/s)", r->read_time,
+            (r->read_time > 0.0) ? megabytes / r->read_time : 0.0);
+
+    pthread_mutex_destroy( &r->lock );
+    pthread_cond_destroy ( &r->not_empty );
+    pthread_cond_destroy ( &r->not_full );
+
+    for (int i = 0; i < r->nslots; i++)
+        __free( r->slots[i].buffer );
+
+    free( r->slots );
+    free( r );
+
+    POP_RANGE
+};
+
+struct snapshot_store_s
+{
+    char              *folder;
+    integer            dimmz, dimmx, dimmy;
+    integer            cellsInVolume;
+    store_backend_t    backend;
+
+    /* snapshot k of the forward pass is first_suffix + k * step */
+    int                first_suffix;
+    int                step;
+    int                nsnapshots;
+
+    /* the last 'nresident' snapshots of the forward pass stay in memory,
+     * encoded when the codec makes them smaller */
+    int                nresident;
+    real             **resident;
+    size_t             resident_bytes;
+    int                encode_resident;
+
+    snapshot_writer_t *writer;
+    snapshot_reader_t *reader;
+    int                reader_opened;
+
+    /* disk snapshots of the shot, and the encoding of the synchronous ones */
+    snapshot_container_t *container;
+    unsigned char        *scratch;
+
+    /* recomputes the snapshots instead when set */
+    checkpointer_t    *checkpoints;
+};
+
+#if !defined(DO_NOT_PERFORM_IO)
+/*
+ * Memory the snapshots of this process may take: FWI_SNAPSHOT_MEMORY or half
+ * of the available memory, shared with the other ranks of the node.
+ */
+static size_t snapshot_memory_limit (void)
+{
+    if ( snapshot_memory_budget > 0 ) return snapshot_memory_budget;
+
+    return available_memory() / 2 / node_ranks;
+};
+#endif /* end pragma DO_NOT_PERFORM_IO */
+
+/*
+ * Chooses where the 'nsnapshots' snapshots of a shot are kept: all in memory
+ * when they fit in the budget, the most recent ones in memory and the rest
+ * on disk when at least one fits, and everything on disk otherwise.
+ */
+snapshot_store_t* open_snapshot_store ( char          *folder,
+                                        const integer  dimmz,
+                                        const integer  dimmx,
+                                        const integer  dimmy,
+                                        const int      first_suffix,
+                                        const int      step,
+                                        const int      nsnapshots )
+{
+    snapshot_store_t *store = (snapshot_store_t*) calloc( 1, sizeof(snapshot_store_t) );
+
+    store->folder        = folder;
+    store->dimmz         = dimmz;
+    store->dimmx         = dimmx;
+    store->dimmy         = dimmy;
+    store->cellsInVolume = dimmz * dimmx * dimmy;
+    store->first_suffix  = first_suffix;
+    store->step          = step;
+    store->nsnapshots    = nsnapshots;
+
+    const size_t raw     = (size_t) store->cellsInVolume * sizeof(real) * 12;
+    const size_t encoded = encoded_snapshot_bound( 12, store->cellsInVolume );
+
+    store->encode_resident = ( encoded < raw );
+    store->resident_bytes  = store->encode_resident ? encoded : raw;
+
+#if defined(DO_NOT_PERFORM_IO)
+    store->backend = DISK_STORE;
+#else
+    const size_t bytes   = store->resident_bytes;
+    const size_t limit   = snapshot_memory_limit();
+    const int    fitting = (int) ((limit / bytes < (size_t) nsnapshots) ? limit / bytes : (size_t) nsnapshots);
+
+    store->backend = snapshot_store_mode;
+
+    if ( store->backend == AUTO_STORE )
+        store->backend = (fitting == nsnapshots) ? MEMORY_STORE :
+                         (fitting > 0          ) ? HYBRID_STORE : DISK_STORE;
+
+    switch ( store->backend )
+    {
+        case MEMORY_STORE: store->nresident = nsnapshots; break;
+        case HYBRID_STORE: store->nresident = fitting;    break;
+        default          : store->nresident = 0;          break;
+    }
+
+    if ( store->nresident > 0 )
+        store->resident = (real**) calloc( store->nresident, sizeof(real*) );
+
+    print_stats("Snapshot store: %s, %d of %d snapshots in memory (%lf GB, limit %lf GB)",
+            store_backend_name( store->backend ), store->nresident, nsnapshots,
+            TOGB( bytes * store->nresident ), TOGB( limit ));
+#endif /* end pragma DO_NOT_PERFORM_IO */
+
+    return store;
+};
+
+/*
+ * Slot of the in-memory snapshots that holds 'suffix', or -1 when it is
+ * stored on disk.
+ */
+static int resident_slot ( snapshot_store_t *store, const int suffix )
+{
+    const int k     = (suffix - store->first_suffix) / store->step;
+    const int spill = store->nsnapshots - store->nresident;
+
+    return ( k >= spill ) ? k - spill : -1;
+};
+
+void use_checkpoints ( snapshot_store_t *store,
+                       checkpointer_t   *ckp )
+{
+    store->checkpoints = ckp;
+};
+
+/*
+ * Stores a forward snapshot. Called in the order of the forward schedule.
+ */
+void store_snapshot ( snapshot_store_t *store,
+                      const int         suffix,
+                      v_t              *v,
+                      s_t              *s )
+{
+    if ( store->checkpoints )
+    {
+        checkpoint_state( store->checkpoints, suffix, v, s );
+        return;
+    }
+
+    const int slot = resident_slot( store, suffix );
+
+    if ( slot >= 0 )
+    {
+        const integer cellsInVolume = store->cellsInVolume;
+
+#if defined(_OPENACC)
+        #pragma acc update self(v->tr.u[0:cellsInVolume], v->tr.v[0:cellsInVolume], v->tr.w[0:cellsInVolume]) \
+                           self(v->tl.u[0:cellsInVolume], v->tl.v[0:cellsInVolume], v->tl.w[0:cellsInVolume]) \
+                           self(v->br.u[0:cellsInVolume], v->br.v[0:cellsInVolume], v->br.w[0:cellsInVolume]) \
+                           self(v->bl.u[0:cellsInVolume], v->bl.v[0:cellsInVolume], v->bl.w[0:cellsInVolume])
+#endif /* end pragma _OPENACC*/
+
+        if ( store->resident[slot] == NULL )
+            store->resident[slot] = (real*) __malloc( ALIGN_REAL, store->resident_bytes );
+
+        if ( store->encode_resident )
+        {
+            real* fields[12];
+            snapshot_fields( v, fields );
+            encode_snapshot( (unsigned char*) store->resident[slot], fields, 12, cellsInVolume );
+        }
+        else
+            stage_snapshot( store->resident[slot], v, cellsInVolume, 1 );
+        return;
+    }
+
+#if !defined(DO_NOT_PERFORM_IO)
+    if ( snapshot_layout == CONTAINER_LAYOUT && store->container == NULL )
+        store->container = open_snapshot_container( store->folder, store->cellsInVolume,
+                                                    store->nsnapshots - store->nresident );
+#endif
+
+    if ( store->writer == NULL )
+        store->writer = open_snapshot_writer( store->folder, store->cellsInVolume, snapshot_buffers, store->container );
+
+    if ( store->writer )
+        post_snapshot ( store->writer, suffix, v );
+    else if ( store->container )
+    {
+#if defined(_OPENACC)
+        const integer cellsInVolume = store->cellsInVolume;
+
+        #pragma acc update self(v->tr.u[0:cellsInVolume], v->tr.v[0:cellsInVolume], v->tr.w[0:cellsInVolume]) \
+                           self(v->tl.u[0:cellsInVolume], v->tl.v[0:cellsInVolume], v->tl.w[0:cellsInVolume]) \
+                           self(v->br.u[0:cellsInVolume], v->br.v[0:cellsInVolume], v->br.w[0:cellsInVolume]) \
+                           self(v->bl.u[0:cellsInVolume], v->bl.v[0:cellsInVolume], v->bl.w[0:cellsInVolume])
+#endif /* end pragma _OPENACC*/
+
+        real* fields[12];
+        snapshot_fields( v, fields );
+
+        if ( store->scratch == NULL )
+            store->scratch = (unsigned char*) __malloc( PAGE_BYTES, encoded_snapshot_bound( 12, store->cellsInVolume ) );
+
+        const size_t bytes = encode_snapshot( store->scratch, fields, 12, store->cellsInVolume );
+        append_snapshot( store->container, suffix, store->scratch, bytes );
+    }
+    else
+        write_snapshot( store->folder, suffix, v, store->dimmz, store->dimmx, store->dimmy );
+};
+
+/*
+ * Loads a snapshot for the backward pass. Called in the order of the forward
+ * schedule, so the disk snapshots are read ahead while the first ones are
+ * consumed and the in-memory ones come last.
+ */
+void load_snapshot ( snapshot_store_t *store,
+                     const int         suffix,
+                     v_t              *v )
+{
+    if ( store->checkpoints )
+    {
+        recompute_snapshot( store->checkpoints, suffix, v );
+        return;
+    }
+
+    const int spill = store->nsnapshots - store->nresident;
+
+    if ( !store->reader_opened )
+    {
+        store->reader = open_snapshot_reader( store->folder, store->cellsInVolume, snapshot_prefetch,
+                                              store->first_suffix, store->step, spill, store->container );
+        store->reader_opened = 1;
+    }
+
+    const int slot = resident_slot( store, suffix );
+
+    if ( slot >= 0 )
+    {
+        const integer cellsInVolume = store->cellsInVolume;
+
+        if ( store->encode_resident )
+        {
+            real* fields[12];
+            snapshot_fields( v, fields );
+            decode_snapshot( (unsigned char*) store->resident[slot], store->resident_bytes, fields, 12, cellsInVolume );
+        }
+        else
+            stage_snapshot( store->resident[slot], v, cellsInVolume, 0 );
+
+#if defined(_OPENACC)
+        #pragma acc update device(v->tr.u[0:cellsInVolume], v->tr.v[0:cellsInVolume], v->tr.w[0:cellsInVolume]) \
+                           device(v->tl.u[0:cellsInVolume], v->tl.v[0:cellsInVolume], v->tl.w[0:cellsInVolume]) \
+                           device(v->br.u[0:cellsInVolume], v->br.v[0:cellsInVolume], v->br.w[0:cellsInVolume]) \
+                           device(v->bl.u[0:cellsInVolume], v->bl.v[0:cellsInVolume], v->bl.w[0:cellsInVolume]) \
+                           async(H2D)
+#endif /* end pragma _OPENACC */
+        return;
+    }
+
+    if ( store->reader )
+        fetch_snapshot( store->reader, suffix, v );
+    else if ( store->container )
+    {
+        const size_t capacity = encoded_snapshot_bound( 12, store->cellsInVolume );
+
+        if ( store->scratch == NULL )
+            store->scratch = (unsigned char*) __malloc( PAGE_BYTES, capacity );
+
+        real* fields[12];
+        snapshot_fields( v, fields );
+
+        const size_t bytes = read_container_snapshot( store->container, suffix, store->scratch, capacity );
+        decode_snapshot( store->scratch, bytes, fields, 12, store->cellsInVolume );
+
+#if defined(_OPENACC)
+        const integer cellsInVolume = store->cellsInVolume;
+
+        #pragma acc update device(v->tr.u[0:cellsInVolume], v->tr.v[0:cellsInVolume], v->tr.w[0:cellsInVolume]) \
+                           device(v->tl.u[0:cellsInVolume], v->tl.v[0:cellsInVolume], v->tl.w[0:cellsInVolume]) \
+                           device(v->br.u[0:cellsInVolume], v->br.v[0:cellsInVolume], v->br.w[0:cellsInVolume]) \
+                           device(v->bl.u[0:cellsInVolume], v->bl.v[0:cellsInVolume], v->bl.w[0:cellsInVolume]) \
+                           async(H2D)
+#endif /* end pragma _OPENACC */
+    }
+    else
+        read_snapshot ( store->folder, suffix, v, store->dimmz, store->dimmx, store->dimmy );
+};
+
+/*
+ * Ends a propagation pass: waits for the pending writes and stops the reader.
+ */
+void flush_snapshot_store ( snapshot_store_t *store )
+{
+    if ( store->writer ) close_snapshot_writer( store->writer );
+    if ( store->reader ) close_snapshot_reader( store->reader );
+
+    /* the index goes to disk once the forward pass is over */
+    if ( store->container ) seal_snapshot_container( store->container );
+
+    store->writer        = NULL;
+    store->reader        = NULL;
+    store->reader_opened = 0;
+};
+
+void close_snapshot_store ( snapshot_store_t *store )
+{
+    flush_snapshot_store( store );
+
+    if ( store->checkpoints ) close_checkpointer( store->checkpoints );
+    if ( store->container   ) close_snapshot_container( store->container );
+    if ( store->scratch     ) __free( store->scratch );
+
+    for (int i = 0; i < store->nresident; i++)
+        if ( store->resident[i] ) __free( store->resident[i] );
+
+    free( store->resident );
+    free( store );
+};
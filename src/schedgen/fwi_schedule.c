@@ -40,6 +40,7 @@
 #include <math.h>
 
 #include "fwi/fwi_sched.h"
+#include "fwi/fwi_domain.h"
 
 const double BytesInGB = 1024.f * 1024.f * 1024.f;
 
@@ -187,15 +188,21 @@ int main(int argc, char *argv[])
                 nworkers += 1;
         }
 
+        /* the workers of a shot split y and x, whichever exchanges fewer halo bytes */
+        const process_grid_t grid = best_process_grid( nworkers, dimmz, dimmx, dimmy, 0 );
+
         printf("  ------------------------------------------------------------------------------------\n\n");
         printf("                                FWI SCHEDULE GENERATOR\n");
         printf("	There are %d y-planes to compute, each worker can hold %d of these planes\n", dimmy, ppd);
         printf("	At this frequency (%f Hz) we'll need %d workers per shot\n", waveletFreq, nworkers );
         printf("	There are %d shots to be computed, so %d slave nodes are needed.\n", nshots, nshots );
+        printf("	The workers form a %dx%dx%d process grid (z, x, y), exchanging %lu halo bytes per time step\n",
+                grid.z, grid.x, grid.y, (unsigned long) halo_bytes_per_rank( grid, dimmz, dimmx, dimmy ));
         printf("  ------------------------------------------------------------------------------------\n\n");
 
-        IO_CHECK( fprintf( fschedule, "%f %d %d %d %f %f %f %f %d %d %d %d %d\n", 
-        waveletFreq, forw_steps, back_steps, stacki, dt, dz, dy, dx, dimmz, dimmx, dimmy, ppd, nworkers));
+        IO_CHECK( fprintf( fschedule, "%f %d %d %d %f %f %f %f %d %d %d %d %d %d %d %d\n", 
+        waveletFreq, forw_steps, back_steps, stacki, dt, dz, dy, dx, dimmz, dimmx, dimmy, ppd, nworkers,
+        grid.z, grid.x, grid.y));
     }
 
     fclose( fschedule ); fschedule = NULL;
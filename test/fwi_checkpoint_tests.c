@@ -0,0 +1,195 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+
+/* 11 forward steps with one snapshot every 2, as in the RTM forward pass */
+#define CHECKPOINT_STEPS     11
+#define CHECKPOINT_STACKI    2
+#define CHECKPOINT_SNAPSHOTS 6
+
+static const real dt  = 0.001;
+static const real dzi = 1.0;
+static const real dxi = 1.0;
+static const real dyi = 1.0;
+
+static real* initial;
+static real* snapshots[CHECKPOINT_SNAPSHOTS];
+
+TEST_GROUP(checkpoint);
+
+TEST_SETUP(checkpoint)
+{
+    nelems = dimmz * dimmx * dimmy;
+
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c_ref, &s_ref, &v_ref, &rho_ref);
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c_cal, &s_cal, &v_cal, &rho_cal);
+
+    real* coeffs[] = { c_ref.c11, c_ref.c12, c_ref.c13, c_ref.c14, c_ref.c15, c_ref.c16,
+                       c_ref.c22, c_ref.c23, c_ref.c24, c_ref.c25, c_ref.c26,
+                       c_ref.c33, c_ref.c34, c_ref.c35, c_ref.c36,
+                       c_ref.c44, c_ref.c45, c_ref.c46,
+                       c_ref.c55, c_ref.c56,
+                       c_ref.c66, rho_ref };
+
+    for (int f = 0; f < 22; f++)
+        init_array(coeffs[f], nelems);
+
+    real* fields[STATE_FIELDS];
+    state_fields( &v_ref, &s_ref, fields );
+
+    for (int f = 0; f < STATE_FIELDS; f++)
+        init_array(fields[f], nelems);
+
+    /* the forward pass of every test starts from the same state */
+    initial = (real*) malloc( nelems * sizeof(real) * STATE_FIELDS );
+    stage_fields( initial, fields, STATE_FIELDS, nelems, 1 );
+
+    for (int k = 0; k < CHECKPOINT_SNAPSHOTS; k++)
+        snapshots[k] = (real*) malloc( nelems * sizeof(real) * 12 );
+}
+
+TEST_TEAR_DOWN(checkpoint)
+{
+    for (int k = 0; k < CHECKPOINT_SNAPSHOTS; k++)
+        free( snapshots[k] );
+    free( initial );
+
+    free_memory_shot(&c_ref, &s_ref, &v_ref, &rho_ref);
+    free_memory_shot(&c_cal, &s_cal, &v_cal, &rho_cal);
+}
+
+TEST(checkpoint, revolve_plan)
+{
+    const int nstates = 20;
+    const int nfree   = 5;
+    const int S       = nfree + 1;
+
+    long *cost  = (long*) calloc( (nstates + 1) * S, sizeof(long) );
+    int  *split = (int* ) calloc( (nstates + 1) * S, sizeof(int ) );
+
+    plan_revolve( nstates, nfree, cost, split );
+
+    for (int L = 1; L <= nstates; L++)
+    {
+        /* without free slots every state is advanced from the first one */
+        TEST_ASSERT_EQUAL_INT( (L * (L - 1)) / 2, cost[L * S] );
+
+        for (int s = 1; s <= nfree; s++)
+        {
+            TEST_ASSERT_TRUE( cost[L * S + s] <= cost[L * S + s - 1] );
+            TEST_ASSERT_TRUE( split[L * S + s] >= 0 && split[L * S + s] < max_int( L, 1 ) );
+        }
+    }
+
+    /* with enough slots each interval is advanced once */
+    TEST_ASSERT_EQUAL_INT( 4, cost[5 * S + nfree] );
+    /* 6 states, one free slot: advance 3, reverse the last 3 without slots (3), then the first 3 (2) */
+    TEST_ASSERT_EQUAL_INT( 8, cost[6 * S + 1] );
+
+    free( cost );
+    free( split );
+}
+
+/*
+ * Runs the forward pass from the initial state, handing every snapshot to a
+ * checkpointer with 'nslots' states, and checks the snapshots it recomputes
+ * in the given order against the ones of the forward pass.
+ */
+static void check_recompute( const int nslots, const int* order )
+{
+    real* fields[STATE_FIELDS];
+    real* vfields[12];
+
+    state_fields( &v_ref, &s_ref, fields );
+    stage_fields( initial, fields, STATE_FIELDS, nelems, 0 );
+
+    checkpointer_t *ckp = open_checkpointer( nslots, CHECKPOINT_SNAPSHOTS,
+                                             CHECKPOINT_SNAPSHOTS - 1, -1, CHECKPOINT_STACKI,
+                                             c_ref, rho_ref, dt, dzi, dxi, dyi,
+                                             0, dimmz, 0, dimmx, 0, dimmy,
+                                             dimmz, dimmx, dimmy, NULL );
+
+    for (int t = 0; t < CHECKPOINT_STEPS; t++)
+    {
+        advance_shot( v_ref, s_ref, c_ref, rho_ref, 1, dt, dzi, dxi, dyi,
+                      0, dimmz, 0, dimmx, 0, dimmy, dimmz, dimmx, NULL );
+
+        if ( t % CHECKPOINT_STACKI == 0 )
+        {
+            const int k = t / CHECKPOINT_STACKI;
+
+            snapshot_fields( &v_ref, vfields );
+            stage_fields( snapshots[k], vfields, 12, nelems, 1 );
+            checkpoint_state( ckp, CHECKPOINT_SNAPSHOTS - 1 - k, &v_ref, &s_ref );
+        }
+    }
+
+    /* the backward pass overwrites the shot arrays */
+    state_fields( &v_ref, &s_ref, fields );
+    for (int f = 0; f < STATE_FIELDS; f++)
+        set_array_to_constant( fields[f], 0.f, nelems );
+
+    real* buffer = (real*) malloc( nelems * sizeof(real) * 12 );
+
+    for (int i = 0; i < CHECKPOINT_SNAPSHOTS; i++)
+    {
+        const int k = order[i];
+
+        recompute_snapshot( ckp, CHECKPOINT_SNAPSHOTS - 1 - k, &v_cal );
+
+        snapshot_fields( &v_cal, vfields );
+        stage_fields( buffer, vfields, 12, nelems, 1 );
+        TEST_ASSERT_EQUAL_MEMORY( snapshots[k], buffer, nelems * sizeof(real) * 12 );
+    }
+
+    free( buffer );
+    close_checkpointer( ckp );
+}
+
+TEST(checkpoint, recompute_snapshots)
+{
+    const int forward[CHECKPOINT_SNAPSHOTS] = { 0, 1, 2, 3, 4, 5 };
+    const int reverse[CHECKPOINT_SNAPSHOTS] = { 5, 4, 3, 2, 1, 0 };
+
+    check_recompute( 2, forward );
+    check_recompute( 2, reverse );
+    check_recompute( 1, reverse );
+    check_recompute( CHECKPOINT_SNAPSHOTS, reverse );
+}
+
+TEST_GROUP_RUNNER(checkpoint)
+{
+    RUN_TEST_CASE(checkpoint, revolve_plan);
+    RUN_TEST_CASE(checkpoint, recompute_snapshots);
+}
@@ -0,0 +1,369 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+
+/* several coded blocks and a partial one */
+#define CODEC_CELLS 50000
+
+static real* fields[12];
+
+/*
+ * A smooth wave in the first half of every field, zeros (not reached yet)
+ * in the second half and a spike.
+ */
+static void set_wavefield( real **f, const int nfields, const integer cells )
+{
+    for (int k = 0; k < nfields; k++)
+    {
+        for (integer i = 0; i < cells; i++)
+            f[k][i] = (i < cells / 2) ? (k + 1) * sinf( 0.01f * i ) * expf( -1e-4f * i ) : 0.f;
+
+        f[k][cells / 4] = 50.f * (k + 1);
+    }
+}
+
+/*
+ * Largest difference of 'cal' from 'ref' in every field, against the error
+ * bound of the codec.
+ */
+static void assert_within_tolerance( real **ref, real **cal, const int nfields, const integer cells )
+{
+    for (int k = 0; k < nfields; k++)
+    {
+        double largest = 0.0;
+        for (integer i = 0; i < cells; i++)
+            if ( fabs( ref[k][i] ) > largest ) largest = fabs( ref[k][i] );
+
+        const double bound = snapshot_tolerance_relative ? snapshot_tolerance * largest : snapshot_tolerance;
+
+        for (integer i = 0; i < cells; i++)
+            TEST_ASSERT_TRUE( fabs( (double) ref[k][i] - cal[k][i] ) <= bound );
+    }
+}
+
+TEST_GROUP(codec);
+
+TEST_SETUP(codec)
+{
+    nelems = dimmz * dimmx * dimmy;
+
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c_ref, &s_ref, &v_ref, &rho_ref);
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c_cal, &s_cal, &v_cal, &rho_cal);
+
+    real* coeffs[] = { c_ref.c11, c_ref.c12, c_ref.c13, c_ref.c14, c_ref.c15, c_ref.c16,
+                       c_ref.c22, c_ref.c23, c_ref.c24, c_ref.c25, c_ref.c26,
+                       c_ref.c33, c_ref.c34, c_ref.c35, c_ref.c36,
+                       c_ref.c44, c_ref.c45, c_ref.c46,
+                       c_ref.c55, c_ref.c56,
+                       c_ref.c66, rho_ref };
+
+    for (int f = 0; f < 22; f++)
+        init_array(coeffs[f], nelems);
+
+    for (int f = 0; f < 12; f++)
+        fields[f] = (real*) malloc( CODEC_CELLS * sizeof(real) );
+}
+
+TEST_TEAR_DOWN(codec)
+{
+    for (int f = 0; f < 12; f++)
+        free( fields[f] );
+
+    snapshot_codec              = RAW_CODEC;
+    snapshot_tolerance          = 1e-4;
+    snapshot_tolerance_relative = 1;
+
+    free_memory_shot(&c_ref, &s_ref, &v_ref, &rho_ref);
+    free_memory_shot(&c_cal, &s_cal, &v_cal, &rho_cal);
+}
+
+TEST(codec, raw_roundtrip)
+{
+    real* ref[12];
+    real* cal[12];
+
+    snapshot_fields( &v_ref, ref );
+    snapshot_fields( &v_cal, cal );
+
+    for (int f = 0; f < 12; f++)
+        init_array( ref[f], nelems );
+
+    snapshot_codec = RAW_CODEC;
+
+    unsigned char *encoded = (unsigned char*) malloc( encoded_snapshot_bound( 12, nelems ) );
+    const size_t   bytes   = encode_snapshot( encoded, ref, 12, nelems );
+
+    /* the raw encoding is the layout of the snapshot files */
+    TEST_ASSERT_EQUAL_INT( nelems * sizeof(real) * 12, bytes );
+    TEST_ASSERT_EQUAL_MEMORY( ref[5], encoded + 5 * nelems * sizeof(real), nelems * sizeof(real) );
+
+    decode_snapshot( encoded, bytes, cal, 12, nelems );
+
+    for (int f = 0; f < 12; f++)
+        TEST_ASSERT_EQUAL_MEMORY( ref[f], cal[f], nelems * sizeof(real) );
+
+    free( encoded );
+}
+
+TEST(codec, error_bound)
+{
+    real* decoded[12];
+    for (int f = 0; f < 12; f++)
+        decoded[f] = (real*) malloc( CODEC_CELLS * sizeof(real) );
+
+    set_wavefield( fields, 12, CODEC_CELLS );
+
+    snapshot_codec = LOSSY_CODEC;
+
+    unsigned char *encoded = (unsigned char*) malloc( encoded_snapshot_bound( 12, CODEC_CELLS ) );
+
+    const double tolerances[] = { 1e-3, 1e-4, 1e-2 };
+    const int    relative  [] = { 0,    1,    1    };
+
+    for (int t = 0; t < 3; t++)
+    {
+        snapshot_tolerance          = tolerances[t];
+        snapshot_tolerance_relative = relative[t];
+
+        const size_t bytes = encode_snapshot( encoded, fields, 12, CODEC_CELLS );
+        TEST_ASSERT_TRUE( bytes < CODEC_CELLS * sizeof(real) * 12 / 2 );
+
+        decode_snapshot( encoded, bytes, decoded, 12, CODEC_CELLS );
+        assert_within_tolerance( fields, decoded, 12, CODEC_CELLS );
+
+        fprintf(stdout, "\n%s bound %g: %.1f%% of the raw snapshot",
+                relative[t] ? "relative" : "absolute", tolerances[t],
+                100.0 * bytes / (CODEC_CELLS * sizeof(real) * 12));
+    }
+
+    /* a zero bound keeps every value that is not exactly representable */
+    snapshot_tolerance          = 0.0;
+    snapshot_tolerance_relative = 0;
+
+    const size_t bytes = encode_snapshot( encoded, fields, 12, CODEC_CELLS );
+    decode_snapshot( encoded, bytes, decoded, 12, CODEC_CELLS );
+
+    for (int f = 0; f < 12; f++)
+        TEST_ASSERT_EQUAL_MEMORY( fields[f], decoded[f], CODEC_CELLS * sizeof(real) );
+
+    free( encoded );
+    for (int f = 0; f < 12; f++)
+        free( decoded[f] );
+}
+
+/*
+ * Correlates a forward and a backward wavefield at every snapshot, as the
+ * imaging condition does, with the forward snapshots going through the raw
+ * and the selected codec. Returns the relative L2 difference of both
+ * gradients and the encoded size of the snapshots relative to the raw one.
+ */
+static double gradient_error( double *ratio )
+{
+    const int  nsnapshots = 4;
+    const int  stacki     = 2;
+    const real dt         = 0.001;
+
+    real* fwd[12];
+    real* bwd[12];
+    real* state[STATE_FIELDS];
+
+    snapshot_fields( &v_ref, fwd );
+    snapshot_fields( &v_cal, bwd );
+
+    /* same initial wavefields for every codec */
+    srand( 7 );
+
+    state_fields( &v_ref, &s_ref, state );
+    for (int f = 0; f < STATE_FIELDS; f++) init_array( state[f], nelems );
+
+    state_fields( &v_cal, &s_cal, state );
+    for (int f = 0; f < STATE_FIELDS; f++) init_array( state[f], nelems );
+
+    const size_t    bound    = encoded_snapshot_bound( 12, nelems );
+    unsigned char **encoded  = (unsigned char**) malloc( nsnapshots * sizeof(unsigned char*) );
+    real          **raw      = (real**) malloc( nsnapshots * sizeof(real*) );
+    size_t         *bytes    = (size_t*) malloc( nsnapshots * sizeof(size_t) );
+    size_t          total    = 0;
+
+    /* forward pass */
+    for (int k = 0; k < nsnapshots; k++)
+    {
+        advance_shot( v_ref, s_ref, c_ref, rho_ref, stacki, dt, 1.0, 1.0, 1.0,
+                      0, dimmz, 0, dimmx, 0, dimmy, dimmz, dimmx, NULL );
+
+        raw[k]     = (real*) malloc( nelems * sizeof(real) * 12 );
+        encoded[k] = (unsigned char*) malloc( bound );
+
+        stage_fields( raw[k], fwd, 12, nelems, 1 );
+        bytes[k] = encode_snapshot( encoded[k], fwd, 12, nelems );
+        total   += bytes[k];
+    }
+
+    real* gradient_raw   = (real*) calloc( nelems, sizeof(real) );
+    real* gradient_codec = (real*) calloc( nelems, sizeof(real) );
+
+    /* backward pass */
+    for (int k = nsnapshots - 1; k >= 0; k--)
+    {
+        advance_shot( v_cal, s_cal, c_ref, rho_ref, stacki, dt, 1.0, 1.0, 1.0,
+                      0, dimmz, 0, dimmx, 0, dimmy, dimmz, dimmx, NULL );
+
+        decode_snapshot( encoded[k], bytes[k], fwd, 12, nelems );
+
+        for (int f = 0; f < 12; f++)
+            for (integer i = 0; i < nelems; i++)
+            {
+                gradient_raw  [i] += raw[k][f * nelems + i] * bwd[f][i];
+                gradient_codec[i] += fwd[f][i]              * bwd[f][i];
+            }
+    }
+
+    double difference = 0.0, norm = 0.0;
+    for (integer i = 0; i < nelems; i++)
+    {
+        difference += (gradient_codec[i] - gradient_raw[i]) * (gradient_codec[i] - gradient_raw[i]);
+        norm       += gradient_raw[i] * gradient_raw[i];
+    }
+
+    *ratio = (double) total / (nsnapshots * nelems * sizeof(real) * 12);
+
+    for (int k = 0; k < nsnapshots; k++)
+    {
+        free( raw[k] );
+        free( encoded[k] );
+    }
+    free( raw );
+    free( encoded );
+    free( bytes );
+    free( gradient_raw );
+    free( gradient_codec );
+
+    return sqrt( difference / norm );
+}
+
+TEST(codec, gradient_effect)
+{
+    double ratio;
+
+    snapshot_codec              = LOSSY_CODEC;
+    snapshot_tolerance          = 1e-4;
+    snapshot_tolerance_relative = 1;
+
+    const double error = gradient_error( &ratio );
+
+    fprintf(stdout, "\nlossy rel:1e-4: gradient relative L2 error %e with snapshots at %.1f%% of their raw size",
+            error, 100.0 * ratio);
+
+    /* each snapshot value is off by at most 1e-4 of its field's magnitude */
+    TEST_ASSERT_TRUE( error > 0.0 );
+    TEST_ASSERT_TRUE( error < 1e-3 );
+}
+
+/*
+ * Conversions of the 16 bit codecs: rounding to nearest even, special values
+ * and the largest relative error of the values the snapshots hold.
+ */
+TEST(codec, half_precision_conversions)
+{
+    /* exactly representable values, halfway cases round to even */
+    TEST_ASSERT_EQUAL_HEX16( 0x3C00, float_to_half( 1.0f ) );
+    TEST_ASSERT_EQUAL_HEX16( 0xC000, float_to_half( -2.0f ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x3C00, float_to_half( 1.0f + 1.0f / 2048 ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x3C02, float_to_half( 1.0f + 3.0f / 2048 ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x7BFF, float_to_half( 65504.f ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x0001, float_to_half( 5.9604645e-8f ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x8000, float_to_half( -0.0f ) );
+
+    /* overflow, infinities and NaN */
+    TEST_ASSERT_EQUAL_HEX16( 0x7C00, float_to_half( 1e5f ) );
+    TEST_ASSERT_EQUAL_HEX16( 0xFC00, float_to_half( -INFINITY ) );
+    TEST_ASSERT_TRUE( isnan( half_to_float( float_to_half( NAN ) ) ) );
+    TEST_ASSERT_TRUE( isinf( half_to_float( 0x7C00 ) ) );
+
+    TEST_ASSERT_EQUAL_FLOAT( 5.9604645e-8f, half_to_float( 0x0001 ) );
+    TEST_ASSERT_EQUAL_FLOAT( 65504.f,       half_to_float( 0x7BFF ) );
+
+    TEST_ASSERT_EQUAL_HEX16( 0x3F80, float_to_bf16( 1.0f ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x3F80, float_to_bf16( 1.0f + 1.0f / 256 ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x3F82, float_to_bf16( 1.0f + 3.0f / 256 ) );
+    TEST_ASSERT_EQUAL_HEX16( 0x7F80, float_to_bf16( INFINITY ) );
+    TEST_ASSERT_TRUE( isnan( bf16_to_float( float_to_bf16( NAN ) ) ) );
+    /* bf16 keeps the float range */
+    TEST_ASSERT_FLOAT_WITHIN( 1e30f / 256, 1e30f, bf16_to_float( float_to_bf16( 1e30f ) ) );
+
+    /* half an ulp of the 11 and 8 significant bits */
+    for (int i = 1; i < 100000; i++)
+    {
+        const float x = (i % 2 ? 1 : -1) * i * 0.37f;
+
+        TEST_ASSERT_TRUE( fabsf( half_to_float( float_to_half( x ) ) - x ) <= fabsf( x ) / 2048 );
+        TEST_ASSERT_TRUE( fabsf( bf16_to_float( float_to_bf16( x ) ) - x ) <= fabsf( x ) / 256 );
+    }
+}
+
+/*
+ * Regression of the fp16 and bf16 snapshots against the float path: size of
+ * the snapshots and effect on the gradient.
+ */
+TEST(codec, half_precision_snapshots)
+{
+    const snapshot_codec_t codecs[] = { FP16_CODEC, BF16_CODEC };
+    const char*            names [] = { "fp16", "bf16" };
+    const double           limits[] = { 1e-3, 1e-2 };
+
+    for (int c = 0; c < 2; c++)
+    {
+        double ratio;
+
+        snapshot_codec = codecs[c];
+
+        const double error = gradient_error( &ratio );
+
+        fprintf(stdout, "\n%s: gradient relative L2 error %e with snapshots at %.1f%% of their raw size",
+                names[c], error, 100.0 * ratio);
+
+        TEST_ASSERT_EQUAL_FLOAT( 0.5, ratio );
+        TEST_ASSERT_TRUE( error > 0.0 );
+        TEST_ASSERT_TRUE( error < limits[c] );
+    }
+}
+
+TEST_GROUP_RUNNER(codec)
+{
+    RUN_TEST_CASE(codec, raw_roundtrip);
+    RUN_TEST_CASE(codec, error_bound);
+    RUN_TEST_CASE(codec, gradient_effect);
+    RUN_TEST_CASE(codec, half_precision_conversions);
+    RUN_TEST_CASE(codec, half_precision_snapshots);
+}
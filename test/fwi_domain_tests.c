@@ -0,0 +1,129 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_domain.h"
+
+TEST_GROUP(domain);
+
+TEST_SETUP(domain)
+{
+}
+
+TEST_TEAR_DOWN(domain)
+{
+    requested_process_grid.z = 0;
+    requested_process_grid.x = 0;
+    requested_process_grid.y = 0;
+}
+
+static void assert_grid( const int z, const int x, const int y, const process_grid_t grid )
+{
+    TEST_ASSERT_EQUAL_INT( z, grid.z );
+    TEST_ASSERT_EQUAL_INT( x, grid.x );
+    TEST_ASSERT_EQUAL_INT( y, grid.y );
+}
+
+TEST(domain, halo_bytes)
+{
+    const process_grid_t serial = {1, 1, 1};
+    const process_grid_t slabs  = {1, 1, 2};
+    const process_grid_t pencil = {1, 3, 3};
+
+    TEST_ASSERT_EQUAL_UINT64( 0, halo_bytes_per_rank( serial, 24, 24, 48 ) );
+
+    /* one face of HALO full planes, sent and received, 36 fields */
+    TEST_ASSERT_EQUAL_UINT64( 2 * HALO * 24 * 24 * 36 * sizeof(real),
+                              halo_bytes_per_rank( slabs, 24, 24, 48 ) );
+
+    /* the middle rank has two faces along x and y, of its 16 computed cells */
+    TEST_ASSERT_EQUAL_UINT64( 2 * (2 * HALO * 24 * 16 + 2 * HALO * 16 * 24) * 36 * sizeof(real),
+                              halo_bytes_per_rank( pencil, 24, 56, 56 ) );
+}
+
+TEST(domain, best_grid)
+{
+    /* thin volumes keep the y slabs */
+    assert_grid( 1, 1, 4, best_process_grid( 4, 48, 48, 400, 0 ) );
+
+    /* cubes split y and x evenly */
+    assert_grid( 1, 4, 4, best_process_grid( 16, 200, 200, 200, 0 ) );
+
+    /* and z too when it is allowed */
+    assert_grid( 2, 2, 2, best_process_grid( 8, 200, 200, 200, 1 ) );
+    TEST_ASSERT_EQUAL_INT( 1, best_process_grid( 8, 200, 200, 200, 0 ).z );
+
+    /* a rank computes at least 2*HALO planes along the split axes */
+    const process_grid_t grid = best_process_grid( 8, 200, 200, 40, 0 );
+
+    TEST_ASSERT_EQUAL_INT( 8, grid.z * grid.x * grid.y );
+    TEST_ASSERT_TRUE( grid.y == 1 || (40 - 2*HALO) / grid.y >= 2*HALO );
+}
+
+TEST(domain, single_rank)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("decompose_domain needs MPI_Init");
+#else
+    const process_grid_t scheduled = {1, 1, 1};
+
+    /* a grid for another number of ranks is ignored */
+    requested_process_grid.z = 1;
+    requested_process_grid.x = 2;
+    requested_process_grid.y = 2;
+
+    domain_t d;
+    decompose_domain( &d, 24, 32, 40, scheduled );
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        TEST_ASSERT_EQUAL_INT( 1, d.ranks[axis] );
+        TEST_ASSERT_EQUAL_INT( 0, d.offset[axis] );
+        TEST_ASSERT_EQUAL_INT( -1, d.neighbour[axis][0] );
+        TEST_ASSERT_EQUAL_INT( -1, d.neighbour[axis][1] );
+    }
+
+    TEST_ASSERT_EQUAL_INT( 24, d.size[AXIS_Z] );
+    TEST_ASSERT_EQUAL_INT( 32, d.size[AXIS_X] );
+    TEST_ASSERT_EQUAL_INT( 40, d.size[AXIS_Y] );
+    TEST_ASSERT_EQUAL_INT( 24 * 32 * 40, domain_cells( &d ) );
+
+    release_domain( &d );
+#endif
+}
+
+TEST_GROUP_RUNNER(domain)
+{
+    RUN_TEST_CASE(domain, halo_bytes);
+    RUN_TEST_CASE(domain, best_grid);
+    RUN_TEST_CASE(domain, single_rank);
+}
@@ -0,0 +1,208 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+
+#include <sys/mman.h>
+
+/* three staging chunks and a tail that is not a whole page */
+#define IO_TEST_CHUNK (4 * 4096)
+#define IO_TEST_BYTES (3 * IO_TEST_CHUNK + 1000)
+
+static char fname[] = "/tmp/fwi-io-XXXXXX";
+
+static unsigned char *data;
+static unsigned char *copy;
+
+TEST_GROUP(io);
+
+TEST_SETUP(io)
+{
+    strcpy( fname + strlen(fname) - 6, "XXXXXX" );
+    const int fd = mkstemp( fname );
+    TEST_ASSERT_TRUE( fd != -1 );
+    close( fd );
+
+    /* one extra page to offset the unaligned transfers */
+    data = (unsigned char*) __malloc( PAGE_BYTES, IO_TEST_BYTES + PAGE_BYTES );
+    copy = (unsigned char*) __malloc( PAGE_BYTES, IO_TEST_BYTES + PAGE_BYTES );
+
+    for (int i = 0; i < IO_TEST_BYTES + (int) PAGE_BYTES; i++)
+        data[i] = (unsigned char) (i * 7 + i / 251);
+
+    io_chunk_bytes = IO_TEST_CHUNK;
+}
+
+TEST_TEAR_DOWN(io)
+{
+    remove( fname );
+
+    __free( data );
+    __free( copy );
+
+    io_backend     = STDIO_BACKEND;
+    io_chunk_bytes = 4 * 1024 * 1024;
+    io_depth       = 4;
+}
+
+/* writes data + shift with 'writer' and reads it back whole with 'reader' */
+static void roundtrip( const io_backend_t writer, const io_backend_t reader, const size_t shift )
+{
+    io_backend = writer;
+    io_file_t *file = io_open( fname, "wb", __FILE__, __LINE__ );
+    /* a partial chunk first, so the rest does not start at a chunk boundary */
+    io_write( file, data + shift, 100 );
+    io_write( file, data + shift + 100, IO_TEST_BYTES - 100 );
+    io_close( file );
+
+    io_backend = reader;
+    file = io_open( fname, "rb", __FILE__, __LINE__ );
+    TEST_ASSERT_EQUAL_UINT64( IO_TEST_BYTES, io_size( file ) );
+
+    memset( copy, 0, IO_TEST_BYTES + PAGE_BYTES );
+    io_read( file, copy + shift, IO_TEST_BYTES );
+    io_close( file );
+
+    TEST_ASSERT_EQUAL_MEMORY( data + shift, copy + shift, IO_TEST_BYTES );
+}
+
+TEST(io, direct_roundtrip)
+{
+    roundtrip( DIRECT_BACKEND, DIRECT_BACKEND, 0 );
+    roundtrip( DIRECT_BACKEND, DIRECT_BACKEND, ALIGN_REAL );
+}
+
+TEST(io, backends_interoperate)
+{
+    roundtrip( STDIO_BACKEND , DIRECT_BACKEND, ALIGN_REAL );
+    roundtrip( DIRECT_BACKEND, STDIO_BACKEND , 0 );
+}
+
+/* fewer slots than chunks, so they are reused while others are in flight */
+TEST(io, uring_roundtrip)
+{
+    if ( !io_uring_supported() )
+        TEST_IGNORE_MESSAGE("io_uring is not available");
+
+    io_depth = 2;
+
+    roundtrip( URING_BACKEND, URING_BACKEND , 0 );
+    roundtrip( URING_BACKEND, URING_BACKEND , ALIGN_REAL );
+    roundtrip( URING_BACKEND, STDIO_BACKEND , ALIGN_REAL );
+    roundtrip( STDIO_BACKEND, URING_BACKEND , 0 );
+}
+
+/*
+ * Writes from a mapping that is overwritten and unmapped before the file is
+ * closed, as write_snapshot frees its encoded buffer: the chunks sent from
+ * it must be written by the time io_write returns.
+ */
+static void write_and_unmap( const io_backend_t writer )
+{
+    const size_t   bytes  = IO_TEST_BYTES + PAGE_BYTES;
+    unsigned char *buffer = (unsigned char*) mmap( NULL, bytes, PROT_READ | PROT_WRITE,
+                                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    TEST_ASSERT_TRUE( buffer != MAP_FAILED );
+
+    memcpy( buffer, data, IO_TEST_BYTES );
+
+    io_backend = writer;
+    io_file_t *file = io_open( fname, "wb", __FILE__, __LINE__ );
+    io_write( file, buffer, IO_TEST_BYTES );
+
+    memset( buffer, 0xff, IO_TEST_BYTES );
+    munmap( buffer, bytes );
+
+    io_close( file );
+
+    io_backend = STDIO_BACKEND;
+    file = io_open( fname, "rb", __FILE__, __LINE__ );
+    memset( copy, 0, IO_TEST_BYTES );
+    io_read( file, copy, IO_TEST_BYTES );
+    io_close( file );
+
+    TEST_ASSERT_EQUAL_MEMORY( data, copy, IO_TEST_BYTES );
+}
+
+TEST(io, buffer_reusable_after_write)
+{
+    write_and_unmap( DIRECT_BACKEND );
+
+    if ( io_uring_supported() )
+    {
+        io_depth = 2;
+        write_and_unmap( URING_BACKEND );
+    }
+}
+
+/* the model loader reads the slab of a rank from the middle of the file */
+static void seek_and_read( const io_backend_t reader )
+{
+    const size_t offsets[] = { 0, 12345, IO_TEST_CHUNK, IO_TEST_BYTES - 10 };
+
+    io_backend = STDIO_BACKEND;
+    io_file_t *file = io_open( fname, "wb", __FILE__, __LINE__ );
+    io_write( file, data, IO_TEST_BYTES );
+    io_close( file );
+
+    io_backend = reader;
+
+    for (int k = 0; k < 4; k++)
+    {
+        const size_t bytes = IO_TEST_BYTES - offsets[k];
+
+        file = io_open( fname, "rb", __FILE__, __LINE__ );
+        io_seek( file, offsets[k] );
+        io_read( file, copy, bytes );
+        io_close( file );
+
+        TEST_ASSERT_EQUAL_MEMORY( data + offsets[k], copy, bytes );
+    }
+}
+
+TEST(io, direct_seek)
+{
+    seek_and_read( DIRECT_BACKEND );
+
+    if ( io_uring_supported() )
+        seek_and_read( URING_BACKEND );
+}
+
+TEST_GROUP_RUNNER(io)
+{
+    RUN_TEST_CASE(io, direct_roundtrip);
+    RUN_TEST_CASE(io, backends_interoperate);
+    RUN_TEST_CASE(io, uring_roundtrip);
+    RUN_TEST_CASE(io, direct_seek);
+    RUN_TEST_CASE(io, buffer_reusable_after_write);
+}
@@ -224,9 +224,88 @@ TEST(kernel, set_array_to_constant)
     TEST_ASSERT_EQUAL_FLOAT_ARRAY( array_ref, array_cal, NELEMS );
 }
 
+TEST(kernel, shot_arena)
+{
+    coeff_t c;
+    s_t     s;
+    v_t     v;
+    real    *rho;
+
+    /* both arenas of the setup are in use, so this shot maps a new one */
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c, &s, &v, &rho);
+
+    real* fields[] = { c.c11, c.c66, v.tl.u, v.br.w, s.tl.zz, s.br.yy, rho };
+    const int nfields = sizeof(fields) / sizeof(fields[0]);
+
+    for (int i = 0; i < nfields; i++)
+        for (int j = i+1; j < nfields; j++)
+        {
+            /* fields do not overlap and start at different offsets within a page */
+            TEST_ASSERT_TRUE( fields[i] + nelems <= fields[j] || fields[j] + nelems <= fields[i] );
+            TEST_ASSERT_TRUE( ((size_t) fields[i]) % PAGE_BYTES != ((size_t) fields[j]) % PAGE_BYTES );
+        }
+
+    set_array_to_constant(rho, 1.0f, nelems);
+
+    real* first = c.c11;
+    free_memory_shot(&c, &s, &v, &rho);
+
+    /* next shot with the same dimensions reuses the arena */
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c, &s, &v, &rho);
+    TEST_ASSERT_EQUAL_PTR( first, c.c11 );
+    free_memory_shot(&c, &s, &v, &rho);
+}
+
+TEST(kernel, temporal_blocking)
+{
+    const int      timesteps = 7;
+    const real     dt  = 1.0;
+    const real     dzi = 1.0;
+    const real     dxi = 1.0;
+    const real     dyi = 1.0;
+
+    /* REFERENCE: plain time loop */
+    time_block_steps = 1;
+
+    propagate_shot(FWMODEL, v_ref, s_ref, c_ref, rho_ref,
+            timesteps, timesteps, dt, dzi, dxi, dyi,
+            0, dimmz, 0, dimmx, 0, dimmy,
+            2, NULL, NULL, NULL,
+            dimmz, dimmx, dimmy);
+
+    /* blocks of 3 steps with tiles that do not divide the volume */
+    const tile_t tile = {8, 4, 6};
+
+    time_block_steps = 3;
+    tiling_mode      = FIXED_TILING;
+    propagator_tile  = tile;
+
+    propagate_shot(FWMODEL, v_cal, s_cal, c_ref, rho_ref,
+            timesteps, timesteps, dt, dzi, dxi, dyi,
+            0, dimmz, 0, dimmx, 0, dimmy,
+            2, NULL, NULL, NULL,
+            dimmz, dimmx, dimmy);
+
+    time_block_steps = 1;
+    tiling_mode      = NO_TILING;
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.w, v_cal.tl.w, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tr.u, v_cal.tr.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.bl.v, v_cal.bl.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.br.w, v_cal.br.w, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.xx, s_cal.br.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.yz, s_cal.tr.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.xy, s_cal.tl.xy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.bl.zz, s_cal.bl.zz, nelems );
+}
+
 ////// TESTS RUNNER //////
 TEST_GROUP_RUNNER(kernel)
 {
     RUN_TEST_CASE(kernel, set_array_to_random_real);
     RUN_TEST_CASE(kernel, set_array_to_constant);
+
+    RUN_TEST_CASE(kernel, shot_arena);
+    RUN_TEST_CASE(kernel, temporal_blocking);
 }
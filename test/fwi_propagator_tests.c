@@ -599,6 +599,54 @@ TEST(propagator, velocity_propagator)
     CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.w, v_cal.tl.w, nelems );
 }
 
+TEST(propagator, velocity_propagator_fused)
+{
+    const real     dt  = 1.0;
+    const real     dzi = 1.0;
+    const real     dxi = 1.0;
+    const real     dyi = 1.0;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  ny0 = HALO;
+    const integer  nyf = dimmy-HALO;
+    const phase_t  phase = TWO;
+
+    // REFERENCE CALCULATION
+    {
+        velocity_propagator(v_ref, s_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+    ///////////////////////////////////////
+
+
+    {
+        velocity_propagator_fused(v_cal, s_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.bl.u, v_cal.bl.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.bl.v, v_cal.bl.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.bl.w, v_cal.bl.w, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.br.u, v_cal.br.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.br.v, v_cal.br.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.br.w, v_cal.br.w, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tr.u, v_cal.tr.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tr.v, v_cal.tr.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tr.w, v_cal.tr.w, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.u, v_cal.tl.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.v, v_cal.tl.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.w, v_cal.tl.w, nelems );
+}
+
 TEST(propagator, stress_update)
 {
     const real dt = 1.0;
@@ -1193,6 +1241,453 @@ TEST(propagator, stress_propagator)
     CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xy, s_cal.tr.xy, nelems );
 }
 
+TEST(propagator, stress_propagator_fused)
+{
+    const real     dt  = 1.0;
+    const real     dzi = 1.0;
+    const real     dxi = 1.0;
+    const real     dyi = 1.0;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  ny0 = HALO;
+    const integer  nyf = dimmy-HALO;
+    const phase_t  phase = TWO;
+
+    // REFERENCE CALCULATION
+    {
+        stress_propagator(s_ref, v_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+    ///////////////////////////////////////
+
+
+    {
+        stress_propagator_fused(s_cal, v_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.bl.xx, s_cal.bl.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.bl.yy, s_cal.bl.yy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.bl.zz, s_cal.bl.zz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.bl.yz, s_cal.bl.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.bl.xz, s_cal.bl.xz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.bl.xy, s_cal.bl.xy, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.xx, s_cal.br.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.yy, s_cal.br.yy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.zz, s_cal.br.zz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.yz, s_cal.br.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.xz, s_cal.br.xz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.xy, s_cal.br.xy, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.xx, s_cal.tl.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.yy, s_cal.tl.yy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.zz, s_cal.tl.zz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.yz, s_cal.tl.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.xz, s_cal.tl.xz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.xy, s_cal.tl.xy, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xx, s_cal.tr.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.yy, s_cal.tr.yy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.zz, s_cal.tr.zz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.yz, s_cal.tr.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xz, s_cal.tr.xz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xy, s_cal.tr.xy, nelems );
+}
+
+TEST(propagator, coeff_cache)
+{
+    const real     dt  = 1.0;
+    const real     dzi = 1.0;
+    const real     dxi = 1.0;
+    const real     dyi = 1.0;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  ny0 = HALO;
+    const integer  nyf = dimmy-HALO;
+    const phase_t  phase = TWO;
+
+    // REFERENCE CALCULATION (one full time step)
+    {
+        velocity_propagator(v_ref, s_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+
+        stress_propagator(s_ref, v_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+    ///////////////////////////////////////
+
+    coeff_t c_cached = c_ref;
+    build_coeff_cache(dimmz, dimmx, dimmy, &c_cached, rho_ref, FULL_CACHE);
+
+    TEST_ASSERT_NOT_NULL( c_cached.cache );
+
+    {
+        velocity_propagator_fused(v_cal, s_cal, c_cached, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+
+        stress_propagator_fused(s_cal, v_cal, c_cached, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+
+    free_coeff_cache(&c_cached);
+
+    TEST_ASSERT_NULL( c_cached.cache );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.bl.u, v_cal.bl.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.br.v, v_cal.br.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tr.w, v_cal.tr.w, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.u, v_cal.tl.u, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.xx, s_cal.br.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.yz, s_cal.br.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.zz, s_cal.tl.zz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.xy, s_cal.tl.xy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.yy, s_cal.tr.yy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xz, s_cal.tr.xz, nelems );
+}
+
+TEST(propagator, auto_tile_size)
+{
+    const size_t cache_bytes = 1 << 20;
+
+    /* short columns are kept whole */
+    tile_t tile = auto_tile_size(64, 600, cache_bytes);
+
+    TEST_ASSERT_EQUAL_INT( 64, tile.z );
+    TEST_ASSERT_TRUE( tile.x >= 1 && tile.x <= 600 );
+    TEST_ASSERT_EQUAL_INT( 0, tile.y );
+
+    /* long columns are split in even, vector friendly blocks */
+    tile = auto_tile_size(600, 600, cache_bytes);
+
+    TEST_ASSERT_TRUE( tile.z < 600 );
+    TEST_ASSERT_EQUAL_INT( 0, tile.z % 16 );
+    TEST_ASSERT_TRUE( tile.x >= 1 );
+
+    /* tiles never exceed the iteration space */
+    tile = auto_tile_size(16, 2, cache_bytes);
+
+    TEST_ASSERT_EQUAL_INT( 16, tile.z );
+    TEST_ASSERT_EQUAL_INT(  2, tile.x );
+}
+
+TEST(propagator, tiled_traversal)
+{
+    const real     dt  = 1.0;
+    const real     dzi = 1.0;
+    const real     dxi = 1.0;
+    const real     dyi = 1.0;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  ny0 = HALO;
+    const integer  nyf = dimmy-HALO;
+    const phase_t  phase = TWO;
+
+    // REFERENCE CALCULATION (one full time step)
+    {
+        velocity_propagator(v_ref, s_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+
+        stress_propagator(s_ref, v_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+    ///////////////////////////////////////
+
+    /* tiles that do not divide the iteration space */
+    const tile_t tile = {5, 3, 2};
+
+    tiling_mode     = FIXED_TILING;
+    propagator_tile = tile;
+    {
+        velocity_propagator_fused(v_cal, s_cal, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+
+        stress_propagator_fused(s_cal, v_cal, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+    tiling_mode     = NO_TILING;
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.bl.u, v_cal.bl.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.br.v, v_cal.br.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tr.w, v_cal.tr.w, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.u, v_cal.tl.u, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.xx, s_cal.br.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.yz, s_cal.br.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.zz, s_cal.tl.zz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.xy, s_cal.tl.xy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.yy, s_cal.tr.yy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xz, s_cal.tr.xz, nelems );
+}
+
+#if !defined(_OPENACC) && !defined(USE_CUDA)
+typedef void (*vcell_kernel_t)(real*, const real*, const real*, const real*, const real*,
+                               real, real, real, real,
+                               integer, integer, integer, integer, integer, integer,
+                               offset_t, offset_t, offset_t, integer, integer, phase_t);
+
+typedef void (*vcell_spec_kernel_t)(real*, const real*, const real*, const real*, const real*,
+                                    real, real, real, real,
+                                    integer, integer, integer, integer, integer, integer,
+                                    integer, integer);
+
+/*
+ * Runs a specialised velocity kernel and the generic one, with the offsets
+ * velocity_propagator gives that cell type, on the same fields: the
+ * results must be bit for bit the same (-std=c99 keeps GCC from fusing
+ * the multiply-adds of only one of them).
+ */
+static void check_vcell_spec(vcell_kernel_t generic, vcell_spec_kernel_t spec,
+                             real* vref, real* vcal,
+                             const real* szptr, const real* sxptr, const real* syptr,
+                             const offset_t SZ, const offset_t SX, const offset_t SY)
+{
+    const real     dt  = 0.5;
+    const real     dzi = 1.5;
+    const real     dxi = 2.0;
+    const real     dyi = 0.75;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  ny0 = HALO;
+    const integer  nyf = dimmy-HALO;
+    const phase_t  phase = TWO;
+
+    generic(vref, szptr, sxptr, syptr, rho_ref,
+            dt, dzi, dxi, dyi,
+            nz0, nzf, nx0, nxf, ny0, nyf,
+            SZ, SX, SY, dimmz, dimmx, phase);
+
+    spec(vcal, szptr, sxptr, syptr, rho_ref,
+         dt, dzi, dxi, dyi,
+         nz0, nzf, nx0, nxf, ny0, nyf,
+         dimmz, dimmx);
+
+    TEST_ASSERT_EQUAL_MEMORY( vref, vcal, nelems * sizeof(real) );
+}
+
+TEST(propagator, compute_component_vcell_TL_spec)
+{
+    check_vcell_spec(compute_component_vcell_TL, compute_component_vcell_TL_spec,
+                     v_ref.tl.w, v_cal.tl.w, s_ref.bl.zz, s_ref.tr.xz, s_ref.tl.yz,
+                     back_offset, back_offset, forw_offset);
+}
+
+TEST(propagator, compute_component_vcell_TR_spec)
+{
+    check_vcell_spec(compute_component_vcell_TR, compute_component_vcell_TR_spec,
+                     v_ref.tr.w, v_cal.tr.w, s_ref.br.zz, s_ref.tl.xz, s_ref.tr.yz,
+                     back_offset, forw_offset, back_offset);
+}
+
+TEST(propagator, compute_component_vcell_BL_spec)
+{
+    check_vcell_spec(compute_component_vcell_BL, compute_component_vcell_BL_spec,
+                     v_ref.bl.w, v_cal.bl.w, s_ref.tl.zz, s_ref.br.xz, s_ref.bl.yz,
+                     forw_offset, back_offset, back_offset);
+}
+
+TEST(propagator, compute_component_vcell_BR_spec)
+{
+    check_vcell_spec(compute_component_vcell_BR, compute_component_vcell_BR_spec,
+                     v_ref.br.w, v_cal.br.w, s_ref.tr.zz, s_ref.bl.xz, s_ref.br.yz,
+                     forw_offset, forw_offset, forw_offset);
+}
+
+typedef void (*scell_kernel_t)(s_t, point_v_t, point_v_t, point_v_t, coeff_t,
+                               real, real, real, real,
+                               integer, integer, integer, integer, integer, integer,
+                               offset_t, offset_t, offset_t, integer, integer, phase_t);
+
+typedef void (*scell_spec_kernel_t)(s_t, point_v_t, point_v_t, point_v_t, coeff_t,
+                                    real, real, real, real,
+                                    integer, integer, integer, integer, integer, integer,
+                                    integer, integer);
+
+static void assert_same_stresses(const point_s_t ref, const point_s_t cal)
+{
+    TEST_ASSERT_EQUAL_MEMORY( ref.zz, cal.zz, nelems * sizeof(real) );
+    TEST_ASSERT_EQUAL_MEMORY( ref.xz, cal.xz, nelems * sizeof(real) );
+    TEST_ASSERT_EQUAL_MEMORY( ref.yz, cal.yz, nelems * sizeof(real) );
+    TEST_ASSERT_EQUAL_MEMORY( ref.xx, cal.xx, nelems * sizeof(real) );
+    TEST_ASSERT_EQUAL_MEMORY( ref.xy, cal.xy, nelems * sizeof(real) );
+    TEST_ASSERT_EQUAL_MEMORY( ref.yy, cal.yy, nelems * sizeof(real) );
+}
+
+/*
+ * Stress counterpart of check_vcell_spec: the velocity nodes come from
+ * v_ref and every stress cell is compared, so an update that lands in the
+ * wrong cell is caught too.
+ */
+static void check_scell_spec(scell_kernel_t generic, scell_spec_kernel_t spec,
+                             const point_v_t vnode_z, const point_v_t vnode_x, const point_v_t vnode_y,
+                             const offset_t SZ, const offset_t SX, const offset_t SY)
+{
+    const real     dt  = 0.5;
+    const real     dzi = 1.5;
+    const real     dxi = 2.0;
+    const real     dyi = 0.75;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  ny0 = HALO;
+    const integer  nyf = dimmy-HALO;
+    const phase_t  phase = TWO;
+
+    generic(s_ref, vnode_z, vnode_x, vnode_y, c_ref,
+            dt, dzi, dxi, dyi,
+            nz0, nzf, nx0, nxf, ny0, nyf,
+            SZ, SX, SY, dimmz, dimmx, phase);
+
+    spec(s_cal, vnode_z, vnode_x, vnode_y, c_ref,
+         dt, dzi, dxi, dyi,
+         nz0, nzf, nx0, nxf, ny0, nyf,
+         dimmz, dimmx);
+
+    assert_same_stresses( s_ref.tl, s_cal.tl );
+    assert_same_stresses( s_ref.tr, s_cal.tr );
+    assert_same_stresses( s_ref.bl, s_cal.bl );
+    assert_same_stresses( s_ref.br, s_cal.br );
+}
+
+TEST(propagator, compute_component_scell_BR_spec)
+{
+    check_scell_spec(compute_component_scell_BR, compute_component_scell_BR_spec,
+                     v_ref.tr, v_ref.bl, v_ref.br, forw_offset, back_offset, back_offset);
+}
+
+TEST(propagator, compute_component_scell_BL_spec)
+{
+    check_scell_spec(compute_component_scell_BL, compute_component_scell_BL_spec,
+                     v_ref.tl, v_ref.br, v_ref.bl, forw_offset, back_offset, forw_offset);
+}
+
+TEST(propagator, compute_component_scell_TR_spec)
+{
+    check_scell_spec(compute_component_scell_TR, compute_component_scell_TR_spec,
+                     v_ref.br, v_ref.tl, v_ref.tr, back_offset, forw_offset, forw_offset);
+}
+
+TEST(propagator, compute_component_scell_TL_spec)
+{
+    check_scell_spec(compute_component_scell_TL, compute_component_scell_TL_spec,
+                     v_ref.bl, v_ref.tr, v_ref.tl, back_offset, back_offset, back_offset);
+}
+#endif /* host kernels */
+
+#if defined(USE_SIMD_KERNELS)
+/*
+ * Runs one full time step with the vectorized fused engines for 'isa'
+ * and compares it against the split (scalar) engines.
+ */
+static void check_simd_engines(const simd_isa_t isa, const cache_mode_t mode)
+{
+    const real     dt  = 1.0;
+    const real     dzi = 1.0;
+    const real     dxi = 1.0;
+    const real     dyi = 1.0;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  ny0 = HALO;
+    const integer  nyf = dimmy-HALO;
+    const phase_t  phase = TWO;
+
+    if ( isa > detect_simd_isa() )
+        TEST_IGNORE_MESSAGE("ISA not supported by this CPU");
+
+    // REFERENCE CALCULATION (one full time step)
+    {
+        velocity_propagator(v_ref, s_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+
+        stress_propagator(s_ref, v_ref, c_ref, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+    ///////////////////////////////////////
+
+    coeff_t c_simd = c_ref;
+    build_coeff_cache(dimmz, dimmx, dimmy, &c_simd, rho_ref, mode);
+
+    simd_isa = isa;
+    {
+        velocity_propagator_fused(v_cal, s_cal, c_simd, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+
+        stress_propagator_fused(s_cal, v_cal, c_simd, rho_ref,
+                dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, ny0, nyf,
+                dimmz, dimmx, phase);
+    }
+    simd_isa = SIMD_NONE;
+
+    free_coeff_cache(&c_simd);
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.bl.u, v_cal.bl.u, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.br.v, v_cal.br.v, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tr.w, v_cal.tr.w, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( v_ref.tl.u, v_cal.tl.u, nelems );
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.xx, s_cal.br.xx, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.br.yz, s_cal.br.yz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.zz, s_cal.tl.zz, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tl.xy, s_cal.tl.xy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.yy, s_cal.tr.yy, nelems );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xz, s_cal.tr.xz, nelems );
+}
+
+TEST(propagator, simd_avx2)
+{
+    check_simd_engines(SIMD_AVX2, NO_CACHE);
+}
+
+TEST(propagator, simd_avx512)
+{
+    check_simd_engines(SIMD_AVX512, NO_CACHE);
+}
+
+TEST(propagator, simd_avx512_coeff_cache)
+{
+    check_simd_engines(SIMD_AVX512, FULL_CACHE);
+}
+#endif /* USE_SIMD_KERNELS */
+
 ////// TESTS RUNNER //////
 TEST_GROUP_RUNNER(propagator)
 {
@@ -1214,6 +1709,7 @@ TEST_GROUP_RUNNER(propagator)
     RUN_TEST_CASE(propagator, compute_component_vcell_BL);
 
     RUN_TEST_CASE(propagator, velocity_propagator);
+    RUN_TEST_CASE(propagator, velocity_propagator_fused);
 
     /* stresses related tests */
     RUN_TEST_CASE(propagator, stress_update);
@@ -1234,4 +1730,28 @@ TEST_GROUP_RUNNER(propagator)
     RUN_TEST_CASE(propagator, compute_component_scell_BL);
 
     RUN_TEST_CASE(propagator, stress_propagator);
+    RUN_TEST_CASE(propagator, stress_propagator_fused);
+
+    RUN_TEST_CASE(propagator, coeff_cache);
+
+    RUN_TEST_CASE(propagator, auto_tile_size);
+    RUN_TEST_CASE(propagator, tiled_traversal);
+
+#if !defined(_OPENACC) && !defined(USE_CUDA)
+    RUN_TEST_CASE(propagator, compute_component_vcell_TL_spec);
+    RUN_TEST_CASE(propagator, compute_component_vcell_TR_spec);
+    RUN_TEST_CASE(propagator, compute_component_vcell_BL_spec);
+    RUN_TEST_CASE(propagator, compute_component_vcell_BR_spec);
+
+    RUN_TEST_CASE(propagator, compute_component_scell_BR_spec);
+    RUN_TEST_CASE(propagator, compute_component_scell_BL_spec);
+    RUN_TEST_CASE(propagator, compute_component_scell_TR_spec);
+    RUN_TEST_CASE(propagator, compute_component_scell_TL_spec);
+#endif
+
+#if defined(USE_SIMD_KERNELS)
+    RUN_TEST_CASE(propagator, simd_avx2);
+    RUN_TEST_CASE(propagator, simd_avx512);
+    RUN_TEST_CASE(propagator, simd_avx512_coeff_cache);
+#endif
 }
@@ -0,0 +1,326 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016-2018, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+
+static char folder[] = "/tmp/fwi-snapshot-XXXXXX";
+
+/*
+ * Fills the 12 velocity components with values that only depend on 'n'.
+ */
+static void set_velocity( v_t *v, const int n )
+{
+    real* fields[] = { v->tr.u, v->tr.v, v->tr.w, v->tl.u, v->tl.v, v->tl.w,
+                       v->br.u, v->br.v, v->br.w, v->bl.u, v->bl.v, v->bl.w };
+
+    for (int f = 0; f < 12; f++)
+        for (integer i = 0; i < nelems; i++)
+            fields[f][i] = (real) ((n + 1) * (f + 1)) + (i % 97) / 97.f;
+}
+
+static void assert_equal_velocity( v_t *ref, v_t *cal )
+{
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->tr.u, cal->tr.u, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->tr.v, cal->tr.v, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->tr.w, cal->tr.w, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->tl.u, cal->tl.u, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->tl.v, cal->tl.v, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->tl.w, cal->tl.w, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->br.u, cal->br.u, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->br.v, cal->br.v, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->br.w, cal->br.w, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->bl.u, cal->bl.u, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->bl.v, cal->bl.v, nelems );
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY( ref->bl.w, cal->bl.w, nelems );
+}
+
+
+TEST_GROUP(snapshot);
+
+TEST_SETUP(snapshot)
+{
+    nelems = dimmz * dimmx * dimmy;
+
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c_ref, &s_ref, &v_ref, &rho_ref);
+    alloc_memory_shot(dimmz, dimmx, dimmy, &c_cal, &s_cal, &v_cal, &rho_cal);
+
+    strcpy( folder + strlen(folder) - 6, "XXXXXX" );
+    TEST_ASSERT_NOT_NULL( mkdtemp( folder ) );
+}
+
+TEST_TEAR_DOWN(snapshot)
+{
+    char fname[300];
+
+    for (int n = 0; n < 8; n++)
+    {
+        sprintf(fname, "%s/snapshot.%03d.%05d", folder, 0, n);
+        remove( fname );
+    }
+    sprintf(fname, "%s/snapshots.%03d", folder, 0);
+    remove( fname );
+    rmdir( folder );
+
+    free_memory_shot(&c_ref, &s_ref, &v_ref, &rho_ref);
+    free_memory_shot(&c_cal, &s_cal, &v_cal, &rho_cal);
+}
+
+TEST(snapshot, async_writer)
+{
+#if defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is not enabled");
+#else
+    const int nsnapshots = 5;
+
+    /* more snapshots than staging buffers, so some posts have to wait */
+    snapshot_writer_t *writer = open_snapshot_writer( folder, nelems, 2, NULL );
+    TEST_ASSERT_NOT_NULL( writer );
+
+    for (int n = 0; n < nsnapshots; n++)
+    {
+        set_velocity( &v_ref, n );
+        post_snapshot( writer, n, &v_ref );
+    }
+
+    /* the propagator overwrites the fields as soon as the post returns */
+    set_velocity( &v_ref, -1 );
+
+    close_snapshot_writer( writer );
+
+    for (int n = 0; n < nsnapshots; n++)
+    {
+        set_velocity( &v_ref, n );
+        read_snapshot( folder, n, &v_cal, dimmz, dimmx, dimmy );
+        assert_equal_velocity( &v_ref, &v_cal );
+    }
+#endif
+}
+
+TEST(snapshot, prefetching_reader)
+{
+#if defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is not enabled");
+#else
+    const int nsnapshots = 5;
+
+    for (int n = 0; n < nsnapshots; n++)
+    {
+        set_velocity( &v_ref, n );
+        write_snapshot( folder, n, &v_ref, dimmz, dimmx, dimmy );
+    }
+
+    /* reverse order, as in the backward pass */
+    snapshot_reader_t *reader = open_snapshot_reader( folder, nelems, 2, nsnapshots-1, -1, nsnapshots, NULL );
+    TEST_ASSERT_NOT_NULL( reader );
+
+    for (int n = nsnapshots-1; n >= 0; n--)
+    {
+        set_velocity( &v_ref, n );
+        fetch_snapshot( reader, n, &v_cal );
+        assert_equal_velocity( &v_ref, &v_cal );
+    }
+
+    close_snapshot_reader( reader );
+
+    /* closing before the end of the schedule stops the reader thread */
+    reader = open_snapshot_reader( folder, nelems, 2, nsnapshots-1, -1, nsnapshots, NULL );
+    fetch_snapshot( reader, nsnapshots-1, &v_cal );
+    close_snapshot_reader( reader );
+#endif
+}
+
+TEST(snapshot, container)
+{
+#if defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is not enabled");
+#else
+    const int nsnapshots = 5;
+
+    snapshot_container_t *container = open_snapshot_container( folder, nelems, nsnapshots );
+
+    /* the writer thread appends the snapshots in the order they are posted */
+    snapshot_writer_t *writer = open_snapshot_writer( folder, nelems, 2, container );
+    TEST_ASSERT_NOT_NULL( writer );
+
+    for (int n = nsnapshots-1; n >= 0; n--)
+    {
+        set_velocity( &v_ref, n );
+        post_snapshot( writer, n, &v_ref );
+    }
+    close_snapshot_writer( writer );
+
+    /* in the order they were written, as one stream */
+    snapshot_reader_t *reader = open_snapshot_reader( folder, nelems, 2, nsnapshots-1, -1, nsnapshots, container );
+    TEST_ASSERT_NOT_NULL( reader );
+
+    for (int n = nsnapshots-1; n >= 0; n--)
+    {
+        set_velocity( &v_ref, n );
+        fetch_snapshot( reader, n, &v_cal );
+        assert_equal_velocity( &v_ref, &v_cal );
+    }
+    close_snapshot_reader( reader );
+
+    /* and in any order through the index */
+    const size_t capacity = encoded_snapshot_bound( 12, nelems );
+    real *buffer = (real*) __malloc( PAGE_BYTES, capacity );
+
+    for (int n = 0; n < nsnapshots; n++)
+    {
+        set_velocity( &v_ref, n );
+        TEST_ASSERT_EQUAL_UINT64( nelems * sizeof(real) * 12,
+                                  read_container_snapshot( container, n, buffer, capacity ) );
+
+        real* fields[12];
+        snapshot_fields( &v_cal, fields );
+        decode_snapshot( (unsigned char*) buffer, nelems * sizeof(real) * 12, fields, 12, nelems );
+        assert_equal_velocity( &v_ref, &v_cal );
+    }
+
+    __free( buffer );
+    close_snapshot_container( container );
+#endif
+}
+
+/*
+ * Disk snapshots a store left in its container: the 'count' oldest ones of
+ * the forward pass, each at a page boundary.
+ */
+static void check_container( const int nsnapshots, const int count )
+{
+    char fname[300];
+    sprintf(fname, "%s/snapshots.%03d", folder, 0);
+
+    if ( count == 0 )
+    {
+        TEST_ASSERT_TRUE( access( fname, F_OK ) != 0 );
+        return;
+    }
+
+    container_header_t header;
+    container_entry_t  index[8];
+
+    FILE *container = fopen( fname, "rb" );
+    TEST_ASSERT_NOT_NULL( container );
+    TEST_ASSERT_EQUAL_INT( 1, fread( &header, sizeof(header), 1, container ) );
+    TEST_ASSERT_EQUAL_INT( count, fread( index, sizeof(container_entry_t), count, container ) );
+    fclose( container );
+
+    TEST_ASSERT_EQUAL_MEMORY( "FWIS", header.magic, 4 );
+    TEST_ASSERT_EQUAL_INT( count, header.count );
+    TEST_ASSERT_EQUAL_INT( 0, header.data % PAGE_BYTES );
+
+    for (int k = 0; k < count; k++)
+    {
+        TEST_ASSERT_EQUAL_INT( nsnapshots-1-k, index[k].suffix );
+        TEST_ASSERT_EQUAL_INT( 0, index[k].offset % PAGE_BYTES );
+        TEST_ASSERT_TRUE( index[k].offset >= header.data );
+    }
+}
+
+/*
+ * Runs the forward/backward snapshot sequence of a shot through a store with
+ * room for 'budget' snapshots in memory, and checks that only 'resident' of
+ * them skipped the disk.
+ */
+static void check_store( const int nsnapshots, const int budget, const int resident )
+{
+    char fname[300];
+
+    sprintf(fname, "%s/snapshots.%03d", folder, 0);
+    remove( fname );
+
+    snapshot_memory_budget = (size_t) budget * nelems * sizeof(real) * 12;
+    snapshot_store_t *store = open_snapshot_store( folder, dimmz, dimmx, dimmy, nsnapshots-1, -1, nsnapshots );
+
+    for (int k = 0; k < nsnapshots; k++)
+    {
+        set_velocity( &v_ref, nsnapshots-1-k );
+        store_snapshot( store, nsnapshots-1-k, &v_ref, NULL );
+    }
+    flush_snapshot_store( store );
+
+    /* the most recent snapshots (lowest suffixes) stay in memory */
+    if ( snapshot_layout == CONTAINER_LAYOUT )
+        check_container( nsnapshots, nsnapshots - resident );
+    else
+    {
+        for (int n = 0; n < nsnapshots; n++)
+        {
+            sprintf(fname, "%s/snapshot.%03d.%05d", folder, 0, n);
+            TEST_ASSERT_EQUAL_INT( n >= resident, access( fname, F_OK ) == 0 );
+        }
+    }
+
+    for (int k = 0; k < nsnapshots; k++)
+    {
+        set_velocity( &v_ref, nsnapshots-1-k );
+        load_snapshot( store, nsnapshots-1-k, &v_cal );
+        assert_equal_velocity( &v_ref, &v_cal );
+    }
+    close_snapshot_store( store );
+}
+
+TEST(snapshot, store_backends)
+{
+#if defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is not enabled");
+#else
+    const snapshot_layout_t layouts[] = { CONTAINER_LAYOUT, FILE_LAYOUT };
+
+    for (int l = 0; l < 2; l++)
+    {
+        snapshot_layout = layouts[l];
+
+        /* auto picks memory, then hybrid, from the budget */
+        snapshot_store_mode = AUTO_STORE;
+        check_store( 5, 8, 5 );
+        check_store( 5, 2, 2 );
+
+        snapshot_store_mode = DISK_STORE;
+        check_store( 5, 8, 0 );
+    }
+
+    snapshot_layout        = CONTAINER_LAYOUT;
+    snapshot_store_mode    = AUTO_STORE;
+    snapshot_memory_budget = 0;
+#endif
+}
+
+TEST_GROUP_RUNNER(snapshot)
+{
+    RUN_TEST_CASE(snapshot, async_writer);
+    RUN_TEST_CASE(snapshot, prefetching_reader);
+    RUN_TEST_CASE(snapshot, container);
+    RUN_TEST_CASE(snapshot, store_backends);
+}
@@ -115,6 +115,11 @@ static void run_all_tests(void)
     RUN_TEST_GROUP(common);
     RUN_TEST_GROUP(propagator);
     RUN_TEST_GROUP(kernel);
+    RUN_TEST_GROUP(snapshot);
+    RUN_TEST_GROUP(checkpoint);
+    RUN_TEST_GROUP(codec);
+    RUN_TEST_GROUP(io);
+    RUN_TEST_GROUP(domain);
 }
 
 int main(int argc, const char* argv[])